@@ -0,0 +1,164 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "aoe_aura.h"
+
+AoeAura::AoeAura()
+{
+    bounds_ = AreaBounds();
+    world_ = NULL;
+    seen_stamp_ = 0;
+}
+
+s32 AoeAura::Init(const AreaShape& shape)
+{
+    s32 ret = shape.Bounds(bounds_);
+    if (ret != 0)
+    {
+        LOGFMTE("aura init error:<%d>. shape not init.", ret);
+        return ret;
+    }
+    shape_ = shape;
+    seen_stamp_ = 0;
+    return 0;
+}
+
+void AoeAura::Reset()
+{
+    inside_.clear();
+    seen_stamp_ = 0;
+}
+
+s32 AoeAura::Tick(AoeWorld& world, std::vector<AoeHit>& enters, std::vector<u64>& leaves)
+{
+    if (world.cols_ == 0 || shape_.shape_type() == AREA_SHAPE_NONE)
+    {
+        LOGFMTE("aura tick error. world or shape not init.");
+        return -1;
+    }
+    if (world_ != &world)
+    {
+        world_ = &world;
+        seen_stamp_ = 0;
+    }
+    if (world.stamp_ == seen_stamp_)
+    {
+        return 0;
+    }
+    u64 seen = seen_stamp_;
+
+    //包围盒覆盖的格子中 上次Tick之后有实体进入或移动, 并且当前不在范围内的实体
+    u32 min_col = 0;
+    u32 min_row = 0;
+    u32 max_col = 0;
+    u32 max_row = 0;
+    world.CellRange(bounds_.min.x - world.max_radius_, bounds_.min.y - world.max_radius_, bounds_.max.x + world.max_radius_, bounds_.max.y + world.max_radius_,
+        min_col, min_row, max_col, max_row);
+    candidate_ids_.clear();
+    candidate_x_.clear();
+    candidate_y_.clear();
+    candidate_z_.clear();
+    candidate_radius_.clear();
+    for (u32 row = min_row; row <= max_row; row++)
+    {
+        for (u32 col = min_col; col <= max_col; col++)
+        {
+            u32 cell = row * world.cols_ + col;
+            if (world.cell_stamps_[cell] <= seen)
+            {
+                continue;
+            }
+            for (u32 slot : world.cells_[cell])
+            {
+                if (world.stamps_[slot] <= seen || inside_.find(world.ids_[slot]) != inside_.end())
+                {
+                    continue;
+                }
+                candidate_ids_.push_back(world.ids_[slot]);
+                candidate_x_.push_back(world.xs_[slot]);
+                candidate_y_.push_back(world.ys_[slot]);
+                candidate_z_.push_back(world.zs_[slot]);
+                candidate_radius_.push_back(world.radius_[slot]);
+            }
+        }
+    }
+    u32 count = (u32)candidate_ids_.size();
+    if (count > 0)
+    {
+        candidate_dist_.resize(count);
+        candidate_bits_.resize(AreaHitWords(count));
+        AreaPoints points = { candidate_x_.data(), candidate_y_.data(), candidate_z_.data(), candidate_radius_.data(), count };
+        s32 ret = shape_.PointsInRange(points, candidate_bits_.data(), candidate_dist_.data());
+        if (ret < 0)
+        {
+            LOGFMTE("aura tick test error:<%d>.", ret);
+            return ret;
+        }
+    }
+
+    //范围内的实体 被删除或移动过的重新检测
+    s32 events = 0;
+    for (auto iter = inside_.begin(); iter != inside_.end();)
+    {
+        auto found = world.slot_of_.find(iter->first);
+        if (found != world.slot_of_.end())
+        {
+            u32 slot = found->second;
+            if (world.stamps_[slot] <= seen)
+            {
+                ++iter;
+                continue;
+            }
+            f32 dist_sq = 0.0f;
+            s32 ret = shape_.PointInRange(Point3(world.xs_[slot], world.ys_[slot], world.zs_[slot]), world.radius_[slot], dist_sq);
+            if (ret < 0)
+            {
+                LOGFMTE("aura tick test error:<%d>. id:<%llu>", ret, iter->first);
+                return ret;
+            }
+            if (ret == 0)
+            {
+                iter->second = dist_sq;
+                ++iter;
+                continue;
+            }
+        }
+        leaves.push_back(iter->first);
+        events++;
+        iter = inside_.erase(iter);
+    }
+
+    for (u32 word = 0; word < AreaHitWords(count); word++)
+    {
+        u64 bits = candidate_bits_[word];
+        while (bits != 0)
+        {
+            u32 bit = 0;
+            while (((bits >> bit) & 1u) == 0)
+            {
+                bit++;
+            }
+            bits &= bits - 1;
+            u32 index = word * 64 + bit;
+            inside_[candidate_ids_[index]] = candidate_dist_[index];
+            enters.push_back({ candidate_ids_[index], candidate_dist_[index] });
+            events++;
+        }
+    }
+    seen_stamp_ = world.stamp_;
+    return events;
+}
@@ -0,0 +1,59 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+#ifndef AOE_AURA_H
+#define AOE_AURA_H
+
+#include "aoe_world.h"
+
+//常驻形状(光环, 区域, 地面火焰等). 记录当前在范围内的实体, 每次Tick只重新检测上次Tick之后增加或移动过的实体:
+//包围盒覆盖的格子中 有变化的格子里新进入或移动过的实体检测是否进入; 范围内的实体移动或被删除时检测是否离开.
+//世界没有任何变化时Tick直接返回. 形状本身变化时重新Init, 下一次Tick对范围内的实体全量检测.
+class AoeAura
+{
+public:
+    AoeAura();
+    ~AoeAura() {}
+    //shape需要已经Init. 已在范围内的实体保留, 下一次Tick时全部重新检测
+    s32 Init(const AreaShape& shape);
+    //清空范围内的实体, 不产生离开事件
+    void Reset();
+    //进入的实体追加到enters, 离开的实体追加到leaves. 返回事件个数, 负数为错误.
+    s32 Tick(AoeWorld& world, std::vector<AoeHit>& enters, std::vector<u64>& leaves);
+    bool IsInside(u64 id) const { return inside_.find(id) != inside_.end(); }
+    u32 inside_count() const { return (u32)inside_.size(); }
+    const AreaShape& shape() const { return shape_; }
+private:
+    AreaShape shape_;
+    AreaBounds bounds_;
+    const AoeWorld* world_; //上次Tick的世界 换了世界时全量检测
+    u64 seen_stamp_; //上次Tick时世界的stamp 0表示全量检测
+    std::unordered_map<u64, f32> inside_; //范围内的实体和距离平方
+
+    //新进入候选的缓存
+    std::vector<u64> candidate_ids_;
+    std::vector<f32> candidate_x_;
+    std::vector<f32> candidate_y_;
+    std::vector<f32> candidate_z_;
+    std::vector<f32> candidate_radius_;
+    std::vector<f32> candidate_dist_;
+    std::vector<u64> candidate_bits_;
+};
+
+
+#endif //
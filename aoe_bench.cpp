@@ -0,0 +1,540 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+//无界面的性能测试. 按形状类型, 目标半径(0/非0), 目标密度分组, 分别测逐个检测(PointInRange), 批量检测(PointsInRange)和紧凑记录(AoeShapePool)的批量检测.
+//结果以JSON输出到标准输出, 便于不同版本之间对比.
+//用法: aoe_bench [min_ms] [kernel_level]
+//  min_ms: 每组至少运行的毫秒数, 默认200
+//  kernel_level: scalar/sse41/avx2/avx512, 默认自动检测
+//      aoe_bench check
+//  正确性检查, 逐个指令集级别对比批量检测/最近K个查询与逐点检测的结果, 以及批量检测的统计返回码, 不一致时返回非0
+
+#include "aoe_shape.h"
+#include "aoe_record.h"
+#include "aoe_stat.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+typedef double f64;
+
+static const u32 BENCH_SHAPE_COUNT = 16; //每组使用的形状个数 朝向和位置不同
+static const u32 BENCH_ENTITY_COUNT = 4096;
+static const f32 BENCH_SHAPE_SIZE = 10.0f;
+static const u32 BENCH_NEAREST_K = 5;
+
+struct BenchShape
+{
+    u32 shape_type;
+    const char* name;
+    Point3 offset;
+    Point3 scale;
+    Point3 ext;
+};
+
+static const BenchShape BENCH_SHAPES[] =
+{
+    { AREA_SHAPE_CIRCLE, "circle", { 0.0f, 0.0f, 0.0f }, { 0.0f, BENCH_SHAPE_SIZE, 5.0f }, { 0.0f, 0.0f, 0.0f } },
+    { AREA_SHAPE_FAN, "fan", { 0.0f, 0.0f, 0.0f }, { 90.0f, BENCH_SHAPE_SIZE, 5.0f }, { 0.0f, 0.0f, 0.0f } },
+    { AREA_SHAPE_RECT, "rect", { 0.0f, 0.0f, 0.0f }, { BENCH_SHAPE_SIZE, BENCH_SHAPE_SIZE * 0.6f, 5.0f }, { 0.0f, 0.0f, 0.0f } },
+    { AREA_SHAPE_RING, "ring", { 0.0f, 0.0f, 0.0f }, { BENCH_SHAPE_SIZE * 0.4f, BENCH_SHAPE_SIZE, 5.0f }, { 0.0f, 0.0f, 0.0f } },
+    { AREA_SHAPE_FRAME, "frame", { 0.0f, 0.0f, 0.0f }, { BENCH_SHAPE_SIZE, BENCH_SHAPE_SIZE * 0.6f, 5.0f }, { 0.0f, 0.0f, 0.0f } },
+    { AREA_SHAPE_FOV, "fov", { 0.0f, 0.0f, 0.0f }, { 60.0f, 1.5f, BENCH_SHAPE_SIZE }, { 1.0f, 0.0f, 0.0f } },
+    { AREA_SHAPE_CAPSULE, "capsule", { 0.0f, 0.0f, 0.0f }, { BENCH_SHAPE_SIZE, BENCH_SHAPE_SIZE * 0.3f, 5.0f }, { 0.0f, 0.0f, 0.0f } },
+    { AREA_SHAPE_POLYGON, "hexagon", { 0.0f, 0.0f, 0.0f }, { 6.0f, BENCH_SHAPE_SIZE, 5.0f }, { 0.0f, 0.0f, 0.0f } },
+};
+
+//目标分布在以形状为中心, 边长2*half_extent的正方形内. 越密集 越多目标走到后面的检测阶段
+struct BenchDensity
+{
+    const char* name;
+    f32 half_extent;
+};
+
+static const BenchDensity BENCH_DENSITIES[] =
+{
+    { "dense", BENCH_SHAPE_SIZE * 1.2f },
+    { "medium", BENCH_SHAPE_SIZE * 3.0f },
+    { "sparse", BENCH_SHAPE_SIZE * 10.0f },
+};
+
+struct BenchResult
+{
+    u64 tests;
+    u64 hits;
+    f64 seconds;
+};
+
+static f64 BenchNow()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct BenchCase
+{
+    std::vector<AreaShape> shapes;
+    std::vector<f32> xs;
+    std::vector<f32> ys;
+    std::vector<f32> zs;
+    std::vector<f32> radius;
+    std::vector<u64> bits;
+    std::vector<f32> dist;
+    std::vector<AreaNearest> nearest;
+    AoeShapePool pool; //与shapes相同的形状 压缩成紧凑记录
+    std::vector<u32> handles;
+};
+
+static s32 BenchBuild(BenchCase& bench, const BenchShape& shape, const BenchDensity& density, bool zero_radius, u32 seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<f32> pos(-density.half_extent, density.half_extent);
+    std::uniform_real_distribution<f32> high(-3.0f, 3.0f);
+    std::uniform_real_distribution<f32> target_radius(0.1f, 1.0f);
+    std::uniform_real_distribution<f32> angle(0.0f, PI2);
+    bench.shapes.clear();
+    bench.shapes.resize(BENCH_SHAPE_COUNT);
+    bench.pool.Clear();
+    bench.handles.resize(BENCH_SHAPE_COUNT);
+    for (u32 i = 0; i < BENCH_SHAPE_COUNT; i++)
+    {
+        f32 radian = angle(rng);
+        DeviationShape deviation;
+        deviation.pivot_pos = { pos(rng) * 0.1f, pos(rng) * 0.1f, 0.0f };
+        deviation.pivot_dir = { cosf(radian), sinf(radian), 0.0f };
+        deviation.pivot_offset = shape.offset;
+        deviation.pivot_scale = shape.scale;
+        deviation.pivot_ext = shape.ext;
+        s32 ret = bench.shapes[i].Init(shape.shape_type, deviation, 0.5f);
+        if (ret != 0)
+        {
+            LOGFMTE("bench init shape error:<%d>. shape:<%s>", ret, shape.name);
+            return ret;
+        }
+        ret = bench.pool.Add(bench.shapes[i], bench.handles[i]);
+        if (ret != 0)
+        {
+            LOGFMTE("bench add shape record error:<%d>. shape:<%s>", ret, shape.name);
+            return ret;
+        }
+    }
+    bench.xs.resize(BENCH_ENTITY_COUNT);
+    bench.ys.resize(BENCH_ENTITY_COUNT);
+    bench.zs.resize(BENCH_ENTITY_COUNT);
+    bench.radius.resize(BENCH_ENTITY_COUNT);
+    for (u32 i = 0; i < BENCH_ENTITY_COUNT; i++)
+    {
+        bench.xs[i] = pos(rng);
+        bench.ys[i] = pos(rng);
+        bench.zs[i] = high(rng);
+        bench.radius[i] = zero_radius ? 0.0f : target_radius(rng);
+    }
+    bench.bits.resize(AreaHitWords(BENCH_ENTITY_COUNT));
+    bench.dist.resize(BENCH_ENTITY_COUNT);
+    return 0;
+}
+
+static BenchResult BenchPointInRange(BenchCase& bench, f64 min_seconds)
+{
+    BenchResult result = { 0, 0, 0.0 };
+    f64 begin = BenchNow();
+    do
+    {
+        for (auto& shape : bench.shapes)
+        {
+            for (u32 i = 0; i < BENCH_ENTITY_COUNT; i++)
+            {
+                f32 dist_sq = 0.0f;
+                if (shape.PointInRange({ bench.xs[i], bench.ys[i], bench.zs[i] }, bench.radius[i], dist_sq) == 0)
+                {
+                    result.hits++;
+                }
+            }
+            result.tests += BENCH_ENTITY_COUNT;
+        }
+        result.seconds = BenchNow() - begin;
+    } while (result.seconds < min_seconds);
+    return result;
+}
+
+static BenchResult BenchPointsInRange(BenchCase& bench, f64 min_seconds)
+{
+    BenchResult result = { 0, 0, 0.0 };
+    AreaPoints points = { bench.xs.data(), bench.ys.data(), bench.zs.data(), bench.radius.data(), BENCH_ENTITY_COUNT };
+    f64 begin = BenchNow();
+    do
+    {
+        for (auto& shape : bench.shapes)
+        {
+            s32 ret = shape.PointsInRange(points, bench.bits.data(), bench.dist.data());
+            if (ret > 0)
+            {
+                result.hits += (u64)ret;
+            }
+            result.tests += BENCH_ENTITY_COUNT;
+        }
+        result.seconds = BenchNow() - begin;
+    } while (result.seconds < min_seconds);
+    return result;
+}
+
+//紧凑记录的批量检测 结果与batch一致
+static BenchResult BenchPoolPointsInRange(BenchCase& bench, f64 min_seconds)
+{
+    BenchResult result = { 0, 0, 0.0 };
+    AreaPoints points = { bench.xs.data(), bench.ys.data(), bench.zs.data(), bench.radius.data(), BENCH_ENTITY_COUNT };
+    f64 begin = BenchNow();
+    do
+    {
+        for (u32 handle : bench.handles)
+        {
+            s32 ret = bench.pool.PointsInRange(handle, points, bench.bits.data(), bench.dist.data());
+            if (ret > 0)
+            {
+                result.hits += (u64)ret;
+            }
+            result.tests += BENCH_ENTITY_COUNT;
+        }
+        result.seconds = BenchNow() - begin;
+    } while (result.seconds < min_seconds);
+    return result;
+}
+
+//带目标上限的技能: 只取最近的BENCH_NEAREST_K个
+static BenchResult BenchNearestInRange(BenchCase& bench, f64 min_seconds)
+{
+    BenchResult result = { 0, 0, 0.0 };
+    AreaPoints points = { bench.xs.data(), bench.ys.data(), bench.zs.data(), bench.radius.data(), BENCH_ENTITY_COUNT };
+    f64 begin = BenchNow();
+    do
+    {
+        for (auto& shape : bench.shapes)
+        {
+            s32 ret = shape.NearestInRange(points, BENCH_NEAREST_K, bench.nearest);
+            if (ret > 0)
+            {
+                result.hits += (u64)ret;
+            }
+            result.tests += BENCH_ENTITY_COUNT;
+        }
+        result.seconds = BenchNow() - begin;
+    } while (result.seconds < min_seconds);
+    return result;
+}
+
+//正确性检查: 批量检测, 紧凑记录和最近K个查询与逐点的PointInRange对比, 命中位和dist_sq都要逐位一致.
+//返回不一致的个数.
+static u32 BenchCheckCase(BenchCase& bench, const BenchShape& shape, u32 count)
+{
+    u32 errors = 0;
+    AreaPoints points = { bench.xs.data(), bench.ys.data(), bench.zs.data(), bench.radius.data(), count };
+    std::vector<f32> expect_dist(count);
+    std::vector<u8> expect_hit(count);
+    std::vector<AreaNearest> expect_nearest;
+    std::vector<u64> pool_bits(bench.bits.size());
+    std::vector<f32> pool_dist(bench.dist.size());
+    for (u32 s = 0; s < BENCH_SHAPE_COUNT; s++)
+    {
+        AreaShape& area = bench.shapes[s];
+        expect_nearest.clear();
+        for (u32 i = 0; i < count; i++)
+        {
+            f32 dist_sq = 0.0f;
+            expect_hit[i] = area.PointInRange({ bench.xs[i], bench.ys[i], bench.zs[i] }, bench.radius[i], dist_sq) == 0;
+            expect_dist[i] = dist_sq;
+            if (expect_hit[i])
+            {
+                expect_nearest.push_back({ i, dist_sq });
+            }
+        }
+        std::sort(expect_nearest.begin(), expect_nearest.end(), [](const AreaNearest& a, const AreaNearest& b)
+            {
+                return a.dist_sq < b.dist_sq || (a.dist_sq == b.dist_sq && a.index < b.index);
+            });
+
+        s32 hits = area.PointsInRange(points, bench.bits.data(), bench.dist.data());
+        s32 pool_hits = bench.pool.PointsInRange(bench.handles[s], points, pool_bits.data(), pool_dist.data());
+        if (hits != (s32)expect_nearest.size() || pool_hits != hits)
+        {
+            LOGFMTE("check hit count error. shape:<%s>, index:<%u>, count:<%u>, expect:<%u>, batch:<%d>, pool:<%d>",
+                shape.name, s, count, (u32)expect_nearest.size(), hits, pool_hits);
+            errors++;
+        }
+        for (u32 i = 0; i < count; i++)
+        {
+            bool hit = ((bench.bits[i / 64] >> (i % 64)) & 1u) != 0;
+            bool pool_hit = ((pool_bits[i / 64] >> (i % 64)) & 1u) != 0;
+            if (hit != (expect_hit[i] != 0) || pool_hit != hit)
+            {
+                LOGFMTE("check hit error. shape:<%s>, index:<%u>, target:<%u>, expect:<%d>, batch:<%d>, pool:<%d>",
+                    shape.name, s, i, (s32)expect_hit[i], (s32)hit, (s32)pool_hit);
+                errors++;
+                continue;
+            }
+            if (hit && (memcmp(&bench.dist[i], &expect_dist[i], sizeof(f32)) != 0 || memcmp(&pool_dist[i], &expect_dist[i], sizeof(f32)) != 0))
+            {
+                LOGFMTE("check dist_sq error. shape:<%s>, index:<%u>, target:<%u>, expect:<%g>, batch:<%g>, pool:<%g>",
+                    shape.name, s, i, expect_dist[i], bench.dist[i], pool_dist[i]);
+                errors++;
+            }
+        }
+        //命中位之后不应有多余的位
+        if (count % 64 != 0 && (bench.bits[count / 64] >> (count % 64)) != 0)
+        {
+            LOGFMTE("check tail bits error. shape:<%s>, index:<%u>, count:<%u>", shape.name, s, count);
+            errors++;
+        }
+
+        const u32 ks[] = { 1, BENCH_NEAREST_K, 100 };
+        for (u32 k : ks)
+        {
+            s32 ret = area.NearestInRange(points, k, bench.nearest);
+            u32 expect_size = expect_nearest.size() < k ? (u32)expect_nearest.size() : k;
+            if (ret != (s32)expect_size || bench.nearest.size() != expect_size)
+            {
+                LOGFMTE("check nearest count error. shape:<%s>, index:<%u>, k:<%u>, expect:<%u>, ret:<%d>",
+                    shape.name, s, k, expect_size, ret);
+                errors++;
+                continue;
+            }
+            for (u32 i = 0; i < expect_size; i++)
+            {
+                if (bench.nearest[i].index != expect_nearest[i].index
+                    || memcmp(&bench.nearest[i].dist_sq, &expect_nearest[i].dist_sq, sizeof(f32)) != 0)
+                {
+                    LOGFMTE("check nearest error. shape:<%s>, index:<%u>, k:<%u>, rank:<%u>, expect:<%u %g>, real:<%u %g>",
+                        shape.name, s, k, i, expect_nearest[i].index, expect_nearest[i].dist_sq, bench.nearest[i].index, bench.nearest[i].dist_sq);
+                    errors++;
+                    break;
+                }
+            }
+        }
+    }
+    return errors;
+}
+
+template<class Kernel>
+static u32 BenchCheckKernelCodes(const Kernel& kernel, BenchCase& bench, const BenchShape& shape, u32 s, const std::vector<s32>& expect, u32 count)
+{
+    for (u32 i = 0; i < count; i++)
+    {
+        f32 dist_sq = 0.0f;
+        s32 code = AreaKernelPointInRange(kernel, { bench.xs[i], bench.ys[i], bench.zs[i] }, bench.radius[i], dist_sq);
+        if (code != expect[i])
+        {
+            LOGFMTE("check kernel code error. shape:<%s>, index:<%u>, target:<%u>, expect:<%d>, real:<%d>", shape.name, s, i, expect[i], code);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//未命中的返回码: 标量检测核心与PointInRange逐个一致; 开启统计时批量检测和紧凑记录计入的各返回码个数与逐点检测相同
+static u32 BenchCheckCodes(BenchCase& bench, const BenchShape& shape, u32 count)
+{
+    u32 errors = 0;
+    AreaPoints points = { bench.xs.data(), bench.ys.data(), bench.zs.data(), bench.radius.data(), count };
+    std::vector<s32> expect(count);
+    for (u32 s = 0; s < BENCH_SHAPE_COUNT; s++)
+    {
+        AreaShape& area = bench.shapes[s];
+        u64 expect_counts[AOE_STAT_CODE_MAX] = { 0 };
+        for (u32 i = 0; i < count; i++)
+        {
+            f32 dist_sq = 0.0f;
+            expect[i] = area.PointInRange({ bench.xs[i], bench.ys[i], bench.zs[i] }, bench.radius[i], dist_sq);
+            expect_counts[expect[i] < (s32)AOE_STAT_CODE_OTHER ? expect[i] : AOE_STAT_CODE_OTHER] += 2;
+        }
+
+        switch (shape.shape_type)
+        {
+        case AREA_SHAPE_CIRCLE:
+        case AREA_SHAPE_RING:
+        {
+            AreaCircleKernel kernel;
+            area.BuildKernel(kernel);
+            errors += BenchCheckKernelCodes(kernel, bench, shape, s, expect, count);
+            break;
+        }
+        case AREA_SHAPE_FAN:
+        {
+            AreaFanKernel kernel;
+            area.BuildKernel(kernel);
+            errors += BenchCheckKernelCodes(kernel, bench, shape, s, expect, count);
+            break;
+        }
+        case AREA_SHAPE_RECT:
+        case AREA_SHAPE_FRAME:
+        {
+            AreaRectKernel kernel;
+            area.BuildKernel(kernel);
+            errors += BenchCheckKernelCodes(kernel, bench, shape, s, expect, count);
+            break;
+        }
+        case AREA_SHAPE_FOV:
+        {
+            AreaFovKernel kernel;
+            area.BuildKernel(kernel);
+            errors += BenchCheckKernelCodes(kernel, bench, shape, s, expect, count);
+            break;
+        }
+        case AREA_SHAPE_CAPSULE:
+        {
+            AreaCapsuleKernel kernel;
+            area.BuildKernel(kernel);
+            errors += BenchCheckKernelCodes(kernel, bench, shape, s, expect, count);
+            break;
+        }
+        case AREA_SHAPE_POLYGON:
+        {
+            AreaPolygonKernel kernel;
+            area.BuildKernel(kernel);
+            errors += BenchCheckKernelCodes(kernel, bench, shape, s, expect, count);
+            break;
+        }
+        default:
+            break;
+        }
+
+#if AOE_STAT_ENABLE
+        AoeStatReset();
+        AoeStatEnable(true);
+        area.PointsInRange(points, bench.bits.data(), bench.dist.data());
+        bench.pool.PointsInRange(bench.handles[s], points, bench.bits.data(), bench.dist.data());
+        AoeStatEnable(false);
+        AoeStatTable table;
+        AoeStatMerge(table);
+        for (u32 code = 0; code < AOE_STAT_CODE_MAX; code++)
+        {
+            if (table.counts[shape.shape_type][code] != expect_counts[code])
+            {
+                LOGFMTE("check stat error. shape:<%s>, index:<%u>, code:<%u>, expect:<%llu>, real:<%llu>", shape.name, s, code,
+                    (unsigned long long)expect_counts[code], (unsigned long long)table.counts[shape.shape_type][code]);
+                errors++;
+            }
+        }
+#endif
+    }
+    return errors;
+}
+
+//依次强制每个可用的指令集级别, 所有形状/目标半径/密度组合都做正确性检查. 有不一致时返回非0
+static s32 BenchCheck()
+{
+    u32 errors = 0;
+    u32 checked = 0;
+    BenchCase bench;
+    for (u32 level = 0; level < AREA_KERNEL_LEVEL_MAX; level++)
+    {
+        if (AreaKernelForceLevel(level) != 0)
+        {
+            printf("check level:<%s> skipped, not usable\n", AreaKernelLevelName(level));
+            continue;
+        }
+        u32 level_errors = 0;
+        u32 seed = 0;
+        for (const BenchShape& shape : BENCH_SHAPES)
+        {
+            for (u32 zero_radius = 0; zero_radius < 2; zero_radius++)
+            {
+                for (const BenchDensity& density : BENCH_DENSITIES)
+                {
+                    if (BenchBuild(bench, shape, density, zero_radius != 0, ++seed) != 0)
+                    {
+                        return 2;
+                    }
+                    //整块和带尾部的数量
+                    level_errors += BenchCheckCase(bench, shape, BENCH_ENTITY_COUNT);
+                    level_errors += BenchCheckCase(bench, shape, BENCH_ENTITY_COUNT - 37);
+                    level_errors += BenchCheckCodes(bench, shape, BENCH_ENTITY_COUNT - 37);
+                }
+            }
+        }
+        printf("check level:<%s> errors:<%u>\n", AreaKernelLevelName(level), level_errors);
+        errors += level_errors;
+        checked++;
+    }
+    return errors == 0 && checked > 0 ? 0 : 1;
+}
+
+static void BenchPrint(const char* mode, const BenchShape& shape, const BenchDensity& density, bool zero_radius, const BenchResult& result, bool& first)
+{
+    f64 ns_per_test = result.tests > 0 ? result.seconds * 1e9 / result.tests : 0.0;
+    f64 tests_per_sec = result.seconds > 0.0 ? result.tests / result.seconds : 0.0;
+    f64 hit_rate = result.tests > 0 ? (f64)result.hits / result.tests : 0.0;
+    printf("%s\n    {\"mode\":\"%s\", \"shape\":\"%s\", \"radius\":\"%s\", \"density\":\"%s\", \"half_extent\":%.2f, "
+        "\"tests\":%llu, \"ns_per_test\":%.3f, \"tests_per_sec\":%.0f, \"hit_rate\":%.6f}",
+        first ? "" : ",", mode, shape.name, zero_radius ? "zero" : "positive", density.name, density.half_extent,
+        (unsigned long long)result.tests, ns_per_test, tests_per_sec, hit_rate);
+    first = false;
+}
+
+int main(int argc, char* argv[])
+{
+    FNLog::FastStartDefaultLogger();
+    FNLog::BatchSetChannelConfig(FNLog::GetDefaultLogger(), FNLog::CHANNEL_CFG_PRIORITY, FNLog::PRIORITY_ERROR);
+    if (argc > 1 && strcmp(argv[1], "check") == 0)
+    {
+        return BenchCheck();
+    }
+    f64 min_seconds = 0.2;
+    if (argc > 1)
+    {
+        min_seconds = atoi(argv[1]) / 1000.0;
+    }
+    if (argc > 2)
+    {
+        u32 level = AREA_KERNEL_LEVEL_MAX;
+        for (u32 i = 0; i < AREA_KERNEL_LEVEL_MAX; i++)
+        {
+            if (strcmp(argv[2], AreaKernelLevelName(i)) == 0)
+            {
+                level = i;
+            }
+        }
+        if (AreaKernelForceLevel(level) != 0)
+        {
+            LOGFMTE("bench kernel level:<%s> not usable", argv[2]);
+            return 1;
+        }
+    }
+
+    printf("{\n  \"entities\":%u, \"shapes_per_case\":%u, \"shape_size\":%.2f, \"min_ms\":%.0f, \"kernel_level\":\"%s\",\n  \"results\":[",
+        BENCH_ENTITY_COUNT, BENCH_SHAPE_COUNT, BENCH_SHAPE_SIZE, min_seconds * 1000.0, AreaKernelLevelName(AreaKernelActiveLevel()));
+    bool first = true;
+    BenchCase bench;
+    u32 seed = 0;
+    for (const BenchShape& shape : BENCH_SHAPES)
+    {
+        for (u32 zero_radius = 0; zero_radius < 2; zero_radius++)
+        {
+            for (const BenchDensity& density : BENCH_DENSITIES)
+            {
+                if (BenchBuild(bench, shape, density, zero_radius != 0, ++seed) != 0)
+                {
+                    return 2;
+                }
+                BenchPrint("single", shape, density, zero_radius != 0, BenchPointInRange(bench, min_seconds), first);
+                BenchPrint("batch", shape, density, zero_radius != 0, BenchPointsInRange(bench, min_seconds), first);
+                BenchPrint("pool", shape, density, zero_radius != 0, BenchPoolPointsInRange(bench, min_seconds), first);
+                BenchPrint("nearest", shape, density, zero_radius != 0, BenchNearestInRange(bench, min_seconds), first);
+                fflush(stdout);
+            }
+        }
+    }
+    printf("\n  ]\n}\n");
+    return 0;
+}
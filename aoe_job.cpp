@@ -0,0 +1,245 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "aoe_job.h"
+#include <algorithm>
+
+AoeJobPool::AoeJobPool()
+{
+    generation_ = 0;
+    active_ = 0;
+    stop_ = false;
+    remaining_.store(0);
+    error_.store(0);
+    shapes_ = NULL;
+    points_ = { NULL, NULL, NULL, NULL, 0 };
+    workers_.emplace_back(new Worker());
+}
+
+AoeJobPool::~AoeJobPool()
+{
+    Stop();
+}
+
+s32 AoeJobPool::Start(u32 thread_count)
+{
+    if (!threads_.empty())
+    {
+        LOGFMTE("job pool start conflict. thread_count:<%u>", (u32)threads_.size());
+        return -1;
+    }
+    if (thread_count == 0)
+    {
+        u32 cores = std::thread::hardware_concurrency();
+        thread_count = cores > 1 ? cores - 1 : 0;
+    }
+    stop_ = false;
+    for (u32 i = 0; i < thread_count; i++)
+    {
+        workers_.emplace_back(new Worker());
+    }
+    for (u32 i = 0; i < thread_count; i++)
+    {
+        threads_.emplace_back(&AoeJobPool::ThreadMain, this, i + 1);
+    }
+    return 0;
+}
+
+void AoeJobPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> guard(batch_lock_);
+        stop_ = true;
+    }
+    batch_cond_.notify_all();
+    for (auto& thd : threads_)
+    {
+        thd.join();
+    }
+    threads_.clear();
+    workers_.resize(1);
+}
+
+bool AoeJobPool::PopTask(u32 self, Task& task)
+{
+    {
+        Worker& worker = *workers_[self];
+        std::lock_guard<std::mutex> guard(worker.lock);
+        if (!worker.tasks.empty())
+        {
+            task = worker.tasks.front();
+            worker.tasks.pop_front();
+            return true;
+        }
+    }
+    u32 count = (u32)workers_.size();
+    for (u32 i = 1; i < count; i++)
+    {
+        Worker& victim = *workers_[(self + i) % count];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty())
+        {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void AoeJobPool::RunTask(u32 self, const Task& task)
+{
+    Worker& worker = *workers_[self];
+    u32 count = task.end - task.begin;
+    worker.bits.resize(AreaHitWords(count));
+    worker.dist.resize(count);
+    AreaPoints span = { points_.x + task.begin, points_.y + task.begin, points_.z + task.begin,
+        points_.radius == NULL ? NULL : points_.radius + task.begin, count };
+    s32 ret = shapes_[task.shape].PointsInRange(span, worker.bits.data(), worker.dist.data());
+    if (ret < 0)
+    {
+        s32 expect = 0;
+        error_.compare_exchange_strong(expect, ret);
+        return;
+    }
+    Segment segment = { task.id, self, (u32)worker.hits.size(), 0 };
+    for (u32 word = 0; word < (u32)worker.bits.size(); word++)
+    {
+        u64 bits = worker.bits[word];
+        while (bits != 0)
+        {
+            u32 bit = 0;
+            while (((bits >> bit) & 1u) == 0)
+            {
+                bit++;
+            }
+            bits &= bits - 1;
+            u32 index = word * 64 + bit;
+            worker.hits.push_back({ task.shape, task.begin + index, worker.dist[index] });
+        }
+    }
+    segment.count = (u32)worker.hits.size() - segment.offset;
+    if (segment.count > 0)
+    {
+        worker.segments.push_back(segment);
+    }
+}
+
+void AoeJobPool::WorkLoop(u32 self)
+{
+    Task task;
+    while (remaining_.load(std::memory_order_acquire) > 0 && PopTask(self, task))
+    {
+        RunTask(self, task);
+        remaining_.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+void AoeJobPool::ThreadMain(u32 self)
+{
+    u64 seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> guard(batch_lock_);
+            batch_cond_.wait(guard, [&] { return stop_ || generation_ != seen; });
+            if (stop_)
+            {
+                return;
+            }
+            seen = generation_;
+            active_++;
+        }
+        WorkLoop(self);
+        {
+            std::lock_guard<std::mutex> guard(batch_lock_);
+            active_--;
+        }
+        done_cond_.notify_all();
+    }
+}
+
+s32 AoeJobPool::Resolve(AreaShape* shapes, u32 shape_count, const AreaPoints& points, std::vector<AoeJobHit>& hits, u32 span_size)
+{
+    if (shapes == NULL || span_size == 0 || (points.count > 0 && (points.x == NULL || points.y == NULL || points.z == NULL)))
+    {
+        LOGFMTE("job pool resolve param error. shape_count:<%u>, count:<%u>, span_size:<%u>", shape_count, points.count, span_size);
+        return -1;
+    }
+    u32 spans = (points.count + span_size - 1) / span_size;
+    u32 task_count = spans * shape_count;
+    if (task_count == 0)
+    {
+        return 0;
+    }
+
+    u32 worker_count = (u32)workers_.size();
+    {
+        std::lock_guard<std::mutex> guard(batch_lock_);
+        shapes_ = shapes;
+        points_ = points;
+        error_.store(0);
+        for (auto& worker : workers_)
+        {
+            worker->hits.clear();
+            worker->segments.clear();
+        }
+        //任务按编号连续分段放入各队列, 相邻的任务落在同一线程上
+        u32 per_worker = (task_count + worker_count - 1) / worker_count;
+        for (u32 id = 0; id < task_count; id++)
+        {
+            u32 shape = id / spans;
+            u32 begin = (id % spans) * span_size;
+            u32 end = begin + span_size < points.count ? begin + span_size : points.count;
+            Worker& worker = *workers_[id / per_worker];
+            std::lock_guard<std::mutex> task_guard(worker.lock);
+            worker.tasks.push_back({ id, shape, begin, end });
+        }
+        remaining_.store(task_count, std::memory_order_release);
+        generation_++;
+    }
+    batch_cond_.notify_all();
+
+    WorkLoop(0);
+    {
+        std::unique_lock<std::mutex> guard(batch_lock_);
+        done_cond_.wait(guard, [&] { return remaining_.load(std::memory_order_acquire) == 0 && active_ == 0; });
+        shapes_ = NULL;
+    }
+
+    s32 error = error_.load();
+    if (error < 0)
+    {
+        LOGFMTE("job pool resolve error:<%d>. shape_count:<%u>, count:<%u>", error, shape_count, points.count);
+        return error;
+    }
+
+    //按任务编号合并, 与线程的执行顺序无关
+    merge_.clear();
+    for (auto& worker : workers_)
+    {
+        merge_.insert(merge_.end(), worker->segments.begin(), worker->segments.end());
+    }
+    std::sort(merge_.begin(), merge_.end(), [](const Segment& a, const Segment& b) { return a.task < b.task; });
+    size_t total = hits.size();
+    for (const Segment& segment : merge_)
+    {
+        const std::vector<AoeJobHit>& source = workers_[segment.worker]->hits;
+        hits.insert(hits.end(), source.begin() + segment.offset, source.begin() + segment.offset + segment.count);
+    }
+    return (s32)(hits.size() - total);
+}
@@ -0,0 +1,97 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+#ifndef AOE_JOB_H
+#define AOE_JOB_H
+
+#include "aoe_shape.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+struct AoeJobHit
+{
+    u32 shape; //shapes中的下标
+    u32 index; //points中的下标
+    f32 dist_sq;
+};
+
+//多线程批量检测. 把(形状, 目标区间)切分成任务分到各线程的队列, 线程空闲时从其他队列尾部窃取.
+//每个线程把命中写入自己的缓冲, 结束后按任务顺序合并, 结果与单线程逐个形状调用PointsInRange的顺序一致.
+//调用Resolve的线程也参与执行. 同一时间只能有一个Resolve.
+class AoeJobPool
+{
+public:
+    AoeJobPool();
+    ~AoeJobPool();
+    //thread_count为额外工作线程数 0表示按CPU核数
+    s32 Start(u32 thread_count);
+    void Stop();
+    //命中追加到hits. 返回命中总数, 负数为错误. span_size为每个任务的目标数
+    s32 Resolve(AreaShape* shapes, u32 shape_count, const AreaPoints& points, std::vector<AoeJobHit>& hits, u32 span_size = 1024);
+    u32 thread_count() const { return (u32)threads_.size(); }
+private:
+    struct Task
+    {
+        u32 id;
+        u32 shape;
+        u32 begin;
+        u32 end;
+    };
+    struct Segment
+    {
+        u32 task;
+        u32 worker;
+        u32 offset;
+        u32 count;
+    };
+    struct Worker
+    {
+        std::mutex lock; //只保护tasks
+        std::deque<Task> tasks; //自己从头部取, 窃取者从尾部取
+        std::vector<AoeJobHit> hits;
+        std::vector<Segment> segments;
+        std::vector<u64> bits;
+        std::vector<f32> dist;
+    };
+    bool PopTask(u32 self, Task& task);
+    void RunTask(u32 self, const Task& task);
+    void WorkLoop(u32 self);
+    void ThreadMain(u32 self);
+private:
+    std::vector<std::unique_ptr<Worker>> workers_; //0号为调用Resolve的线程
+    std::vector<std::thread> threads_;
+    std::mutex batch_lock_;
+    std::condition_variable batch_cond_;
+    std::condition_variable done_cond_;
+    u64 generation_;
+    u32 active_; //正在执行当前批次的工作线程数
+    bool stop_;
+    std::atomic<u32> remaining_;
+    std::atomic<s32> error_;
+
+    AreaShape* shapes_;
+    AreaPoints points_;
+    std::vector<Segment> merge_;
+};
+
+
+#endif //
@@ -0,0 +1,154 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "aoe_join.h"
+#include <algorithm>
+
+s32 AoeJoin::Resolve(AreaShape* shapes, u32 shape_count, const AreaPoints& points, std::vector<AoeJoinPair>& pairs)
+{
+    if ((shapes == NULL && shape_count > 0) || (points.count > 0 && (points.x == NULL || points.y == NULL || points.z == NULL)))
+    {
+        LOGFMTE("join resolve param error. shape_count:<%u>, count:<%u>", shape_count, points.count);
+        return -1;
+    }
+    u32 count = points.count;
+    if (count == 0 || shape_count == 0)
+    {
+        return 0;
+    }
+
+    f32 max_radius = 0.0f;
+    if (points.radius != NULL)
+    {
+        for (u32 i = 0; i < count; i++)
+        {
+            max_radius = points.radius[i] > max_radius ? points.radius[i] : max_radius;
+        }
+    }
+
+    //形状包围盒按最大目标半径扩展, 按左边界排序
+    ranges_.resize(shape_count);
+    for (u32 i = 0; i < shape_count; i++)
+    {
+        ShapeRange& range = ranges_[i];
+        range.shape = i;
+        s32 ret = shapes[i].Bounds(range.bounds);
+        if (ret != 0)
+        {
+            LOGFMTE("join resolve shape bounds error:<%d>. shape:<%u>", ret, i);
+            return ret;
+        }
+        range.bounds.min = range.bounds.min - Point3(max_radius, max_radius, max_radius);
+        range.bounds.max = range.bounds.max + Point3(max_radius, max_radius, max_radius);
+    }
+    std::sort(ranges_.begin(), ranges_.end(), [](const ShapeRange& a, const ShapeRange& b)
+    {
+        return a.bounds.min.x < b.bounds.min.x || (a.bounds.min.x == b.bounds.min.x && a.shape < b.shape);
+    });
+
+    //目标按x排序后重排成连续的SoA
+    order_.resize(count);
+    for (u32 i = 0; i < count; i++)
+    {
+        order_[i] = i;
+    }
+    const f32* x = points.x;
+    std::sort(order_.begin(), order_.end(), [x](u32 a, u32 b) { return x[a] < x[b] || (x[a] == x[b] && a < b); });
+    xs_.resize(count);
+    ys_.resize(count);
+    zs_.resize(count);
+    radius_.resize(points.radius != NULL ? count : 0);
+    for (u32 i = 0; i < count; i++)
+    {
+        u32 index = order_[i];
+        xs_[i] = points.x[index];
+        ys_[i] = points.y[index];
+        zs_[i] = points.z[index];
+        if (points.radius != NULL)
+        {
+            radius_[i] = points.radius[index];
+        }
+    }
+
+    size_t total = pairs.size();
+    u32 next_range = 0;
+    active_.clear();
+    for (u32 begin = 0; begin < count; begin += AOE_JOIN_BLOCK)
+    {
+        u32 end = begin + AOE_JOIN_BLOCK < count ? begin + AOE_JOIN_BLOCK : count;
+        f32 block_min_x = xs_[begin];
+        f32 block_max_x = xs_[end - 1];
+        f32 block_min_y = ys_[begin];
+        f32 block_max_y = ys_[begin];
+        for (u32 i = begin + 1; i < end; i++)
+        {
+            block_min_y = ys_[i] < block_min_y ? ys_[i] : block_min_y;
+            block_max_y = ys_[i] > block_max_y ? ys_[i] : block_max_y;
+        }
+
+        //进入和离开活动集合
+        while (next_range < shape_count && ranges_[next_range].bounds.min.x <= block_max_x)
+        {
+            active_.push_back(next_range++);
+        }
+        active_.erase(std::remove_if(active_.begin(), active_.end(), [&](u32 range) { return ranges_[range].bounds.max.x < block_min_x; }), active_.end());
+
+        for (u32 range_index : active_)
+        {
+            const ShapeRange& range = ranges_[range_index];
+            if (range.bounds.max.y < block_min_y || range.bounds.min.y > block_max_y)
+            {
+                continue;
+            }
+            //块内已按x排序, 与包围盒x范围相交的是连续的一段
+            u32 first = (u32)(std::lower_bound(xs_.begin() + begin, xs_.begin() + end, range.bounds.min.x) - xs_.begin());
+            u32 last = (u32)(std::upper_bound(xs_.begin() + first, xs_.begin() + end, range.bounds.max.x) - xs_.begin());
+            if (first >= last)
+            {
+                continue;
+            }
+            AreaPoints span = { xs_.data() + first, ys_.data() + first, zs_.data() + first,
+                points.radius == NULL ? NULL : radius_.data() + first, last - first };
+            s32 ret = shapes[range.shape].PointsInRange(span, bits_, dist_);
+            if (ret < 0)
+            {
+                LOGFMTE("join resolve shape test error:<%d>. shape:<%u>", ret, range.shape);
+                return ret;
+            }
+            if (ret == 0)
+            {
+                continue;
+            }
+            for (u32 word = 0; word < AreaHitWords(span.count); word++)
+            {
+                u64 bits = bits_[word];
+                while (bits != 0)
+                {
+                    u32 bit = 0;
+                    while (((bits >> bit) & 1u) == 0)
+                    {
+                        bit++;
+                    }
+                    bits &= bits - 1;
+                    u32 index = word * 64 + bit;
+                    pairs.push_back({ range.shape, order_[first + index], dist_[index] });
+                }
+            }
+        }
+    }
+    return (s32)(pairs.size() - total);
+}
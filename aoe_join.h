@@ -0,0 +1,60 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+#ifndef AOE_JOIN_H
+#define AOE_JOIN_H
+
+#include "aoe_shape.h"
+
+struct AoeJoinPair
+{
+    u32 shape; //shapes中的下标
+    u32 index; //points中的下标
+    f32 dist_sq;
+};
+
+const u32 AOE_JOIN_BLOCK = 256; //每次扫描的目标数 保证一块目标数据在所有相交形状检测期间留在缓存中
+
+//多形状对多目标的空间连接. 目标按x排序后分块扫描, 形状按包围盒x范围进入/离开活动集合,
+//每块目标只与活动集合中包围盒相交的形状做批量检测. 目标数据整体只读一遍, 不再每个形状扫描一次全部目标.
+//结果按目标块的顺序输出, 同一块内按形状进入活动集合的顺序, 相同输入的输出顺序固定.
+class AoeJoin
+{
+public:
+    //shapes需要已经Init. 命中的(形状, 目标)追加到pairs. 返回命中个数, 负数为错误.
+    s32 Resolve(AreaShape* shapes, u32 shape_count, const AreaPoints& points, std::vector<AoeJoinPair>& pairs);
+private:
+    struct ShapeRange
+    {
+        u32 shape;
+        AreaBounds bounds; //按最大目标半径扩展过
+    };
+private:
+    std::vector<u32> order_; //按x排序后的目标下标
+    std::vector<f32> xs_;
+    std::vector<f32> ys_;
+    std::vector<f32> zs_;
+    std::vector<f32> radius_;
+    std::vector<ShapeRange> ranges_; //按包围盒min.x排序
+    std::vector<u32> active_;
+    u64 bits_[AOE_JOIN_BLOCK / 64];
+    f32 dist_[AOE_JOIN_BLOCK];
+};
+
+
+#endif //
@@ -0,0 +1,521 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "aoe_kernel_impl.h"
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define AOE_KERNEL_X86 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+//本编译单元以默认选项编译, 只包含标量版本和分派逻辑.
+
+const AreaKernelTable* AreaKernelTableScalar()
+{
+    return AreaKernelMakeTable<AoeSimdScalar>();
+}
+
+static const AreaKernelTable* AreaKernelTableOf(u32 level)
+{
+    switch (level)
+    {
+    case AREA_KERNEL_SCALAR:
+        return AreaKernelTableScalar();
+    case AREA_KERNEL_SSE41:
+        return AreaKernelTableSSE41();
+    case AREA_KERNEL_AVX2:
+        return AreaKernelTableAVX2();
+    case AREA_KERNEL_AVX512:
+        return AreaKernelTableAVX512();
+    default:
+        break;
+    }
+    return NULL;
+}
+
+#if AOE_KERNEL_X86
+static void AreaKernelCpuid(u32 leaf, u32 sub, u32 regs[4])
+{
+#ifdef _MSC_VER
+    int info[4] = { 0 };
+    __cpuidex(info, (int)leaf, (int)sub);
+    for (int i = 0; i < 4; i++)
+    {
+        regs[i] = (u32)info[i];
+    }
+#else
+    __cpuid_count(leaf, sub, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static u64 AreaKernelXgetbv()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    u32 eax = 0;
+    u32 edx = 0;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((u64)edx << 32) | eax;
+#endif
+}
+#endif
+
+//CPU本身支持的级别 AVX以上还需要操作系统保存对应的寄存器状态
+static u32 AreaKernelCpuLevel()
+{
+    u32 level = AREA_KERNEL_SCALAR;
+#if AOE_KERNEL_X86
+    u32 regs[4] = { 0 };
+    AreaKernelCpuid(0, 0, regs);
+    u32 max_leaf = regs[0];
+    if (max_leaf < 1)
+    {
+        return level;
+    }
+    AreaKernelCpuid(1, 0, regs);
+    bool sse41 = (regs[2] & (1u << 19)) != 0;
+    bool osxsave = (regs[2] & (1u << 27)) != 0;
+    bool avx = (regs[2] & (1u << 28)) != 0;
+    if (!sse41)
+    {
+        return level;
+    }
+    level = AREA_KERNEL_SSE41;
+    if (!osxsave || !avx || max_leaf < 7)
+    {
+        return level;
+    }
+    u64 xcr0 = AreaKernelXgetbv();
+    if ((xcr0 & 0x6) != 0x6)
+    {
+        return level;
+    }
+    AreaKernelCpuid(7, 0, regs);
+    if ((regs[1] & (1u << 5)) == 0)
+    {
+        return level;
+    }
+    level = AREA_KERNEL_AVX2;
+    if ((regs[1] & (1u << 16)) != 0 && (xcr0 & 0xe6) == 0xe6)
+    {
+        level = AREA_KERNEL_AVX512;
+    }
+#endif
+    return level;
+}
+
+static bool AreaKernelUsable(u32 level)
+{
+    return level < AREA_KERNEL_LEVEL_MAX && level <= AreaKernelCpuLevel() && AreaKernelTableOf(level) != NULL;
+}
+
+u32 AreaKernelDetectLevel()
+{
+    u32 level = AreaKernelCpuLevel();
+    while (level > AREA_KERNEL_SCALAR && AreaKernelTableOf(level) == NULL)
+    {
+        level--;
+    }
+    return level;
+}
+
+const char* AreaKernelLevelName(u32 level)
+{
+    switch (level)
+    {
+    case AREA_KERNEL_SCALAR:
+        return "scalar";
+    case AREA_KERNEL_SSE41:
+        return "sse41";
+    case AREA_KERNEL_AVX2:
+        return "avx2";
+    case AREA_KERNEL_AVX512:
+        return "avx512";
+    default:
+        break;
+    }
+    return "unknown";
+}
+
+struct AreaKernelDispatch
+{
+    std::atomic<const AreaKernelTable*> table;
+    std::atomic<u32> level;
+    AreaKernelDispatch()
+    {
+        u32 detect = AreaKernelDetectLevel();
+        const char* env = getenv("AOE_KERNEL_LEVEL");
+        if (env != NULL && env[0] != '\0')
+        {
+            u32 want = AREA_KERNEL_LEVEL_MAX;
+            for (u32 i = 0; i < AREA_KERNEL_LEVEL_MAX; i++)
+            {
+                if (strcmp(env, AreaKernelLevelName(i)) == 0)
+                {
+                    want = i;
+                }
+            }
+            if (AreaKernelUsable(want))
+            {
+                detect = want;
+            }
+            else
+            {
+                LOGFMTE("AOE_KERNEL_LEVEL:<%s> not usable, use <%s>", env, AreaKernelLevelName(detect));
+            }
+        }
+        table.store(AreaKernelTableOf(detect));
+        level.store(detect);
+    }
+};
+
+static AreaKernelDispatch& AreaKernelInstance()
+{
+    static AreaKernelDispatch dispatch;
+    return dispatch;
+}
+
+u32 AreaKernelActiveLevel()
+{
+    return AreaKernelInstance().level.load(std::memory_order_relaxed);
+}
+
+s32 AreaKernelForceLevel(u32 level)
+{
+    if (!AreaKernelUsable(level))
+    {
+        LOGFMTE("area kernel level:<%u> not usable. cpu level:<%u>", level, AreaKernelCpuLevel());
+        return -1;
+    }
+    AreaKernelDispatch& dispatch = AreaKernelInstance();
+    dispatch.table.store(AreaKernelTableOf(level));
+    dispatch.level.store(level);
+    return 0;
+}
+
+s32 RunAreaKernel(const AreaCircleKernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq)
+{
+    return AreaKernelInstance().table.load(std::memory_order_relaxed)->circle(kernel, points, hit_bits, dist_sq);
+}
+
+s32 RunAreaKernel(const AreaFanKernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq)
+{
+    return AreaKernelInstance().table.load(std::memory_order_relaxed)->fan(kernel, points, hit_bits, dist_sq);
+}
+
+s32 RunAreaKernel(const AreaRectKernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq)
+{
+    return AreaKernelInstance().table.load(std::memory_order_relaxed)->rect(kernel, points, hit_bits, dist_sq);
+}
+
+s32 RunAreaKernel(const AreaFovKernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq)
+{
+    return AreaKernelInstance().table.load(std::memory_order_relaxed)->fov(kernel, points, hit_bits, dist_sq);
+}
+
+s32 RunAreaKernel(const AreaCapsuleKernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq)
+{
+    return AreaKernelInstance().table.load(std::memory_order_relaxed)->capsule(kernel, points, hit_bits, dist_sq);
+}
+
+s32 RunAreaKernel(const AreaPolygonKernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq)
+{
+    return AreaKernelInstance().table.load(std::memory_order_relaxed)->polygon(kernel, points, hit_bits, dist_sq);
+}
+
+s32 RunAreaKernel(const AreaNearerKernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq)
+{
+    return AreaKernelInstance().table.load(std::memory_order_relaxed)->nearer(kernel, points, hit_bits, dist_sq);
+}
+
+
+s32 AreaKernelPointInRange(const AreaCircleKernel& kernel, const Point3& pos, f32 radius, f32& dist_sq)
+{
+    if (fabsf(pos.z - kernel.anchor.z) > kernel.high)
+    {
+        return 1;
+    }
+    f32 dx = pos.x - kernel.anchor.x;
+    f32 dy = pos.y - kernel.anchor.y;
+    dist_sq = dx * dx + dy * dy;
+    f32 range = kernel.max_radius + radius + kernel.anchor_radius;
+    if (dist_sq > range * range)
+    {
+        return 2;
+    }
+    if (kernel.min_radius_sq >= FLOAT_POINT_PRECISION && dist_sq < kernel.min_radius_sq)
+    {
+        return 3;
+    }
+    return 0;
+}
+
+s32 AreaKernelPointInRange(const AreaFanKernel& kernel, const Point3& pos, f32 radius, f32& dist_sq)
+{
+    if (fabsf(pos.z - kernel.anchor.z) > kernel.high)
+    {
+        return 1;
+    }
+    f32 dx = pos.x - kernel.anchor.x;
+    f32 dy = pos.y - kernel.anchor.y;
+    dist_sq = dx * dx + dy * dy;
+    f32 range = kernel.radian_radius + radius + kernel.anchor_radius;
+    if (dist_sq > range * range)
+    {
+        return 2;
+    }
+    f32 both = radius + kernel.anchor_radius;
+    if (dist_sq < FLOAT_POINT_PRECISION || dist_sq <= both * both || kernel.is_circle)
+    {
+        return 0;
+    }
+
+    f32 left_dist = dx * kernel.left_normal.x + dy * kernel.left_normal.y;
+    f32 right_dist = dx * kernel.right_normal.x + dy * kernel.right_normal.y;
+    bool in_radian = kernel.is_wide ? (left_dist <= 0.0f || right_dist <= 0.0f) : (left_dist <= 0.0f && right_dist <= 0.0f);
+    if (in_radian)
+    {
+        return 0;
+    }
+    if (radius < FLOAT_POINT_PRECISION)
+    {
+        return 3;
+    }
+
+    //同侧的边
+    f32 side = kernel.normalize_dir.x * dy - kernel.normalize_dir.y * dx;
+    const Point3& edge_dir = side >= 0.0f ? kernel.left_dir : kernel.right_dir;
+    f32 edge_dist = side >= 0.0f ? left_dist : right_dist;
+    f32 project = dx * edge_dir.x + dy * edge_dir.y;
+    f32 radius_sq = radius * radius;
+    if (project <= 0.0f)
+    {
+        return 4;
+    }
+    if (project < kernel.edge_length)
+    {
+        return edge_dist * edge_dist <= radius_sq ? 0 : 4;
+    }
+    f32 end_x = dx - edge_dir.x * kernel.edge_length;
+    f32 end_y = dy - edge_dir.y * kernel.edge_length;
+    return end_x * end_x + end_y * end_y <= radius_sq ? 0 : 4;
+}
+
+s32 AreaKernelPointInRange(const AreaRectKernel& kernel, const Point3& pos, f32 radius, f32& dist_sq)
+{
+    if (fabsf(pos.z - kernel.anchor.z) > kernel.high)
+    {
+        return 1;
+    }
+    f32 dx = pos.x - kernel.anchor.x;
+    f32 dy = pos.y - kernel.anchor.y;
+    dist_sq = dx * dx + dy * dy;
+    if (kernel.collide_test && dist_sq < FLOAT_POINT_PRECISION)
+    {
+        return 0;
+    }
+    f32 range = kernel.distance + radius + kernel.anchor_radius;
+    if (dist_sq > range * range)
+    {
+        return 2;
+    }
+    f32 both = radius + kernel.anchor_radius;
+    if (kernel.collide_test && dist_sq < both * both)
+    {
+        return 0;
+    }
+
+    f32 local_x = pos.x - kernel.center.x;
+    f32 local_y = pos.y - kernel.center.y;
+    f32 over_x = fabsf(local_x * kernel.dir.x + local_y * kernel.dir.y) - kernel.half_length;
+    f32 over_y = fabsf(local_y * kernel.dir.x - local_x * kernel.dir.y) - kernel.half_wide;
+    f32 out_x = over_x > 0.0f ? over_x : 0.0f;
+    f32 out_y = over_y > 0.0f ? over_y : 0.0f;
+    f32 out_sq = out_x * out_x + out_y * out_y;
+    if (out_sq > 0.0f)
+    {
+        if (radius < FLOAT_POINT_PRECISION)
+        {
+            return 2;
+        }
+        return out_sq > radius * radius ? 3 : 0;
+    }
+    if (kernel.frame_test)
+    {
+        f32 over = over_x > over_y ? over_x : over_y;
+        if (over < -radius)
+        {
+            return 4;
+        }
+    }
+    return 0;
+}
+
+s32 AreaKernelPointInRange(const AreaFovKernel& kernel, const Point3& pos, f32 radius, f32& dist_sq)
+{
+    (void)radius;
+    Point3 target_dir = pos - kernel.apex;
+    dist_sq = target_dir.square_length();
+    if (dist_sq > kernel.far_sq)
+    {
+        return 4;
+    }
+    if (target_dir.is_zero())
+    {
+        return 0;
+    }
+
+    float cos_dist = target_dir.dot(kernel.dir);
+    if (cos_dist < 0.0f)
+    {
+        return 9;
+    }
+    if (cos_dist * cos_dist < kernel.cos_half_sq * dist_sq)
+    {
+        return 10;
+    }
+
+    //四楞体视锥
+    float diff = kernel.top_normal.dot(target_dir);
+    u32 sign_bit = SignBitF(diff);
+    diff = kernel.botton_normal.dot(target_dir);
+    if (SignBitF(diff) == sign_bit)
+    {
+        return 15;
+    }
+    diff = kernel.left_normal.dot(target_dir);
+    sign_bit = SignBitF(diff);
+    diff = kernel.right_normal.dot(target_dir);
+    if (SignBitF(diff) == sign_bit)
+    {
+        return 17;
+    }
+
+    //近距
+    if (dist_sq <= kernel.near_sq)
+    {
+        return 0;
+    }
+
+    //长方体远摄
+    diff = (pos - kernel.left_top_pos).dot(kernel.vertical_dir);
+    sign_bit = SignBitF(diff);
+    diff = (pos - kernel.left_botton_pos).dot(kernel.vertical_dir);
+    if (SignBitF(diff) == sign_bit)
+    {
+        return 20;
+    }
+
+    diff = (pos - kernel.left_top_pos).dot(kernel.horizontal_dir);
+    sign_bit = SignBitF(diff);
+    diff = (pos - kernel.right_top_pos).dot(kernel.horizontal_dir);
+    if (SignBitF(diff) == sign_bit)
+    {
+        return 21;
+    }
+
+    return 0;
+}
+
+s32 AreaKernelPointInRange(const AreaCapsuleKernel& kernel, const Point3& pos, f32 radius, f32& dist_sq)
+{
+    if (fabsf(pos.z - kernel.anchor.z) > kernel.high)
+    {
+        return 1;
+    }
+    f32 dx = pos.x - kernel.anchor.x;
+    f32 dy = pos.y - kernel.anchor.y;
+    dist_sq = dx * dx + dy * dy;
+    f32 project = dx * kernel.dir.x + dy * kernel.dir.y;
+    project = project < 0.0f ? 0.0f : project;
+    project = project > kernel.length ? kernel.length : project;
+    f32 off_x = dx - kernel.dir.x * project;
+    f32 off_y = dy - kernel.dir.y * project;
+    f32 range = kernel.sweep_radius + radius + kernel.anchor_radius;
+    return off_x * off_x + off_y * off_y > range * range ? 2 : 0;
+}
+
+s32 AreaKernelPointInRange(const AreaPolygonKernel& kernel, const Point3& pos, f32 radius, f32& dist_sq)
+{
+    const AreaPolygonKernel& k = kernel;
+    //高度差检测
+    float height_dist = fabsf(pos.z - k.anchor.z);
+    if (height_dist > k.high)
+    {
+        LOGFMTD("range polygon too high anchor z:<%f>, test z:<%f>, limit high:<%f>", k.anchor.z, pos.z, k.high);
+        return 1;
+    }
+
+    f32 dx = pos.x - k.anchor.x;
+    f32 dy = pos.y - k.anchor.y;
+    dist_sq = dx * dx + dy * dy;
+    f32 range = k.reach + radius;
+    if (dist_sq > range * range)
+    {
+        return 2;
+    }
+
+    //是否双方半径相交或者重叠
+    f32 both = radius + k.anchor_radius;
+    if (dist_sq < FLOAT_POINT_PRECISION || dist_sq < both * both)
+    {
+        return 0;
+    }
+
+    //在每条边的内侧即在多边形内
+    f32 over = 0.0f;
+    for (u32 i = 0; i < k.count; i++)
+    {
+        f32 side = (dx - k.vertex_x[i]) * k.normal_x[i] + (dy - k.vertex_y[i]) * k.normal_y[i];
+        over = (i == 0 || side > over) ? side : over;
+    }
+    if (over <= 0.0f)
+    {
+        return 0;
+    }
+    if (radius < FLOAT_POINT_PRECISION)
+    {
+        return 3;
+    }
+
+    //多边形外 到各条边(线段)的最近距离
+    f32 out_sq = 0.0f;
+    for (u32 i = 0; i < k.count; i++)
+    {
+        f32 rel_x = dx - k.vertex_x[i];
+        f32 rel_y = dy - k.vertex_y[i];
+        f32 project = rel_y * k.normal_x[i] - rel_x * k.normal_y[i];
+        project = project < 0.0f ? 0.0f : project;
+        project = project > k.edge_length[i] ? k.edge_length[i] : project;
+        f32 off_x = rel_x + k.normal_y[i] * project;
+        f32 off_y = rel_y - k.normal_x[i] * project;
+        f32 edge_sq = off_x * off_x + off_y * off_y;
+        out_sq = (i == 0 || edge_sq < out_sq) ? edge_sq : out_sq;
+    }
+    if (out_sq > radius * radius)
+    {
+        LOGFMTD("range polygon too far out_sq:<%f>", out_sq);
+        return 3;
+    }
+    return 0;
+}
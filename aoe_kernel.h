@@ -0,0 +1,196 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+#ifndef AOE_KERNEL_H
+#define AOE_KERNEL_H
+
+#include "comm_def.h"
+#include "vector3.h"
+
+using Point3 = Vector3<float>;
+
+//批量检测的目标数据 结构数组(SoA)形式.  radius可以为NULL, 此时所有目标半径视为0.
+struct AreaPoints
+{
+    const f32* x;
+    const f32* y;
+    const f32* z;
+    const f32* radius;
+    u32 count;
+};
+
+//hit_bits需要的u64个数
+inline u32 AreaHitWords(u32 count) { return (count + 63) / 64; }
+inline bool AreaHitTest(const u64* hit_bits, u32 index) { return (hit_bits[index >> 6] >> (index & 63)) & 1u; }
+
+
+//以下为各形状检测核心的参数, 由对应的AreaShapeXXX在检测前填充.
+//批量检测的结果与对应形状的PointInRange逐位一致.
+
+struct AreaCircleKernel
+{
+    Point3 anchor;
+    f32 anchor_radius;
+    f32 min_radius_sq;
+    f32 max_radius;
+    f32 high;
+};
+
+struct AreaFanKernel
+{
+    Point3 anchor;
+    f32 anchor_radius;
+    Point3 normalize_dir;
+    f32 radian;
+    f32 radian_radius;
+    f32 high;
+    u32 is_circle;
+    u32 is_wide;
+    f32 edge_length;
+    Point3 left_dir;
+    Point3 right_dir;
+    Point3 left_normal;
+    Point3 right_normal;
+};
+
+struct AreaRectKernel
+{
+    Point3 anchor;
+    f32 anchor_radius;
+    f32 distance;
+    f32 high;
+    u32 collide_test;
+    u32 frame_test;
+    Point3 center;
+    Point3 dir;
+    f32 half_length;
+    f32 half_wide;
+};
+
+struct AreaFovKernel
+{
+    Point3 apex;
+    f32 far_sq;
+    f32 near_sq;
+    f32 cos_half_sq; //半视角余弦的平方, 半视角不小于90度时为0
+    Point3 dir; //修正后的朝向
+    Point3 top_normal; //四棱锥两组对面的法线
+    Point3 botton_normal;
+    Point3 left_normal;
+    Point3 right_normal;
+    Point3 left_top_pos; //近距长方体
+    Point3 left_botton_pos;
+    Point3 right_top_pos;
+    Point3 vertical_dir; // botton - top
+    Point3 horizontal_dir; // right - left
+};
+
+struct AreaCapsuleKernel
+{
+    Point3 anchor;
+    f32 anchor_radius;
+    Point3 dir;
+    f32 length;
+    f32 sweep_radius;
+    f32 high;
+};
+
+const u32 AREA_POLYGON_MAX_VERTEX = 16;
+
+//凸多边形 顶点为相对定位点的坐标, 逆时针顺序. 第i条边从顶点i到顶点i+1, 边的方向为(-normal_y, normal_x)
+struct AreaPolygonKernel
+{
+    Point3 anchor;
+    f32 anchor_radius;
+    f32 reach; //顶点到定位点的最远距离 和定位点半径取大
+    f32 high;
+    u32 count;
+    f32 vertex_x[AREA_POLYGON_MAX_VERTEX];
+    f32 vertex_y[AREA_POLYGON_MAX_VERTEX];
+    f32 normal_x[AREA_POLYGON_MAX_VERTEX]; //边朝外的单位法线
+    f32 normal_y[AREA_POLYGON_MAX_VERTEX];
+    f32 edge_length[AREA_POLYGON_MAX_VERTEX];
+};
+
+//距离平方小于limit_sq的目标. 最近K个查询在形状检测之前用它筛掉比当前第K近更远的目标
+struct AreaNearerKernel
+{
+    Point3 origin;
+    u32 use_z; //视锥的dist_sq为三维距离
+    f32 limit_sq;
+};
+
+
+//批量检测入口. hit_bits至少AreaHitWords(points.count)个, 第i个目标命中则第i位置1.
+//dist_sq可以为NULL, 非NULL时长度至少为points.count, 只有命中的目标对应的值有效.
+//返回命中个数.  实际执行的指令集版本由运行时分派决定, 各版本结果一致.
+s32 RunAreaKernel(const AreaCircleKernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq);
+s32 RunAreaKernel(const AreaFanKernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq);
+s32 RunAreaKernel(const AreaRectKernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq);
+s32 RunAreaKernel(const AreaFovKernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq);
+s32 RunAreaKernel(const AreaCapsuleKernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq);
+s32 RunAreaKernel(const AreaPolygonKernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq);
+s32 RunAreaKernel(const AreaNearerKernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq);
+
+//单个目标的标量检测. 返回值与对应形状的PointInRange相同: 0为命中, 正数为未通过的判定阶段.
+//批量检测只给出命中位, 统计未命中原因时用它对未命中的目标补一次检测.
+s32 AreaKernelPointInRange(const AreaCircleKernel& kernel, const Point3& pos, f32 radius, f32& dist_sq);
+s32 AreaKernelPointInRange(const AreaFanKernel& kernel, const Point3& pos, f32 radius, f32& dist_sq);
+s32 AreaKernelPointInRange(const AreaRectKernel& kernel, const Point3& pos, f32 radius, f32& dist_sq);
+s32 AreaKernelPointInRange(const AreaFovKernel& kernel, const Point3& pos, f32 radius, f32& dist_sq);
+s32 AreaKernelPointInRange(const AreaCapsuleKernel& kernel, const Point3& pos, f32 radius, f32& dist_sq);
+s32 AreaKernelPointInRange(const AreaPolygonKernel& kernel, const Point3& pos, f32 radius, f32& dist_sq);
+
+
+//运行时指令集分派
+enum AreaKernelLevel
+{
+    AREA_KERNEL_SCALAR = 0,
+    AREA_KERNEL_SSE41 = 1,
+    AREA_KERNEL_AVX2 = 2,
+    AREA_KERNEL_AVX512 = 3,
+    AREA_KERNEL_LEVEL_MAX,
+};
+
+struct AreaKernelTable
+{
+    s32 (*circle)(const AreaCircleKernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq);
+    s32 (*fan)(const AreaFanKernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq);
+    s32 (*rect)(const AreaRectKernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq);
+    s32 (*fov)(const AreaFovKernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq);
+    s32 (*capsule)(const AreaCapsuleKernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq);
+    s32 (*polygon)(const AreaPolygonKernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq);
+    s32 (*nearer)(const AreaNearerKernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq);
+};
+
+//各指令集编译单元提供的检测表, 该指令集没有编译进来时返回NULL
+const AreaKernelTable* AreaKernelTableScalar();
+const AreaKernelTable* AreaKernelTableSSE41();
+const AreaKernelTable* AreaKernelTableAVX2();
+const AreaKernelTable* AreaKernelTableAVX512();
+
+//CPU支持并且已编译的最高级别
+u32 AreaKernelDetectLevel();
+//当前使用的级别. 首次使用时按AreaKernelDetectLevel选择, 环境变量AOE_KERNEL_LEVEL(scalar/sse41/avx2/avx512)可以指定级别.
+u32 AreaKernelActiveLevel();
+//强制使用指定级别, 用于在同一台机器上对比各级别. CPU不支持或未编译时返回非0并保持原级别.
+s32 AreaKernelForceLevel(u32 level);
+const char* AreaKernelLevelName(u32 level);
+
+
+#endif //
@@ -0,0 +1,410 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+#ifndef AOE_KERNEL_IMPL_H
+#define AOE_KERNEL_IMPL_H
+
+#include "aoe_kernel.h"
+#include "aoe_simd.h"
+
+//检测核心的模板实现, 按向量宽度实例化.
+//每个AreaKernelLanes检测V::WIDTH个连续目标, 返回命中位. 判定顺序与各形状的PointInRange完全一致.
+//只在本文件内部使用, 放在匿名空间内避免不同指令集的实例互相覆盖.
+
+namespace
+{
+    //与AreaHitWords相同. 不直接使用头文件中的内联函数, 免得本编译单元以扩展指令集编译出的副本被其他编译单元引用.
+    inline u32 AreaKernelHitWords(u32 count) { return (count + 63) / 64; }
+
+    template<class V>
+    struct AreaLaneInput
+    {
+        typename V::F x;
+        typename V::F y;
+        typename V::F z;
+        typename V::F radius;
+        AreaLaneInput(const AreaPoints& points, u32 offset)
+        {
+            x = V::Load(points.x + offset);
+            y = V::Load(points.y + offset);
+            z = V::Load(points.z + offset);
+            radius = points.radius != NULL ? V::Load(points.radius + offset) : V::Set(0.0f);
+        }
+    };
+
+    template<class V>
+    inline u32 AreaKernelLanes(const AreaCircleKernel& k, const AreaLaneInput<V>& in, f32* dist_sq)
+    {
+        typedef typename V::F F;
+        typedef typename V::M M;
+        M done = V::Gt(V::Abs(V::Sub(in.z, V::Set(k.anchor.z))), V::Set(k.high));
+
+        F dx = V::Sub(in.x, V::Set(k.anchor.x));
+        F dy = V::Sub(in.y, V::Set(k.anchor.y));
+        F dist = V::Add(V::Mul(dx, dx), V::Mul(dy, dy));
+        if (dist_sq != NULL)
+        {
+            V::Store(dist_sq, dist);
+        }
+        F range = V::Add(V::Add(V::Set(k.max_radius), in.radius), V::Set(k.anchor_radius));
+        done = V::Or(done, V::Gt(dist, V::Mul(range, range)));
+        if (k.min_radius_sq >= FLOAT_POINT_PRECISION)
+        {
+            done = V::Or(done, V::Lt(dist, V::Set(k.min_radius_sq)));
+        }
+        return V::Bits(V::Not(done));
+    }
+
+    template<class V>
+    inline u32 AreaKernelLanes(const AreaFanKernel& k, const AreaLaneInput<V>& in, f32* dist_sq)
+    {
+        typedef typename V::F F;
+        typedef typename V::M M;
+        M done = V::Gt(V::Abs(V::Sub(in.z, V::Set(k.anchor.z))), V::Set(k.high));
+        M hit = V::False();
+
+        F dx = V::Sub(in.x, V::Set(k.anchor.x));
+        F dy = V::Sub(in.y, V::Set(k.anchor.y));
+        F dist = V::Add(V::Mul(dx, dx), V::Mul(dy, dy));
+        if (dist_sq != NULL)
+        {
+            V::Store(dist_sq, dist);
+        }
+        F range = V::Add(V::Add(V::Set(k.radian_radius), in.radius), V::Set(k.anchor_radius));
+        done = V::Or(done, V::Gt(dist, V::Mul(range, range)));
+
+        F both = V::Add(in.radius, V::Set(k.anchor_radius));
+        M m = V::Or(V::Lt(dist, V::Set(FLOAT_POINT_PRECISION)), V::Le(dist, V::Mul(both, both)));
+        m = V::AndNot(m, done);
+        hit = V::Or(hit, m);
+        done = V::Or(done, m);
+        if (!k.is_circle)
+        {
+            const F zero = V::Set(0.0f);
+            F left = V::Add(V::Mul(dx, V::Set(k.left_normal.x)), V::Mul(dy, V::Set(k.left_normal.y)));
+            F right = V::Add(V::Mul(dx, V::Set(k.right_normal.x)), V::Mul(dy, V::Set(k.right_normal.y)));
+            M in_radian = k.is_wide ? V::Or(V::Le(left, zero), V::Le(right, zero)) : V::And(V::Le(left, zero), V::Le(right, zero));
+            m = V::AndNot(in_radian, done);
+            hit = V::Or(hit, m);
+            done = V::Or(done, m);
+            done = V::Or(done, V::Lt(in.radius, V::Set(FLOAT_POINT_PRECISION)));
+            if (V::All(done))
+            {
+                return V::Bits(hit);
+            }
+
+            //同侧的边
+            F side = V::Sub(V::Mul(V::Set(k.normalize_dir.x), dy), V::Mul(V::Set(k.normalize_dir.y), dx));
+            M is_left = V::Ge(side, zero);
+            F edge_x = V::Select(is_left, V::Set(k.left_dir.x), V::Set(k.right_dir.x));
+            F edge_y = V::Select(is_left, V::Set(k.left_dir.y), V::Set(k.right_dir.y));
+            F edge_dist = V::Select(is_left, left, right);
+            F project = V::Add(V::Mul(dx, edge_x), V::Mul(dy, edge_y));
+            F radius_sq = V::Mul(in.radius, in.radius);
+            F length = V::Set(k.edge_length);
+            M on_edge = V::And(V::Lt(project, length), V::Le(V::Mul(edge_dist, edge_dist), radius_sq));
+            F end_x = V::Sub(dx, V::Mul(edge_x, length));
+            F end_y = V::Sub(dy, V::Mul(edge_y, length));
+            M on_end = V::And(V::Ge(project, length), V::Le(V::Add(V::Mul(end_x, end_x), V::Mul(end_y, end_y)), radius_sq));
+            m = V::AndNot(V::And(V::Gt(project, zero), V::Or(on_edge, on_end)), done);
+            hit = V::Or(hit, m);
+            return V::Bits(hit);
+        }
+        return V::Bits(V::Not(V::AndNot(done, hit)));
+    }
+
+    template<class V>
+    inline u32 AreaKernelLanes(const AreaRectKernel& k, const AreaLaneInput<V>& in, f32* dist_sq)
+    {
+        typedef typename V::F F;
+        typedef typename V::M M;
+        const F precision = V::Set(FLOAT_POINT_PRECISION);
+        M done = V::Gt(V::Abs(V::Sub(in.z, V::Set(k.anchor.z))), V::Set(k.high));
+        M hit = V::False();
+
+        F dx = V::Sub(in.x, V::Set(k.anchor.x));
+        F dy = V::Sub(in.y, V::Set(k.anchor.y));
+        F dist = V::Add(V::Mul(dx, dx), V::Mul(dy, dy));
+        if (dist_sq != NULL)
+        {
+            V::Store(dist_sq, dist);
+        }
+        M m;
+        if (k.collide_test)
+        {
+            m = V::AndNot(V::Lt(dist, precision), done);
+            hit = V::Or(hit, m);
+            done = V::Or(done, m);
+        }
+        F range = V::Add(V::Add(V::Set(k.distance), in.radius), V::Set(k.anchor_radius));
+        done = V::Or(done, V::Gt(dist, V::Mul(range, range)));
+        if (k.collide_test)
+        {
+            F both = V::Add(in.radius, V::Set(k.anchor_radius));
+            m = V::AndNot(V::Lt(dist, V::Mul(both, both)), done);
+            hit = V::Or(hit, m);
+            done = V::Or(done, m);
+        }
+        if (V::All(done))
+        {
+            return V::Bits(hit);
+        }
+
+        const F zero = V::Set(0.0f);
+        F dir_x = V::Set(k.dir.x);
+        F dir_y = V::Set(k.dir.y);
+        F local_x = V::Sub(in.x, V::Set(k.center.x));
+        F local_y = V::Sub(in.y, V::Set(k.center.y));
+        F over_x = V::Sub(V::Abs(V::Add(V::Mul(local_x, dir_x), V::Mul(local_y, dir_y))), V::Set(k.half_length));
+        F over_y = V::Sub(V::Abs(V::Sub(V::Mul(local_y, dir_x), V::Mul(local_x, dir_y))), V::Set(k.half_wide));
+        F out_x = V::Select(V::Gt(over_x, zero), over_x, zero);
+        F out_y = V::Select(V::Gt(over_y, zero), over_y, zero);
+        F out_sq = V::Add(V::Mul(out_x, out_x), V::Mul(out_y, out_y));
+        M outside = V::Gt(out_sq, zero);
+        done = V::Or(done, V::And(outside, V::Lt(in.radius, precision)));
+        done = V::Or(done, V::And(outside, V::Gt(out_sq, V::Mul(in.radius, in.radius))));
+        if (k.frame_test)
+        {
+            F over = V::Select(V::Gt(over_x, over_y), over_x, over_y);
+            done = V::Or(done, V::AndNot(V::Lt(over, V::Sub(zero, in.radius)), outside));
+        }
+        return V::Bits(V::Or(hit, V::Not(done)));
+    }
+
+    template<class V>
+    inline typename V::F AreaKernelDot(const typename V::F& x, const typename V::F& y, const typename V::F& z, const Point3& v)
+    {
+        return V::Add(V::Add(V::Mul(x, V::Set(v.x)), V::Mul(y, V::Set(v.y))), V::Mul(z, V::Set(v.z)));
+    }
+
+    template<class V>
+    inline u32 AreaKernelLanes(const AreaFovKernel& k, const AreaLaneInput<V>& in, f32* dist_sq)
+    {
+        typedef typename V::F F;
+        typedef typename V::M M;
+        const F precision = V::Set(FLOAT_POINT_PRECISION);
+        F tx = V::Sub(in.x, V::Set(k.apex.x));
+        F ty = V::Sub(in.y, V::Set(k.apex.y));
+        F tz = V::Sub(in.z, V::Set(k.apex.z));
+        F dist = V::Add(V::Add(V::Mul(tx, tx), V::Mul(ty, ty)), V::Mul(tz, tz));
+        if (dist_sq != NULL)
+        {
+            V::Store(dist_sq, dist);
+        }
+        M done = V::Gt(dist, V::Set(k.far_sq));
+        M hit = V::And(V::And(V::Lt(V::Abs(tx), precision), V::Lt(V::Abs(ty), precision)), V::Lt(V::Abs(tz), precision));
+        hit = V::AndNot(hit, done);
+        done = V::Or(done, hit);
+        if (V::All(done))
+        {
+            return V::Bits(hit);
+        }
+
+        F cos_dist = AreaKernelDot<V>(tx, ty, tz, k.dir);
+        done = V::Or(done, V::Lt(cos_dist, V::Set(0.0f)));
+        done = V::Or(done, V::Lt(V::Mul(cos_dist, cos_dist), V::Mul(V::Set(k.cos_half_sq), dist)));
+
+        //四棱锥两组对面
+        done = V::Or(done, V::SameSign(AreaKernelDot<V>(tx, ty, tz, k.top_normal), AreaKernelDot<V>(tx, ty, tz, k.botton_normal)));
+        done = V::Or(done, V::SameSign(AreaKernelDot<V>(tx, ty, tz, k.left_normal), AreaKernelDot<V>(tx, ty, tz, k.right_normal)));
+        if (V::All(done))
+        {
+            return V::Bits(hit);
+        }
+
+        //近距直接命中 其余需要在近距长方体内
+        M near_box = V::Le(dist, V::Set(k.near_sq));
+        F ltx = V::Sub(in.x, V::Set(k.left_top_pos.x));
+        F lty = V::Sub(in.y, V::Set(k.left_top_pos.y));
+        F ltz = V::Sub(in.z, V::Set(k.left_top_pos.z));
+        F lbx = V::Sub(in.x, V::Set(k.left_botton_pos.x));
+        F lby = V::Sub(in.y, V::Set(k.left_botton_pos.y));
+        F lbz = V::Sub(in.z, V::Set(k.left_botton_pos.z));
+        F rtx = V::Sub(in.x, V::Set(k.right_top_pos.x));
+        F rty = V::Sub(in.y, V::Set(k.right_top_pos.y));
+        F rtz = V::Sub(in.z, V::Set(k.right_top_pos.z));
+        M box_out = V::SameSign(AreaKernelDot<V>(ltx, lty, ltz, k.vertical_dir), AreaKernelDot<V>(lbx, lby, lbz, k.vertical_dir));
+        box_out = V::Or(box_out, V::SameSign(AreaKernelDot<V>(ltx, lty, ltz, k.horizontal_dir), AreaKernelDot<V>(rtx, rty, rtz, k.horizontal_dir)));
+        return V::Bits(V::Or(hit, V::AndNot(V::Or(near_box, V::Not(box_out)), done)));
+    }
+
+    template<class V>
+    inline u32 AreaKernelLanes(const AreaCapsuleKernel& k, const AreaLaneInput<V>& in, f32* dist_sq)
+    {
+        typedef typename V::F F;
+        typedef typename V::M M;
+        const F zero = V::Set(0.0f);
+        M done = V::Gt(V::Abs(V::Sub(in.z, V::Set(k.anchor.z))), V::Set(k.high));
+
+        F dx = V::Sub(in.x, V::Set(k.anchor.x));
+        F dy = V::Sub(in.y, V::Set(k.anchor.y));
+        F dist = V::Add(V::Mul(dx, dx), V::Mul(dy, dy));
+        if (dist_sq != NULL)
+        {
+            V::Store(dist_sq, dist);
+        }
+        F dir_x = V::Set(k.dir.x);
+        F dir_y = V::Set(k.dir.y);
+        F length = V::Set(k.length);
+        F project = V::Add(V::Mul(dx, dir_x), V::Mul(dy, dir_y));
+        project = V::Select(V::Lt(project, zero), zero, project);
+        project = V::Select(V::Gt(project, length), length, project);
+        F off_x = V::Sub(dx, V::Mul(dir_x, project));
+        F off_y = V::Sub(dy, V::Mul(dir_y, project));
+        F range = V::Add(V::Add(V::Set(k.sweep_radius), in.radius), V::Set(k.anchor_radius));
+        done = V::Or(done, V::Gt(V::Add(V::Mul(off_x, off_x), V::Mul(off_y, off_y)), V::Mul(range, range)));
+        return V::Bits(V::Not(done));
+    }
+
+    template<class V>
+    inline u32 AreaKernelLanes(const AreaPolygonKernel& k, const AreaLaneInput<V>& in, f32* dist_sq)
+    {
+        typedef typename V::F F;
+        typedef typename V::M M;
+        const F zero = V::Set(0.0f);
+        M done = V::Gt(V::Abs(V::Sub(in.z, V::Set(k.anchor.z))), V::Set(k.high));
+        M hit = V::False();
+
+        F dx = V::Sub(in.x, V::Set(k.anchor.x));
+        F dy = V::Sub(in.y, V::Set(k.anchor.y));
+        F dist = V::Add(V::Mul(dx, dx), V::Mul(dy, dy));
+        if (dist_sq != NULL)
+        {
+            V::Store(dist_sq, dist);
+        }
+        F range = V::Add(V::Set(k.reach), in.radius);
+        done = V::Or(done, V::Gt(dist, V::Mul(range, range)));
+
+        F both = V::Add(in.radius, V::Set(k.anchor_radius));
+        M m = V::Or(V::Lt(dist, V::Set(FLOAT_POINT_PRECISION)), V::Lt(dist, V::Mul(both, both)));
+        m = V::AndNot(m, done);
+        hit = V::Or(hit, m);
+        done = V::Or(done, m);
+        if (V::All(done))
+        {
+            return V::Bits(hit);
+        }
+
+        //各边法线方向上超出的最大距离
+        F over = zero;
+        for (u32 i = 0; i < k.count; i++)
+        {
+            F side = V::Add(V::Mul(V::Sub(dx, V::Set(k.vertex_x[i])), V::Set(k.normal_x[i])), V::Mul(V::Sub(dy, V::Set(k.vertex_y[i])), V::Set(k.normal_y[i])));
+            over = i == 0 ? side : V::Select(V::Gt(side, over), side, over);
+        }
+        m = V::AndNot(V::Le(over, zero), done);
+        hit = V::Or(hit, m);
+        done = V::Or(done, m);
+        done = V::Or(done, V::Lt(in.radius, V::Set(FLOAT_POINT_PRECISION)));
+        if (V::All(done))
+        {
+            return V::Bits(hit);
+        }
+
+        //到最近边的距离
+        F out_sq = zero;
+        for (u32 i = 0; i < k.count; i++)
+        {
+            F normal_x = V::Set(k.normal_x[i]);
+            F normal_y = V::Set(k.normal_y[i]);
+            F length = V::Set(k.edge_length[i]);
+            F rel_x = V::Sub(dx, V::Set(k.vertex_x[i]));
+            F rel_y = V::Sub(dy, V::Set(k.vertex_y[i]));
+            F project = V::Sub(V::Mul(rel_y, normal_x), V::Mul(rel_x, normal_y));
+            project = V::Select(V::Lt(project, zero), zero, project);
+            project = V::Select(V::Gt(project, length), length, project);
+            F off_x = V::Add(rel_x, V::Mul(normal_y, project));
+            F off_y = V::Sub(rel_y, V::Mul(normal_x, project));
+            F edge_sq = V::Add(V::Mul(off_x, off_x), V::Mul(off_y, off_y));
+            out_sq = i == 0 ? edge_sq : V::Select(V::Lt(edge_sq, out_sq), edge_sq, out_sq);
+        }
+        m = V::AndNot(V::Le(out_sq, V::Mul(in.radius, in.radius)), done);
+        hit = V::Or(hit, m);
+        return V::Bits(hit);
+    }
+
+    template<class V>
+    inline u32 AreaKernelLanes(const AreaNearerKernel& k, const AreaLaneInput<V>& in, f32* dist_sq)
+    {
+        typedef typename V::F F;
+        F dx = V::Sub(in.x, V::Set(k.origin.x));
+        F dy = V::Sub(in.y, V::Set(k.origin.y));
+        F dist = V::Add(V::Mul(dx, dx), V::Mul(dy, dy));
+        if (k.use_z)
+        {
+            F dz = V::Sub(in.z, V::Set(k.origin.z));
+            dist = V::Add(dist, V::Mul(dz, dz));
+        }
+        if (dist_sq != NULL)
+        {
+            V::Store(dist_sq, dist);
+        }
+        return V::Bits(V::Lt(dist, V::Set(k.limit_sq)));
+    }
+
+    inline s32 AreaKernelPopCount(u32 bits)
+    {
+        s32 count = 0;
+        while (bits != 0)
+        {
+            bits &= bits - 1;
+            count++;
+        }
+        return count;
+    }
+
+    //宽度为V::WIDTH的主循环 + 标量尾部
+    template<class V, class Kernel>
+    inline s32 AreaKernelBatch(const Kernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq)
+    {
+        memset(hit_bits, 0, sizeof(u64) * AreaKernelHitWords(points.count));
+        s32 hits = 0;
+        u32 i = 0;
+        for (; i + V::WIDTH <= points.count; i += V::WIDTH)
+        {
+            u32 bits = AreaKernelLanes<V>(kernel, AreaLaneInput<V>(points, i), dist_sq != NULL ? dist_sq + i : NULL);
+            hit_bits[i >> 6] |= (u64)bits << (i & 63);
+            hits += AreaKernelPopCount(bits);
+        }
+        for (; i < points.count; i++)
+        {
+            u32 bits = AreaKernelLanes<AoeSimdScalar>(kernel, AreaLaneInput<AoeSimdScalar>(points, i), dist_sq != NULL ? dist_sq + i : NULL);
+            hit_bits[i >> 6] |= (u64)bits << (i & 63);
+            hits += (s32)bits;
+        }
+        return hits;
+    }
+
+    template<class V>
+    inline const AreaKernelTable* AreaKernelMakeTable()
+    {
+        static const AreaKernelTable table =
+        {
+            &AreaKernelBatch<V, AreaCircleKernel>,
+            &AreaKernelBatch<V, AreaFanKernel>,
+            &AreaKernelBatch<V, AreaRectKernel>,
+            &AreaKernelBatch<V, AreaFovKernel>,
+            &AreaKernelBatch<V, AreaCapsuleKernel>,
+            &AreaKernelBatch<V, AreaPolygonKernel>,
+            &AreaKernelBatch<V, AreaNearerKernel>,
+        };
+        return &table;
+    }
+}
+
+#endif //
@@ -0,0 +1,31 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+//该编译单元需要以 -msse4.1 (msvc不需要) 编译, 只有CPU支持时才会被分派到.
+#include "aoe_kernel_impl.h"
+
+#if AOE_SIMD_SSE41
+const AreaKernelTable* AreaKernelTableSSE41()
+{
+    return AreaKernelMakeTable<AoeSimdSSE41>();
+}
+#else
+const AreaKernelTable* AreaKernelTableSSE41()
+{
+    return NULL;
+}
+#endif
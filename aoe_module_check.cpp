@@ -0,0 +1,710 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+//无界面的模块正确性检查. 依次强制每个可用的指令集级别, 把各模块的结果与逐个PointInRange的暴力结果对比.
+//不一致时返回非0, 由ctest运行.
+
+#include "aoe_shape.h"
+#include "aoe_world.h"
+#include "aoe_quadtree.h"
+#include "aoe_aura.h"
+#include "aoe_span.h"
+#include "aoe_join.h"
+#include "aoe_job.h"
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+
+static const f32 CHECK_SHAPE_SIZE = 10.0f;
+
+struct CheckShape
+{
+    u32 shape_type;
+    const char* name;
+    Point3 scale;
+    Point3 ext;
+};
+
+static const CheckShape CHECK_SHAPES[] =
+{
+    { AREA_SHAPE_CIRCLE, "circle", { 0.0f, CHECK_SHAPE_SIZE, 5.0f }, { 0.0f, 0.0f, 0.0f } },
+    { AREA_SHAPE_FAN, "fan", { 90.0f, CHECK_SHAPE_SIZE, 5.0f }, { 0.0f, 0.0f, 0.0f } },
+    { AREA_SHAPE_RECT, "rect", { CHECK_SHAPE_SIZE, CHECK_SHAPE_SIZE * 0.6f, 5.0f }, { 0.0f, 0.0f, 0.0f } },
+    { AREA_SHAPE_RING, "ring", { CHECK_SHAPE_SIZE * 0.4f, CHECK_SHAPE_SIZE, 5.0f }, { 0.0f, 0.0f, 0.0f } },
+    { AREA_SHAPE_FRAME, "frame", { CHECK_SHAPE_SIZE, CHECK_SHAPE_SIZE * 0.6f, 5.0f }, { 0.0f, 0.0f, 0.0f } },
+    { AREA_SHAPE_FOV, "fov", { 60.0f, 1.5f, CHECK_SHAPE_SIZE }, { 1.0f, 0.0f, 0.0f } },
+    { AREA_SHAPE_CAPSULE, "capsule", { CHECK_SHAPE_SIZE, CHECK_SHAPE_SIZE * 0.3f, 5.0f }, { 0.0f, 0.0f, 0.0f } },
+    { AREA_SHAPE_POLYGON, "hexagon", { 6.0f, CHECK_SHAPE_SIZE, 5.0f }, { 0.0f, 0.0f, 0.0f } },
+};
+static const u32 CHECK_SHAPE_TYPES = sizeof(CHECK_SHAPES) / sizeof(CHECK_SHAPES[0]);
+
+//检查用的实体, 与空间索引中的数据保持一致, 暴力检测时直接遍历
+struct CheckEntity
+{
+    Point3 pos;
+    f32 radius;
+};
+typedef std::map<u64, CheckEntity> CheckEntities;
+
+static const f32 CHECK_WORLD_EXTENT = 200.0f;
+static const u32 CHECK_WORLD_ENTITY_COUNT = 3000;
+static const u32 CHECK_WORLD_ROUNDS = 8;
+static const u32 CHECK_WORLD_SHAPES = 32;
+static const u32 CHECK_WORLD_AURAS = 8;
+static const u32 CHECK_SPAN_ROUNDS = 24; //每种形状的随机次数
+static const u32 CHECK_SPAN_DIRS = 64; //固定组合的朝向数
+static const u32 CHECK_NEAREST_KS[] = { 1, 5, 50 };
+
+static bool CheckSameDist(f32 a, f32 b)
+{
+    return memcmp(&a, &b, sizeof(f32)) == 0;
+}
+
+//按CHECK_SHAPES的顺序循环取形状类型, 定位点在[-half_extent, half_extent]内, 朝向随机. 形状不能重复Init, 先重置
+static s32 CheckRandomShape(AreaShape& area, u32 index, f32 half_extent, std::mt19937& rng)
+{
+    std::uniform_real_distribution<f32> pos(-half_extent, half_extent);
+    std::uniform_real_distribution<f32> angle(0.0f, PI2);
+    const CheckShape& shape = CHECK_SHAPES[index % CHECK_SHAPE_TYPES];
+    f32 radian = angle(rng);
+    DeviationShape deviation;
+    deviation.pivot_pos = { pos(rng), pos(rng), 0.0f };
+    deviation.pivot_dir = { cosf(radian), sinf(radian), 0.0f };
+    deviation.pivot_offset = { 0.0f, 0.0f, 0.0f };
+    deviation.pivot_scale = shape.scale;
+    deviation.pivot_ext = shape.ext;
+    area = AreaShape();
+    s32 ret = area.Init(shape.shape_type, deviation, 0.5f);
+    if (ret != 0)
+    {
+        LOGFMTE("check init shape error:<%d>. shape:<%s>", ret, shape.name);
+    }
+    return ret;
+}
+
+//所有实体逐个PointInRange, 结果按id从小到大
+static void CheckBruteHits(AreaShape& shape, const CheckEntities& entities, std::vector<AoeHit>& hits)
+{
+    hits.clear();
+    for (const auto& entity : entities)
+    {
+        f32 dist_sq = 0.0f;
+        if (shape.PointInRange(entity.second.pos, entity.second.radius, dist_sq) == 0)
+        {
+            hits.push_back({ entity.first, dist_sq });
+        }
+    }
+}
+
+//Query的结果顺序不固定, 按id排序后与暴力结果逐个对比
+static u32 CheckCompareHits(const char* what, u32 index, std::vector<AoeHit>& real, const std::vector<AoeHit>& expect)
+{
+    std::sort(real.begin(), real.end(), [](const AoeHit& a, const AoeHit& b) { return a.id < b.id; });
+    if (real.size() != expect.size())
+    {
+        LOGFMTE("check %s hit count error. shape:<%u>, expect:<%u>, real:<%u>", what, index, (u32)expect.size(), (u32)real.size());
+        return 1;
+    }
+    for (u32 i = 0; i < real.size(); i++)
+    {
+        if (real[i].id != expect[i].id || !CheckSameDist(real[i].dist_sq, expect[i].dist_sq))
+        {
+            LOGFMTE("check %s hit error. shape:<%u>, expect:<%llu %g>, real:<%llu %g>", what, index,
+                (unsigned long long)expect[i].id, expect[i].dist_sq, (unsigned long long)real[i].id, real[i].dist_sq);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//最近K个: 距离序列与暴力结果排序后的前k个逐位一致, 每个id都是命中的实体且不重复. 距离相同的实体之间的先后不做要求
+static u32 CheckCompareNearest(u32 index, u32 k, const std::vector<AoeHit>& real, const std::vector<AoeHit>& expect)
+{
+    std::vector<f32> sorted;
+    std::map<u64, f32> expect_dist;
+    for (const AoeHit& hit : expect)
+    {
+        sorted.push_back(hit.dist_sq);
+        expect_dist[hit.id] = hit.dist_sq;
+    }
+    std::sort(sorted.begin(), sorted.end());
+    u32 expect_size = sorted.size() < k ? (u32)sorted.size() : k;
+    if (real.size() != expect_size)
+    {
+        LOGFMTE("check world nearest count error. shape:<%u>, k:<%u>, expect:<%u>, real:<%u>", index, k, expect_size, (u32)real.size());
+        return 1;
+    }
+    for (u32 i = 0; i < expect_size; i++)
+    {
+        auto found = expect_dist.find(real[i].id);
+        if (!CheckSameDist(real[i].dist_sq, sorted[i]) || found == expect_dist.end() || !CheckSameDist(found->second, real[i].dist_sq))
+        {
+            LOGFMTE("check world nearest error. shape:<%u>, k:<%u>, rank:<%u>, expect dist:<%g>, real:<%llu %g>", index, k, i,
+                sorted[i], (unsigned long long)real[i].id, real[i].dist_sq);
+            return 1;
+        }
+        expect_dist.erase(found);
+    }
+    return 0;
+}
+
+//光环: 进入/离开事件与前后两次暴力结果的差集一致
+static u32 CheckAura(u32 index, AoeAura& aura, AreaShape& shape, AoeWorld& world, const CheckEntities& entities, std::set<u64>& inside)
+{
+    std::vector<AoeHit> enters;
+    std::vector<u64> leaves;
+    std::vector<AoeHit> expect;
+    s32 ret = aura.Tick(world, enters, leaves);
+    CheckBruteHits(shape, entities, expect);
+    std::vector<AoeHit> expect_enters;
+    std::set<u64> now;
+    for (const AoeHit& hit : expect)
+    {
+        now.insert(hit.id);
+        if (inside.find(hit.id) == inside.end())
+        {
+            expect_enters.push_back(hit);
+        }
+    }
+    std::vector<u64> expect_leaves;
+    for (u64 id : inside)
+    {
+        if (now.find(id) == now.end())
+        {
+            expect_leaves.push_back(id);
+        }
+    }
+    inside.swap(now);
+
+    u32 errors = 0;
+    if (ret != (s32)(enters.size() + leaves.size()))
+    {
+        LOGFMTE("check aura tick error:<%d>. aura:<%u>, enters:<%u>, leaves:<%u>", ret, index, (u32)enters.size(), (u32)leaves.size());
+        errors++;
+    }
+    errors += CheckCompareHits("aura enter", index, enters, expect_enters);
+    std::sort(leaves.begin(), leaves.end());
+    if (leaves != expect_leaves)
+    {
+        LOGFMTE("check aura leave error. aura:<%u>, expect:<%u>, real:<%u>", index, (u32)expect_leaves.size(), (u32)leaves.size());
+        errors++;
+    }
+    if (aura.inside_count() != inside.size())
+    {
+        LOGFMTE("check aura inside error. aura:<%u>, expect:<%u>, real:<%u>", index, (u32)inside.size(), aura.inside_count());
+        errors++;
+    }
+    return errors;
+}
+
+//空间索引: 增加/移动/删除实体若干轮, 每轮之后与全部实体的逐个检测对比. 一半实体聚集在中心, 另一部分超出网格范围
+static u32 CheckWorld(u32 seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<f32> pos(-CHECK_WORLD_EXTENT * 1.1f, CHECK_WORLD_EXTENT * 1.1f);
+    std::uniform_real_distribution<f32> cluster(-20.0f, 20.0f);
+    std::uniform_real_distribution<f32> step(-3.0f, 3.0f);
+    std::uniform_real_distribution<f32> high(-3.0f, 3.0f);
+    std::uniform_real_distribution<f32> target_radius(0.1f, 1.0f);
+    std::uniform_real_distribution<f32> chance(0.0f, 1.0f);
+    u32 errors = 0;
+
+    AoeWorld world;
+    AoeQuadTree tree;
+    if (world.Init(-CHECK_WORLD_EXTENT, -CHECK_WORLD_EXTENT, CHECK_WORLD_EXTENT * 2.0f, CHECK_WORLD_EXTENT * 2.0f, 8.0f) != 0
+        || tree.Init(-CHECK_WORLD_EXTENT, -CHECK_WORLD_EXTENT, CHECK_WORLD_EXTENT * 2.0f, CHECK_WORLD_EXTENT * 2.0f) != 0)
+    {
+        LOGFMTE("check world init error.");
+        return 1;
+    }
+    CheckEntities entities;
+    u64 next_id = 1;
+    auto add_entity = [&](bool clustered)
+    {
+        CheckEntity entity;
+        entity.pos = clustered ? Point3(cluster(rng), cluster(rng), high(rng)) : Point3(pos(rng), pos(rng), high(rng));
+        entity.radius = next_id % 4 == 0 ? 0.0f : target_radius(rng);
+        if (world.AddEntity(next_id, entity.pos, entity.radius) != 0
+            || tree.AddEntity(next_id, entity.pos, entity.radius) != 0)
+        {
+            LOGFMTE("check world add error. id:<%llu>", (unsigned long long)next_id);
+            errors++;
+        }
+        entities[next_id++] = entity;
+    };
+    for (u32 i = 0; i < CHECK_WORLD_ENTITY_COUNT; i++)
+    {
+        add_entity(i % 2 == 0);
+    }
+
+    std::vector<AreaShape> aura_shapes(CHECK_WORLD_AURAS);
+    std::vector<AoeAura> auras(CHECK_WORLD_AURAS);
+    std::vector<std::set<u64>> aura_inside(CHECK_WORLD_AURAS);
+    for (u32 i = 0; i < CHECK_WORLD_AURAS; i++)
+    {
+        if (CheckRandomShape(aura_shapes[i], i, i % 2 == 0 ? 20.0f : CHECK_WORLD_EXTENT, rng) != 0 || auras[i].Init(aura_shapes[i]) != 0)
+        {
+            return errors + 1;
+        }
+    }
+
+    std::vector<AreaShape> shapes(CHECK_WORLD_SHAPES);
+    std::vector<AoeHit> expect;
+    std::vector<AoeHit> real;
+    std::vector<u64> ids;
+    for (u32 round = 0; round < CHECK_WORLD_ROUNDS; round++)
+    {
+        if (round > 0)
+        {
+            ids.clear();
+            for (const auto& entity : entities)
+            {
+                ids.push_back(entity.first);
+            }
+            for (u64 id : ids)
+            {
+                f32 roll = chance(rng);
+                CheckEntity& entity = entities[id];
+                if (roll < 0.03f)
+                {
+                    if (world.RemoveEntity(id) != 0
+                        || tree.RemoveEntity(id) != 0)
+                    {
+                        LOGFMTE("check world remove error. id:<%llu>", (unsigned long long)id);
+                        errors++;
+                    }
+                    entities.erase(id);
+                    continue;
+                }
+                if (roll < 0.13f)
+                {
+                    entity.pos = Point3(entity.pos.x + step(rng), entity.pos.y + step(rng), high(rng));
+                }
+                else if (roll < 0.23f)
+                {
+                    entity.pos = round % 2 == 0 ? Point3(cluster(rng), cluster(rng), high(rng)) : Point3(pos(rng), pos(rng), high(rng));
+                }
+                else
+                {
+                    continue;
+                }
+                if (world.MoveEntity(id, entity.pos) != 0
+                    || tree.MoveEntity(id, entity.pos) != 0)
+                {
+                    LOGFMTE("check world move error. id:<%llu>", (unsigned long long)id);
+                    errors++;
+                }
+            }
+            for (u32 i = 0; i < CHECK_WORLD_ENTITY_COUNT / 30; i++)
+            {
+                add_entity(round % 2 == 0);
+            }
+        }
+        //中途换形状, 已在范围内的实体保留, 下一次Tick全部重新检测
+        if (round == CHECK_WORLD_ROUNDS / 2)
+        {
+            for (u32 i = 0; i < CHECK_WORLD_AURAS; i += 2)
+            {
+                if (CheckRandomShape(aura_shapes[i], i, 20.0f, rng) != 0 || auras[i].Init(aura_shapes[i]) != 0)
+                {
+                    return errors + 1;
+                }
+            }
+        }
+        if (world.entity_count() != entities.size())
+        {
+            LOGFMTE("check world entity count error. expect:<%u>, real:<%u>", (u32)entities.size(), world.entity_count());
+            errors++;
+        }
+        if (tree.entity_count() != entities.size())
+        {
+            LOGFMTE("check quadtree entity count error. expect:<%u>, real:<%u>", (u32)entities.size(), tree.entity_count());
+            errors++;
+        }
+
+        for (u32 i = 0; i < CHECK_WORLD_AURAS; i++)
+        {
+            errors += CheckAura(i, auras[i], aura_shapes[i], world, entities, aura_inside[i]);
+        }
+        for (u32 i = 0; i < CHECK_WORLD_SHAPES; i++)
+        {
+            if (CheckRandomShape(shapes[i], i, i % 2 == 0 ? 20.0f : CHECK_WORLD_EXTENT * 1.1f, rng) != 0)
+            {
+                return errors + 1;
+            }
+            CheckBruteHits(shapes[i], entities, expect);
+            real.clear();
+            world.Query(shapes[i], real);
+            errors += CheckCompareHits("world", i, real, expect);
+            real.clear();
+            tree.Query(shapes[i], real);
+            errors += CheckCompareHits("quadtree", i, real, expect);
+            for (u32 k : CHECK_NEAREST_KS)
+            {
+                real.clear();
+                world.QueryNearest(shapes[i], k, real);
+                errors += CheckCompareNearest(i, k, real, expect);
+            }
+        }
+    }
+    return errors;
+}
+
+//一个网格上的覆盖结果展开成逐格的命中表, 与每个采样点的PointInRange对比. 同时检查段的顺序和范围
+static u32 CheckSpanCells(AreaShape& shape, u32 index, const AoeSpanGrid& grid, f32 radius, std::vector<AoeSpan>& spans, std::vector<u8>& covered)
+{
+    spans.clear();
+    s32 ret = AoeShapeSpans(shape, grid, radius, spans);
+    if (ret != (s32)spans.size())
+    {
+        LOGFMTE("check spans error:<%d>. shape:<%u>, spans:<%u>", ret, index, (u32)spans.size());
+        return 1;
+    }
+    covered.assign(grid.cols * grid.rows, 0);
+    for (u32 s = 0; s < spans.size(); s++)
+    {
+        const AoeSpan& span = spans[s];
+        bool ordered = s == 0 || span.row > spans[s - 1].row || (span.row == spans[s - 1].row && span.begin > spans[s - 1].end);
+        if (!ordered || span.row >= grid.rows || span.begin >= span.end || span.end > grid.cols)
+        {
+            LOGFMTE("check span range error. shape:<%u>, span:<%u %u %u>", index, span.row, span.begin, span.end);
+            return 1;
+        }
+        memset(&covered[span.row * grid.cols + span.begin], 1, span.end - span.begin);
+    }
+    for (u32 row = 0; row < grid.rows; row++)
+    {
+        for (u32 col = 0; col < grid.cols; col++)
+        {
+            f32 dist_sq = 0.0f;
+            Point3 sample(grid.origin.x + col * grid.step, grid.origin.y + row * grid.step, grid.origin.z);
+            u8 hit = shape.PointInRange(sample, radius, dist_sq) == 0 ? 1 : 0;
+            if (hit != covered[row * grid.cols + col])
+            {
+                LOGFMTE("check span cell error. shape:<%u>, type:<%u>, step:<%g>, radius:<%g>, row:<%u>, col:<%u>, expect:<%u>",
+                    index, shape.shape_type(), grid.step, radius, row, col, (u32)hit);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+//网格覆盖用的随机形状: 尺寸, 扇形角度, 多边形边数和定位点半径都随机. 扇形/视锥/多边形的scale.x不是长度, 单独取值
+static s32 CheckRandomSpanShape(AreaShape& area, u32 index, f32 anchor_radius, std::mt19937& rng)
+{
+    std::uniform_real_distribution<f32> pos(-3.0f, 3.0f);
+    std::uniform_real_distribution<f32> angle(0.0f, PI2);
+    std::uniform_real_distribution<f32> size(0.1f, 0.6f);
+    const CheckShape& shape = CHECK_SHAPES[index % CHECK_SHAPE_TYPES];
+    Point3 scale = shape.scale;
+    f32 factor = size(rng);
+    switch (shape.shape_type)
+    {
+    case AREA_SHAPE_FAN:
+        scale.x = std::uniform_real_distribution<f32>(5.0f, 355.0f)(rng);
+        scale.y *= factor;
+        break;
+    case AREA_SHAPE_POLYGON:
+        scale.x = (f32)std::uniform_int_distribution<u32>(3, AREA_POLYGON_MAX_VERTEX)(rng);
+        scale.y *= factor;
+        break;
+    case AREA_SHAPE_FOV:
+        scale.x = std::uniform_real_distribution<f32>(10.0f, 150.0f)(rng);
+        scale.y *= factor;
+        scale.z *= factor;
+        break;
+    case AREA_SHAPE_RING:
+        //内外半径同比缩放
+        scale.x *= factor;
+        scale.y *= factor;
+        break;
+    default:
+        scale.x *= factor;
+        scale.y *= size(rng);
+        break;
+    }
+    f32 radian = angle(rng);
+    DeviationShape deviation;
+    deviation.pivot_pos = { pos(rng), pos(rng), 0.0f };
+    deviation.pivot_dir = { cosf(radian), sinf(radian), 0.0f };
+    deviation.pivot_offset = { 0.0f, 0.0f, 0.0f };
+    deviation.pivot_scale = scale;
+    deviation.pivot_ext = shape.ext;
+    area = AreaShape();
+    s32 ret = area.Init(shape.shape_type, deviation, anchor_radius);
+    if (ret != 0)
+    {
+        LOGFMTE("check init span shape error:<%d>. shape:<%s>, scale:<%g %g %g>, anchor radius:<%g>", ret, shape.name, scale.x, scale.y, scale.z, anchor_radius);
+    }
+    return ret;
+}
+
+//网格覆盖: 展开成逐格的命中表, 与每个采样点的PointInRange对比. 同时检查段的顺序和范围.
+//定位点半径, 目标半径, 网格间距和形状尺寸都随机, 网格有时只覆盖形状的一部分
+static u32 CheckSpans(u32 seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<f32> radius_range(0.0f, 1.5f);
+    std::uniform_real_distribution<f32> step_range(0.02f, 0.42f);
+    std::uniform_real_distribution<f32> shift(-2.0f, 2.0f);
+    std::uniform_real_distribution<f32> high(-1.0f, 3.0f);
+    u32 errors = 0;
+    AreaShape shape;
+    std::vector<AoeSpan> spans;
+    std::vector<u8> covered;
+
+    //出错过的组合: 矩形与定位点碰撞圆的候选区间相交, 真正的命中部分之间有空隙. 只在部分朝向出现, 转一圈检查
+    DeviationShape deviation;
+    deviation.pivot_pos = { 0.3f, -0.2f, 0.0f };
+    deviation.pivot_offset = { 0.0f, 0.0f, 0.0f };
+    deviation.pivot_scale = { 1.05f, 2.70f, 5.0f };
+    deviation.pivot_ext = { 0.0f, 0.0f, 0.0f };
+    AoeSpanGrid fixed_grid = { { -5.03f, -4.97f, 0.0f }, 0.05f, 200, 200 };
+    for (u32 i = 0; i < CHECK_SPAN_DIRS; i++)
+    {
+        f32 radian = PI2 * i / CHECK_SPAN_DIRS;
+        deviation.pivot_dir = { cosf(radian), sinf(radian), 0.0f };
+        shape = AreaShape();
+        if (shape.Init(AREA_SHAPE_RECT, deviation, 1.08f) != 0)
+        {
+            return errors + 1;
+        }
+        errors += CheckSpanCells(shape, i, fixed_grid, 1.06f, spans, covered);
+    }
+
+    for (u32 i = 0; i < CHECK_SHAPE_TYPES * CHECK_SPAN_ROUNDS; i++)
+    {
+        if (CheckRandomSpanShape(shape, i, radius_range(rng), rng) != 0)
+        {
+            return errors + 1;
+        }
+        AreaBounds bounds;
+        shape.Bounds(bounds);
+        AoeSpanGrid grid;
+        grid.step = step_range(rng);
+        grid.origin = { bounds.min.x - 2.0f + shift(rng), bounds.min.y - 2.0f + shift(rng), i % 4 == 0 ? 0.0f : high(rng) };
+        grid.cols = (u32)((bounds.max.x - bounds.min.x + 4.0f) / grid.step) + 1;
+        grid.rows = (u32)((bounds.max.y - bounds.min.y + 4.0f) / grid.step) + 1;
+        const f32 radiuses[] = { 0.0f, radius_range(rng) };
+        for (f32 radius : radiuses)
+        {
+            errors += CheckSpanCells(shape, i, grid, radius, spans, covered);
+        }
+    }
+    return errors;
+}
+
+//多形状对多目标的场景, 期望结果是两层循环逐个PointInRange, 按(形状, 目标)排序
+struct CheckPair
+{
+    u32 shape;
+    u32 index;
+    f32 dist_sq;
+};
+
+struct CheckScene
+{
+    std::vector<AreaShape> shapes;
+    std::vector<f32> xs;
+    std::vector<f32> ys;
+    std::vector<f32> zs;
+    std::vector<f32> radius;
+    AreaPoints points;
+    std::vector<CheckPair> expect;
+};
+
+static s32 CheckBuildScene(CheckScene& scene, u32 seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<f32> pos(-70.0f, 70.0f);
+    std::uniform_real_distribution<f32> high(-3.0f, 3.0f);
+    std::uniform_real_distribution<f32> target_radius(0.1f, 1.0f);
+    scene.shapes.resize(48);
+    for (u32 i = 0; i < scene.shapes.size(); i++)
+    {
+        if (CheckRandomShape(scene.shapes[i], i, 60.0f, rng) != 0)
+        {
+            return -1;
+        }
+    }
+    //不是整块的数量, 带尾部
+    u32 count = 4059;
+    scene.xs.resize(count);
+    scene.ys.resize(count);
+    scene.zs.resize(count);
+    scene.radius.resize(count);
+    for (u32 i = 0; i < count; i++)
+    {
+        scene.xs[i] = pos(rng);
+        scene.ys[i] = pos(rng);
+        scene.zs[i] = high(rng);
+        scene.radius[i] = i % 4 == 0 ? 0.0f : target_radius(rng);
+    }
+    scene.points = { scene.xs.data(), scene.ys.data(), scene.zs.data(), scene.radius.data(), count };
+    scene.expect.clear();
+    for (u32 s = 0; s < scene.shapes.size(); s++)
+    {
+        for (u32 i = 0; i < count; i++)
+        {
+            f32 dist_sq = 0.0f;
+            if (scene.shapes[s].PointInRange({ scene.xs[i], scene.ys[i], scene.zs[i] }, scene.radius[i], dist_sq) == 0)
+            {
+                scene.expect.push_back({ s, i, dist_sq });
+            }
+        }
+    }
+    return 0;
+}
+
+static bool CheckSamePair(u32 shape, u32 index, f32 dist_sq, const CheckPair& pair)
+{
+    return shape == pair.shape && index == pair.index && CheckSameDist(dist_sq, pair.dist_sq);
+}
+
+//空间连接: 按(形状, 目标)排序后与两层循环一致
+static u32 CheckJoin(CheckScene& scene)
+{
+    const std::vector<CheckPair>& expect = scene.expect;
+    AoeJoin join;
+    std::vector<AoeJoinPair> pairs;
+    s32 ret = join.Resolve(scene.shapes.data(), (u32)scene.shapes.size(), scene.points, pairs);
+    std::sort(pairs.begin(), pairs.end(), [](const AoeJoinPair& a, const AoeJoinPair& b)
+        {
+            return a.shape < b.shape || (a.shape == b.shape && a.index < b.index);
+        });
+    if (ret != (s32)expect.size() || pairs.size() != expect.size())
+    {
+        LOGFMTE("check join count error:<%d>. expect:<%u>, real:<%u>", ret, (u32)expect.size(), (u32)pairs.size());
+        return 1;
+    }
+    for (u32 i = 0; i < pairs.size(); i++)
+    {
+        if (!CheckSamePair(pairs[i].shape, pairs[i].index, pairs[i].dist_sq, expect[i]))
+        {
+            LOGFMTE("check join error. rank:<%u>, expect:<%u %u %g>, real:<%u %u %g>", i,
+                expect[i].shape, expect[i].index, expect[i].dist_sq, pairs[i].shape, pairs[i].index, pairs[i].dist_sq);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//多线程任务池: 输出顺序与两层循环完全相同, 分段大小不同时也一样
+static u32 CheckJob(CheckScene& scene, AoeJobPool& pool)
+{
+    const std::vector<CheckPair>& expect = scene.expect;
+    const u32 span_sizes[] = { 1024, 257 };
+    std::vector<AoeJobHit> hits;
+    u32 errors = 0;
+    for (u32 span_size : span_sizes)
+    {
+        hits.clear();
+        s32 ret = pool.Resolve(scene.shapes.data(), (u32)scene.shapes.size(), scene.points, hits, span_size);
+        if (ret != (s32)expect.size() || hits.size() != expect.size())
+        {
+            LOGFMTE("check job count error:<%d>. span_size:<%u>, expect:<%u>, real:<%u>", ret, span_size, (u32)expect.size(), (u32)hits.size());
+            errors++;
+            continue;
+        }
+        for (u32 i = 0; i < hits.size(); i++)
+        {
+            if (!CheckSamePair(hits[i].shape, hits[i].index, hits[i].dist_sq, expect[i]))
+            {
+                LOGFMTE("check job order error. span_size:<%u>, rank:<%u>, expect:<%u %u %g>, real:<%u %u %g>", span_size, i,
+                    expect[i].shape, expect[i].index, expect[i].dist_sq, hits[i].shape, hits[i].index, hits[i].dist_sq);
+                errors++;
+                break;
+            }
+        }
+    }
+    return errors;
+}
+
+//正多边形的边数来自浮点配置: 超出3到AREA_POLYGON_MAX_VERTEX, NaN或无穷都要在取整之前返回错误
+static u32 CheckPolygonParam()
+{
+    const f32 bad_sides[] = { 2.4f, AREA_POLYGON_MAX_VERTEX + 0.6f, -1.0f, 1e20f,
+        std::numeric_limits<f32>::quiet_NaN(), std::numeric_limits<f32>::infinity() };
+    const f32 good_sides[] = { 3.0f, AREA_POLYGON_MAX_VERTEX + 0.4f };
+    DeviationShape deviation;
+    deviation.pivot_pos = Point3(0.0f, 0.0f, 0.0f);
+    deviation.pivot_dir = Point3(1.0f, 0.0f, 0.0f);
+    deviation.pivot_scale = Point3(0.0f, 5.0f, 5.0f);
+    u32 errors = 0;
+    for (f32 sides : bad_sides)
+    {
+        AreaShape shape;
+        deviation.pivot_scale.x = sides;
+        if (shape.Init(AREA_SHAPE_POLYGON, deviation, 0.0f) == 0)
+        {
+            LOGFMTE("check polygon param error. sides:<%f> accepted", sides);
+            errors++;
+        }
+    }
+    for (f32 sides : good_sides)
+    {
+        AreaShape shape;
+        deviation.pivot_scale.x = sides;
+        if (shape.Init(AREA_SHAPE_POLYGON, deviation, 0.0f) != 0)
+        {
+            LOGFMTE("check polygon param error. sides:<%f> rejected", sides);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+int main()
+{
+    FNLog::FastStartDefaultLogger();
+    FNLog::BatchSetChannelConfig(FNLog::GetDefaultLogger(), FNLog::CHANNEL_CFG_PRIORITY, FNLog::PRIORITY_ERROR);
+    u32 errors = CheckPolygonParam();
+    u32 checked = 0;
+    AoeJobPool pool;
+    if (pool.Start(3) != 0)
+    {
+        LOGFMTE("check job pool start error.");
+        return 2;
+    }
+    for (u32 level = 0; level < AREA_KERNEL_LEVEL_MAX; level++)
+    {
+        if (AreaKernelForceLevel(level) != 0)
+        {
+            printf("check level:<%s> skipped, not usable\n", AreaKernelLevelName(level));
+            continue;
+        }
+        u32 seed = level * 16;
+        u32 level_errors = 0;
+        level_errors += CheckWorld(++seed);
+        level_errors += CheckSpans(++seed);
+        CheckScene scene;
+        if (CheckBuildScene(scene, ++seed) != 0)
+        {
+            return 2;
+        }
+        level_errors += CheckJoin(scene);
+        level_errors += CheckJob(scene, pool);
+        printf("check level:<%s> errors:<%u>\n", AreaKernelLevelName(level), level_errors);
+        errors += level_errors;
+        checked++;
+    }
+    pool.Stop();
+    return errors == 0 && checked > 0 ? 0 : 1;
+}
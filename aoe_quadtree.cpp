@@ -0,0 +1,453 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "aoe_quadtree.h"
+
+AoeQuadTree::AoeQuadTree()
+{
+    node_capacity_ = 0;
+    max_depth_ = 0;
+    max_radius_ = 0.0f;
+}
+
+s32 AoeQuadTree::Init(f32 min_x, f32 min_y, f32 width, f32 height, u32 node_capacity, u32 max_depth)
+{
+    if (width < FLOAT_POINT_PRECISION || height < FLOAT_POINT_PRECISION || node_capacity == 0)
+    {
+        LOGFMTE("quadtree init param error. width:<%f>, height:<%f>, node_capacity:<%u>", width, height, node_capacity);
+        return -1;
+    }
+    if (!nodes_.empty())
+    {
+        LOGFMTE("quadtree init conflict.");
+        return -2;
+    }
+    node_capacity_ = node_capacity;
+    max_depth_ = max_depth;
+    f32 half = (width > height ? width : height) * 0.5f;
+    Node root = { min_x + half, min_y + half, half, 0, AOE_QUAD_NONE, AOE_QUAD_NONE, AOE_QUAD_NONE, 0, 0 };
+    nodes_.push_back(root);
+    return 0;
+}
+
+void AoeQuadTree::Clear()
+{
+    ids_.clear();
+    xs_.clear();
+    ys_.clear();
+    zs_.clear();
+    radius_.clear();
+    node_of_.clear();
+    prev_.clear();
+    next_.clear();
+    slot_of_.clear();
+    if (!nodes_.empty())
+    {
+        nodes_.resize(1);
+        nodes_[0].child = AOE_QUAD_NONE;
+        nodes_[0].head = AOE_QUAD_NONE;
+        nodes_[0].count = 0;
+        nodes_[0].total = 0;
+    }
+    free_blocks_.clear();
+    max_radius_ = 0.0f;
+}
+
+bool AoeQuadTree::InLoose(u32 node, f32 x, f32 y) const
+{
+    const Node& n = nodes_[node];
+    f32 loose = n.half * AOE_QUAD_LOOSE;
+    return fabsf(x - n.center_x) <= loose && fabsf(y - n.center_y) <= loose;
+}
+
+u32 AoeQuadTree::ChildOf(u32 node, f32 x, f32 y) const
+{
+    const Node& n = nodes_[node];
+    return n.child + (x >= n.center_x ? 1u : 0u) + (y >= n.center_y ? 2u : 0u);
+}
+
+u32 AoeQuadTree::AllocBlock()
+{
+    if (!free_blocks_.empty())
+    {
+        u32 block = free_blocks_.back();
+        free_blocks_.pop_back();
+        return block;
+    }
+    u32 block = (u32)nodes_.size();
+    nodes_.resize(nodes_.size() + 4);
+    return block;
+}
+
+void AoeQuadTree::Link(u32 slot, u32 node)
+{
+    Node& n = nodes_[node];
+    prev_[slot] = AOE_QUAD_NONE;
+    next_[slot] = n.head;
+    if (n.head != AOE_QUAD_NONE)
+    {
+        prev_[n.head] = slot;
+    }
+    n.head = slot;
+    n.count++;
+    node_of_[slot] = node;
+    for (u32 cur = node; cur != AOE_QUAD_NONE; cur = nodes_[cur].parent)
+    {
+        nodes_[cur].total++;
+    }
+}
+
+void AoeQuadTree::Unlink(u32 slot)
+{
+    u32 node = node_of_[slot];
+    Node& n = nodes_[node];
+    if (prev_[slot] != AOE_QUAD_NONE)
+    {
+        next_[prev_[slot]] = next_[slot];
+    }
+    else
+    {
+        n.head = next_[slot];
+    }
+    if (next_[slot] != AOE_QUAD_NONE)
+    {
+        prev_[next_[slot]] = prev_[slot];
+    }
+    n.count--;
+    for (u32 cur = node; cur != AOE_QUAD_NONE; cur = nodes_[cur].parent)
+    {
+        nodes_[cur].total--;
+    }
+}
+
+void AoeQuadTree::Insert(u32 slot)
+{
+    f32 x = xs_[slot];
+    f32 y = ys_[slot];
+    u32 node = 0;
+    while (nodes_[node].child != AOE_QUAD_NONE)
+    {
+        u32 child = ChildOf(node, x, y);
+        if (!InLoose(child, x, y))
+        {
+            break;
+        }
+        node = child;
+    }
+    Link(slot, node);
+    const Node& n = nodes_[node];
+    if (n.child == AOE_QUAD_NONE && n.count > node_capacity_ && n.depth < max_depth_)
+    {
+        Split(node);
+    }
+}
+
+void AoeQuadTree::Split(u32 node)
+{
+    u32 block = AllocBlock();
+    //AllocBlock可能导致nodes_扩容 之后再取引用
+    Node& n = nodes_[node];
+    f32 half = n.half * 0.5f;
+    for (u32 i = 0; i < 4; i++)
+    {
+        Node& child = nodes_[block + i];
+        child.center_x = n.center_x + ((i & 1u) ? half : -half);
+        child.center_y = n.center_y + ((i & 2u) ? half : -half);
+        child.half = half;
+        child.depth = n.depth + 1;
+        child.parent = node;
+        child.child = AOE_QUAD_NONE;
+        child.head = AOE_QUAD_NONE;
+        child.count = 0;
+        child.total = 0;
+    }
+    n.child = block;
+
+    //漂移到松散区域且放不进子节点的实体留在本节点
+    u32 slot = n.head;
+    while (slot != AOE_QUAD_NONE)
+    {
+        u32 next = next_[slot];
+        u32 child = ChildOf(node, xs_[slot], ys_[slot]);
+        if (InLoose(child, xs_[slot], ys_[slot]))
+        {
+            Unlink(slot);
+            Link(slot, child);
+        }
+        slot = next;
+    }
+    for (u32 i = 0; i < 4; i++)
+    {
+        const Node& child = nodes_[block + i];
+        if (child.count > node_capacity_ && child.depth < max_depth_)
+        {
+            Split(block + i);
+        }
+    }
+}
+
+void AoeQuadTree::Merge(u32 node)
+{
+    u32 block = nodes_[node].child;
+    for (u32 i = 0; i < 4; i++)
+    {
+        while (nodes_[block + i].head != AOE_QUAD_NONE)
+        {
+            u32 slot = nodes_[block + i].head;
+            Unlink(slot);
+            Link(slot, node);
+        }
+    }
+    nodes_[node].child = AOE_QUAD_NONE;
+    free_blocks_.push_back(block);
+}
+
+void AoeQuadTree::Shrink(u32 node)
+{
+    //从下往上合并 保留一半容量的余量 避免在临界值附近反复分裂合并
+    for (u32 cur = node; cur != AOE_QUAD_NONE; cur = nodes_[cur].parent)
+    {
+        const Node& n = nodes_[cur];
+        if (n.child == AOE_QUAD_NONE || n.total > node_capacity_ / 2)
+        {
+            continue;
+        }
+        bool leaf_children = true;
+        for (u32 i = 0; i < 4; i++)
+        {
+            leaf_children = leaf_children && nodes_[n.child + i].child == AOE_QUAD_NONE;
+        }
+        if (leaf_children)
+        {
+            Merge(cur);
+        }
+    }
+}
+
+s32 AoeQuadTree::AddEntity(u64 id, const Point3& pos, f32 radius)
+{
+    if (nodes_.empty())
+    {
+        LOGFMTE("quadtree not init.");
+        return -1;
+    }
+    if (slot_of_.find(id) != slot_of_.end())
+    {
+        LOGFMTE("quadtree add entity conflict. id:<%llu>", id);
+        return -2;
+    }
+    u32 slot = (u32)ids_.size();
+    ids_.push_back(id);
+    xs_.push_back(pos.x);
+    ys_.push_back(pos.y);
+    zs_.push_back(pos.z);
+    radius_.push_back(radius);
+    node_of_.push_back(AOE_QUAD_NONE);
+    prev_.push_back(AOE_QUAD_NONE);
+    next_.push_back(AOE_QUAD_NONE);
+    slot_of_[id] = slot;
+    Insert(slot);
+    if (radius > max_radius_)
+    {
+        max_radius_ = radius;
+    }
+    return 0;
+}
+
+s32 AoeQuadTree::MoveEntity(u64 id, const Point3& pos)
+{
+    auto iter = slot_of_.find(id);
+    if (iter == slot_of_.end())
+    {
+        LOGFMTE("quadtree move entity not found. id:<%llu>", id);
+        return -1;
+    }
+    u32 slot = iter->second;
+    xs_[slot] = pos.x;
+    ys_[slot] = pos.y;
+    zs_[slot] = pos.z;
+
+    //仍在所在节点的松散范围内 并且不能下沉到子节点时原地更新
+    u32 node = node_of_[slot];
+    bool stay = false;
+    if (!InLoose(node, pos.x, pos.y))
+    {
+        stay = node == 0;
+    }
+    else
+    {
+        stay = nodes_[node].child == AOE_QUAD_NONE || !InLoose(ChildOf(node, pos.x, pos.y), pos.x, pos.y);
+    }
+    if (stay)
+    {
+        return 0;
+    }
+    Unlink(slot);
+    Insert(slot);
+    Shrink(node);
+    return 0;
+}
+
+s32 AoeQuadTree::RemoveEntity(u64 id)
+{
+    auto iter = slot_of_.find(id);
+    if (iter == slot_of_.end())
+    {
+        LOGFMTE("quadtree remove entity not found. id:<%llu>", id);
+        return -1;
+    }
+    u32 slot = iter->second;
+    slot_of_.erase(iter);
+    u32 node = node_of_[slot];
+    Unlink(slot);
+
+    //末尾实体移到空出的槽位
+    u32 last = (u32)ids_.size() - 1;
+    if (slot != last)
+    {
+        ids_[slot] = ids_[last];
+        xs_[slot] = xs_[last];
+        ys_[slot] = ys_[last];
+        zs_[slot] = zs_[last];
+        radius_[slot] = radius_[last];
+        node_of_[slot] = node_of_[last];
+        prev_[slot] = prev_[last];
+        next_[slot] = next_[last];
+        if (prev_[slot] != AOE_QUAD_NONE)
+        {
+            next_[prev_[slot]] = slot;
+        }
+        else
+        {
+            nodes_[node_of_[slot]].head = slot;
+        }
+        if (next_[slot] != AOE_QUAD_NONE)
+        {
+            prev_[next_[slot]] = slot;
+        }
+        slot_of_[ids_[slot]] = slot;
+    }
+    ids_.pop_back();
+    xs_.pop_back();
+    ys_.pop_back();
+    zs_.pop_back();
+    radius_.pop_back();
+    node_of_.pop_back();
+    prev_.pop_back();
+    next_.pop_back();
+    Shrink(node);
+    return 0;
+}
+
+s32 AoeQuadTree::Query(AreaShape& shape, std::vector<AoeHit>& hits)
+{
+    if (nodes_.empty())
+    {
+        LOGFMTE("quadtree not init.");
+        return -1;
+    }
+    AreaBounds bounds;
+    s32 ret = shape.Bounds(bounds);
+    if (ret != 0)
+    {
+        return ret;
+    }
+    f32 radius = bounds.radius + max_radius_;
+    f32 radius_sq = radius * radius;
+    Point3 box_min = Point3(bounds.min.x - max_radius_, bounds.min.y - max_radius_, 0.0f);
+    Point3 box_max = Point3(bounds.max.x + max_radius_, bounds.max.y + max_radius_, 0.0f);
+
+    candidate_slots_.clear();
+    candidate_x_.clear();
+    candidate_y_.clear();
+    candidate_z_.clear();
+    candidate_radius_.clear();
+    stack_.clear();
+    stack_.push_back(0);
+    while (!stack_.empty())
+    {
+        u32 node = stack_.back();
+        stack_.pop_back();
+        const Node& n = nodes_[node];
+        if (n.total == 0)
+        {
+            continue;
+        }
+        //根节点上挂的是超出范围的实体 不做裁剪
+        if (node != 0)
+        {
+            f32 loose = n.half * AOE_QUAD_LOOSE;
+            if (n.center_x + loose < box_min.x || n.center_x - loose > box_max.x
+                || n.center_y + loose < box_min.y || n.center_y - loose > box_max.y)
+            {
+                continue;
+            }
+            f32 out_x = fabsf(bounds.center.x - n.center_x) - loose;
+            f32 out_y = fabsf(bounds.center.y - n.center_y) - loose;
+            out_x = out_x > 0.0f ? out_x : 0.0f;
+            out_y = out_y > 0.0f ? out_y : 0.0f;
+            if (out_x * out_x + out_y * out_y > radius_sq)
+            {
+                continue;
+            }
+        }
+        for (u32 slot = n.head; slot != AOE_QUAD_NONE; slot = next_[slot])
+        {
+            candidate_slots_.push_back(slot);
+            candidate_x_.push_back(xs_[slot]);
+            candidate_y_.push_back(ys_[slot]);
+            candidate_z_.push_back(zs_[slot]);
+            candidate_radius_.push_back(radius_[slot]);
+        }
+        if (n.child != AOE_QUAD_NONE)
+        {
+            for (u32 i = 0; i < 4; i++)
+            {
+                stack_.push_back(n.child + i);
+            }
+        }
+    }
+    u32 count = (u32)candidate_slots_.size();
+    if (count == 0)
+    {
+        return 0;
+    }
+    candidate_dist_.resize(count);
+    candidate_bits_.resize(AreaHitWords(count));
+    AreaPoints points = { candidate_x_.data(), candidate_y_.data(), candidate_z_.data(), candidate_radius_.data(), count };
+    ret = shape.PointsInRange(points, candidate_bits_.data(), candidate_dist_.data());
+    if (ret <= 0)
+    {
+        return ret;
+    }
+    for (u32 word = 0; word < (u32)candidate_bits_.size(); word++)
+    {
+        u64 bits = candidate_bits_[word];
+        while (bits != 0)
+        {
+            u32 bit = 0;
+            while (((bits >> bit) & 1u) == 0)
+            {
+                bit++;
+            }
+            bits &= bits - 1;
+            u32 index = word * 64 + bit;
+            hits.push_back({ ids_[candidate_slots_[index]], candidate_dist_[index] });
+        }
+    }
+    return ret;
+}
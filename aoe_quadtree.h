@@ -0,0 +1,101 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+#ifndef AOE_QUADTREE_H
+#define AOE_QUADTREE_H
+
+#include "aoe_world.h"
+
+//松散四叉树空间索引, 接口与AoeWorld一致, 适合实体高度聚集的场景(主城密集, 野外稀疏).
+//节点的松散范围是自身范围的AOE_QUAD_LOOSE倍, 实体在松散范围内移动时只更新坐标, 不改变所在节点.
+//节点超过容量时分裂, 子树实体数降到容量一半以下时合并. 子节点4个一组从节点池分配, 合并时归还.
+//超出根节点松散范围的实体挂在根节点上, 每次查询都会检测.
+const f32 AOE_QUAD_LOOSE = 2.0f;
+const u32 AOE_QUAD_NONE = (u32)-1; //空节点/空链表
+
+class AoeQuadTree
+{
+public:
+    AoeQuadTree();
+    ~AoeQuadTree() {}
+    //根节点覆盖[min_x, min_x + width) x [min_y, min_y + height)的外接正方形
+    //node_capacity为叶子节点的实体上限, max_depth为最大深度(根为0), 到达最大深度后不再分裂
+    s32 Init(f32 min_x, f32 min_y, f32 width, f32 height, u32 node_capacity = 16, u32 max_depth = 8);
+    s32 AddEntity(u64 id, const Point3& pos, f32 radius);
+    s32 MoveEntity(u64 id, const Point3& pos);
+    s32 RemoveEntity(u64 id);
+    void Clear();
+    //只检测与形状包围体重叠的子树中的实体, 命中的实体追加到hits. 返回命中个数, 负数为错误.
+    s32 Query(AreaShape& shape, std::vector<AoeHit>& hits);
+    u32 entity_count() const { return (u32)ids_.size(); }
+    //正在使用的节点数
+    u32 node_count() const { return (u32)(nodes_.size() - free_blocks_.size() * 4); }
+private:
+    struct Node
+    {
+        f32 center_x;
+        f32 center_y;
+        f32 half; //非松散的半边长
+        u32 depth;
+        u32 parent;
+        u32 child; //4个子节点中的第一个, 叶子节点为AOE_QUAD_NONE
+        u32 head; //挂在本节点上的实体链表
+        u32 count; //挂在本节点上的实体数
+        u32 total; //子树的实体总数
+    };
+    bool InLoose(u32 node, f32 x, f32 y) const;
+    u32 ChildOf(u32 node, f32 x, f32 y) const;
+    u32 AllocBlock();
+    void Link(u32 slot, u32 node);
+    void Unlink(u32 slot);
+    void Insert(u32 slot);
+    void Split(u32 node);
+    void Merge(u32 node);
+    void Shrink(u32 node);
+private:
+    u32 node_capacity_;
+    u32 max_depth_;
+    f32 max_radius_; //所有实体中最大的半径 查询时用来扩展包围圆
+
+    std::vector<Node> nodes_; //0号为根节点
+    std::vector<u32> free_blocks_; //回收的子节点组
+
+    //实体数据 按槽位存放 删除时与末尾交换
+    std::vector<u64> ids_;
+    std::vector<f32> xs_;
+    std::vector<f32> ys_;
+    std::vector<f32> zs_;
+    std::vector<f32> radius_;
+    std::vector<u32> node_of_;
+    std::vector<u32> prev_; //节点内实体双向链表
+    std::vector<u32> next_;
+    std::unordered_map<u64, u32> slot_of_;
+
+    //查询时的遍历栈和收集候选实体的缓存
+    std::vector<u32> stack_;
+    std::vector<u32> candidate_slots_;
+    std::vector<f32> candidate_x_;
+    std::vector<f32> candidate_y_;
+    std::vector<f32> candidate_z_;
+    std::vector<f32> candidate_radius_;
+    std::vector<f32> candidate_dist_;
+    std::vector<u64> candidate_bits_;
+};
+
+
+#endif //
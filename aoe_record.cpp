@@ -0,0 +1,437 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "aoe_record.h"
+#include "aoe_stat.h"
+
+const u32 AOE_RECORD_ALIGN = 64;
+const u32 AOE_RECORD_MIN_CAPACITY = 64;
+
+static void AoeRecordHead(AoeShapeRecord& record, u32 shape_type, u32 flags, const Point3& anchor, f32 anchor_radius, f32 high)
+{
+    record = AoeShapeRecord();
+    record.shape_type = shape_type;
+    record.flags = flags;
+    record.anchor = anchor;
+    record.anchor_radius = anchor_radius;
+    record.high = high;
+}
+
+//批量检测并计入统计. 开启统计时未命中的目标用标量检测补出返回码, 与AreaShape::PointsInRange的统计一致
+template<class Kernel>
+static s32 AoeRecordRun(u32 shape_type, const Kernel& kernel, const AreaPoints& points, u64* hit_bits, f32* dist_sq)
+{
+    s32 ret = RunAreaKernel(kernel, points, hit_bits, dist_sq);
+#if AOE_STAT_ENABLE
+    if (ret >= 0 && AoeStatEnabled())
+    {
+        AoeStatRecordHits(shape_type, (u32)ret);
+        for (u32 i = 0; i < points.count; i++)
+        {
+            if (!AreaHitTest(hit_bits, i))
+            {
+                f32 miss_dist_sq = 0.0f;
+                s32 code = AreaKernelPointInRange(kernel, Point3(points.x[i], points.y[i], points.z[i]), points.radius != NULL ? points.radius[i] : 0.0f, miss_dist_sq);
+                AoeStatRecord(shape_type, code);
+            }
+        }
+    }
+#else
+    (void)shape_type;
+#endif
+    return ret;
+}
+
+static void AoeRecordExpand(const AoeShapeRecord& record, AreaCircleKernel& kernel)
+{
+    kernel.anchor = record.anchor;
+    kernel.anchor_radius = record.anchor_radius;
+    kernel.min_radius_sq = record.circle.min_radius_sq;
+    kernel.max_radius = record.circle.max_radius;
+    kernel.high = record.high;
+}
+
+static void AoeRecordExpand(const AoeShapeRecord& record, AreaFanKernel& kernel)
+{
+    const AoeFanRecord& fan = record.fan;
+    kernel.anchor = record.anchor;
+    kernel.anchor_radius = record.anchor_radius;
+    kernel.normalize_dir = Point3(fan.dir_x, fan.dir_y, 0.0f);
+    kernel.radian = fan.radian;
+    kernel.radian_radius = fan.radian_radius;
+    kernel.high = record.high;
+    kernel.is_circle = (record.flags & AOE_RECORD_FLAG_CIRCLE) != 0;
+    kernel.is_wide = (record.flags & AOE_RECORD_FLAG_WIDE) != 0;
+    kernel.edge_length = fan.radian_radius + record.anchor_radius;
+    kernel.left_dir = Point3(fan.left_x, fan.left_y, 0.0f);
+    kernel.right_dir = Point3(fan.right_x, fan.right_y, 0.0f);
+    kernel.left_normal = Point3(-fan.left_y, fan.left_x, 0.0f);
+    kernel.right_normal = Point3(fan.right_y, -fan.right_x, 0.0f);
+}
+
+static void AoeRecordExpand(const AoeShapeRecord& record, AreaRectKernel& kernel)
+{
+    const AoeRectRecord& rect = record.rect;
+    kernel.anchor = record.anchor;
+    kernel.anchor_radius = record.anchor_radius;
+    kernel.distance = rect.distance;
+    kernel.high = record.high;
+    kernel.collide_test = (record.flags & AOE_RECORD_FLAG_COLLIDE) != 0;
+    kernel.frame_test = (record.flags & AOE_RECORD_FLAG_FRAME) != 0;
+    kernel.center = Point3(rect.center_x, rect.center_y, record.anchor.z);
+    kernel.dir = Point3(rect.dir_x, rect.dir_y, 0.0f);
+    kernel.half_length = rect.half_length;
+    kernel.half_wide = rect.half_wide;
+}
+
+static void AoeRecordExpand(const AoeShapeRecord& record, AreaCapsuleKernel& kernel)
+{
+    const AoeCapsuleRecord& capsule = record.capsule;
+    kernel.anchor = record.anchor;
+    kernel.anchor_radius = record.anchor_radius;
+    kernel.dir = Point3(capsule.dir_x, capsule.dir_y, 0.0f);
+    kernel.length = capsule.length;
+    kernel.sweep_radius = capsule.sweep_radius;
+    kernel.high = record.high;
+}
+
+
+AoeShapePool::AoeShapePool()
+{
+    memory_ = NULL;
+    records_ = NULL;
+    capacity_ = 0;
+    slot_count_ = 0;
+}
+
+AoeShapePool::~AoeShapePool()
+{
+    delete[] memory_;
+}
+
+s32 AoeShapePool::Reserve(u32 capacity)
+{
+    if (capacity <= capacity_)
+    {
+        return 0;
+    }
+    //多申请一条缓存行用来对齐 记录都是平凡类型, 扩容时整块拷贝
+    u8* memory = new (std::nothrow) u8[(u64)capacity * sizeof(AoeShapeRecord) + AOE_RECORD_ALIGN];
+    if (memory == NULL)
+    {
+        LOGFMTE("shape pool reserve error. capacity:<%u>", capacity);
+        return -1;
+    }
+    AoeShapeRecord* records = (AoeShapeRecord*)(((size_t)memory + AOE_RECORD_ALIGN - 1) & ~(size_t)(AOE_RECORD_ALIGN - 1));
+    if (slot_count_ > 0)
+    {
+        memcpy(records, records_, (u64)slot_count_ * sizeof(AoeShapeRecord));
+    }
+    delete[] memory_;
+    memory_ = memory;
+    records_ = records;
+    capacity_ = capacity;
+    return 0;
+}
+
+u32 AoeShapePool::AllocExt(std::vector<u32>& free_list, u32 size)
+{
+    if (!free_list.empty())
+    {
+        u32 index = free_list.back();
+        free_list.pop_back();
+        return index;
+    }
+    return size;
+}
+
+s32 AoeShapePool::Add(const AreaShape& shape, u32& handle)
+{
+    u32 shape_type = shape.shape_type();
+    if (shape_type == AREA_SHAPE_NONE)
+    {
+        LOGFMTE("shape pool add error. shape not init.");
+        return -1;
+    }
+    if (free_slots_.empty() && slot_count_ == capacity_)
+    {
+        s32 ret = Reserve(capacity_ < AOE_RECORD_MIN_CAPACITY ? AOE_RECORD_MIN_CAPACITY : capacity_ * 2);
+        if (ret != 0)
+        {
+            return ret;
+        }
+    }
+
+    AoeShapeRecord record;
+    switch (shape_type)
+    {
+    case AREA_SHAPE_CIRCLE:
+    case AREA_SHAPE_RING:
+    {
+        AreaCircleKernel kernel;
+        shape.BuildKernel(kernel);
+        AoeRecordHead(record, shape_type, 0, kernel.anchor, kernel.anchor_radius, kernel.high);
+        record.circle.min_radius_sq = kernel.min_radius_sq;
+        record.circle.max_radius = kernel.max_radius;
+        break;
+    }
+    case AREA_SHAPE_FAN:
+    {
+        AreaFanKernel kernel;
+        shape.BuildKernel(kernel);
+        u32 flags = (kernel.is_circle ? AOE_RECORD_FLAG_CIRCLE : 0) | (kernel.is_wide ? AOE_RECORD_FLAG_WIDE : 0);
+        AoeRecordHead(record, shape_type, flags, kernel.anchor, kernel.anchor_radius, kernel.high);
+        record.fan.radian_radius = kernel.radian_radius;
+        record.fan.radian = kernel.radian;
+        record.fan.dir_x = kernel.normalize_dir.x;
+        record.fan.dir_y = kernel.normalize_dir.y;
+        record.fan.left_x = kernel.left_dir.x;
+        record.fan.left_y = kernel.left_dir.y;
+        record.fan.right_x = kernel.right_dir.x;
+        record.fan.right_y = kernel.right_dir.y;
+        break;
+    }
+    case AREA_SHAPE_RECT:
+    case AREA_SHAPE_FRAME:
+    {
+        AreaRectKernel kernel;
+        shape.BuildKernel(kernel);
+        u32 flags = (kernel.collide_test ? AOE_RECORD_FLAG_COLLIDE : 0) | (kernel.frame_test ? AOE_RECORD_FLAG_FRAME : 0);
+        AoeRecordHead(record, shape_type, flags, kernel.anchor, kernel.anchor_radius, kernel.high);
+        record.rect.distance = kernel.distance;
+        record.rect.center_x = kernel.center.x;
+        record.rect.center_y = kernel.center.y;
+        record.rect.dir_x = kernel.dir.x;
+        record.rect.dir_y = kernel.dir.y;
+        record.rect.half_length = kernel.half_length;
+        record.rect.half_wide = kernel.half_wide;
+        break;
+    }
+    case AREA_SHAPE_CAPSULE:
+    {
+        AreaCapsuleKernel kernel;
+        shape.BuildKernel(kernel);
+        AoeRecordHead(record, shape_type, 0, kernel.anchor, kernel.anchor_radius, kernel.high);
+        record.capsule.dir_x = kernel.dir.x;
+        record.capsule.dir_y = kernel.dir.y;
+        record.capsule.length = kernel.length;
+        record.capsule.sweep_radius = kernel.sweep_radius;
+        break;
+    }
+    case AREA_SHAPE_FOV:
+    {
+        AreaFovKernel kernel;
+        shape.BuildKernel(kernel);
+        u32 index = AllocExt(free_fovs_, (u32)fovs_.size());
+        if (index == fovs_.size())
+        {
+            fovs_.push_back(kernel);
+        }
+        else
+        {
+            fovs_[index] = kernel;
+        }
+        AoeRecordHead(record, shape_type, 0, kernel.apex, 0.0f, 0.0f);
+        record.ext.index = index;
+        break;
+    }
+    case AREA_SHAPE_POLYGON:
+    {
+        AreaPolygonKernel kernel;
+        shape.BuildKernel(kernel);
+        u32 index = AllocExt(free_polygons_, (u32)polygons_.size());
+        if (index == polygons_.size())
+        {
+            polygons_.push_back(kernel);
+        }
+        else
+        {
+            polygons_[index] = kernel;
+        }
+        AoeRecordHead(record, shape_type, 0, kernel.anchor, kernel.anchor_radius, kernel.high);
+        record.ext.index = index;
+        break;
+    }
+    default:
+        LOGFMTE("shape pool add error. unknown shape_type:<%u>", shape_type);
+        return -2;
+    }
+
+    handle = AllocExt(free_slots_, slot_count_);
+    if (handle == slot_count_)
+    {
+        slot_count_++;
+    }
+    records_[handle] = record;
+    return 0;
+}
+
+s32 AoeShapePool::Remove(u32 handle)
+{
+    if (!IsValid(handle))
+    {
+        LOGFMTE("shape pool remove error. invalid handle:<%u>", handle);
+        return -1;
+    }
+    AoeShapeRecord& record = records_[handle];
+    if (record.shape_type == AREA_SHAPE_FOV)
+    {
+        free_fovs_.push_back(record.ext.index);
+    }
+    else if (record.shape_type == AREA_SHAPE_POLYGON)
+    {
+        free_polygons_.push_back(record.ext.index);
+    }
+    record.shape_type = AREA_SHAPE_NONE;
+    free_slots_.push_back(handle);
+    return 0;
+}
+
+void AoeShapePool::Clear()
+{
+    slot_count_ = 0;
+    free_slots_.clear();
+    fovs_.clear();
+    free_fovs_.clear();
+    polygons_.clear();
+    free_polygons_.clear();
+}
+
+s32 AoeShapePool::PointsInRange(u32 handle, const AreaPoints& points, u64* hit_bits, f32* dist_sq) const
+{
+    if (!IsValid(handle))
+    {
+        LOGFMTE("shape pool points in range error. invalid handle:<%u>", handle);
+        return -1;
+    }
+    const AoeShapeRecord& record = records_[handle];
+    if (hit_bits == NULL || (points.count > 0 && (points.x == NULL || points.y == NULL || points.z == NULL)))
+    {
+        LOGFMTE("shape pool points in range error. param null. count:<%u>, shape_type:<%u>", points.count, record.shape_type);
+        return -2;
+    }
+
+    s32 ret = 0;
+    switch (record.shape_type)
+    {
+    case AREA_SHAPE_CIRCLE:
+    case AREA_SHAPE_RING:
+    {
+        AreaCircleKernel kernel;
+        AoeRecordExpand(record, kernel);
+        ret = AoeRecordRun(record.shape_type, kernel, points, hit_bits, dist_sq);
+        break;
+    }
+    case AREA_SHAPE_FAN:
+    {
+        AreaFanKernel kernel;
+        AoeRecordExpand(record, kernel);
+        ret = AoeRecordRun(record.shape_type, kernel, points, hit_bits, dist_sq);
+        break;
+    }
+    case AREA_SHAPE_RECT:
+    case AREA_SHAPE_FRAME:
+    {
+        AreaRectKernel kernel;
+        AoeRecordExpand(record, kernel);
+        ret = AoeRecordRun(record.shape_type, kernel, points, hit_bits, dist_sq);
+        break;
+    }
+    case AREA_SHAPE_CAPSULE:
+    {
+        AreaCapsuleKernel kernel;
+        AoeRecordExpand(record, kernel);
+        ret = AoeRecordRun(record.shape_type, kernel, points, hit_bits, dist_sq);
+        break;
+    }
+    case AREA_SHAPE_FOV:
+        ret = AoeRecordRun(record.shape_type, fovs_[record.ext.index], points, hit_bits, dist_sq);
+        break;
+    case AREA_SHAPE_POLYGON:
+        ret = AoeRecordRun(record.shape_type, polygons_[record.ext.index], points, hit_bits, dist_sq);
+        break;
+    default:
+        LOGFMTE("shape pool points in range error. unknown shape_type:<%u>", record.shape_type);
+        return -4;
+    }
+    return ret;
+}
+
+s32 AoeShapePool::BuildKernel(u32 handle, AreaCircleKernel& kernel) const
+{
+    if (!IsValid(handle) || (records_[handle].shape_type != AREA_SHAPE_CIRCLE && records_[handle].shape_type != AREA_SHAPE_RING))
+    {
+        return -1;
+    }
+    AoeRecordExpand(records_[handle], kernel);
+    return 0;
+}
+
+s32 AoeShapePool::BuildKernel(u32 handle, AreaFanKernel& kernel) const
+{
+    if (!IsValid(handle) || records_[handle].shape_type != AREA_SHAPE_FAN)
+    {
+        return -1;
+    }
+    AoeRecordExpand(records_[handle], kernel);
+    return 0;
+}
+
+s32 AoeShapePool::BuildKernel(u32 handle, AreaRectKernel& kernel) const
+{
+    if (!IsValid(handle) || (records_[handle].shape_type != AREA_SHAPE_RECT && records_[handle].shape_type != AREA_SHAPE_FRAME))
+    {
+        return -1;
+    }
+    AoeRecordExpand(records_[handle], kernel);
+    return 0;
+}
+
+s32 AoeShapePool::BuildKernel(u32 handle, AreaFovKernel& kernel) const
+{
+    if (!IsValid(handle) || records_[handle].shape_type != AREA_SHAPE_FOV)
+    {
+        return -1;
+    }
+    kernel = fovs_[records_[handle].ext.index];
+    return 0;
+}
+
+s32 AoeShapePool::BuildKernel(u32 handle, AreaCapsuleKernel& kernel) const
+{
+    if (!IsValid(handle) || records_[handle].shape_type != AREA_SHAPE_CAPSULE)
+    {
+        return -1;
+    }
+    AoeRecordExpand(records_[handle], kernel);
+    return 0;
+}
+
+s32 AoeShapePool::BuildKernel(u32 handle, AreaPolygonKernel& kernel) const
+{
+    if (!IsValid(handle) || records_[handle].shape_type != AREA_SHAPE_POLYGON)
+    {
+        return -1;
+    }
+    kernel = polygons_[records_[handle].ext.index];
+    return 0;
+}
+
+u64 AoeShapePool::memory_bytes() const
+{
+    return (u64)capacity_ * sizeof(AoeShapeRecord) + fovs_.capacity() * sizeof(AreaFovKernel) + polygons_.capacity() * sizeof(AreaPolygonKernel);
+}
@@ -0,0 +1,139 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+#ifndef AOE_RECORD_H
+#define AOE_RECORD_H
+
+#include "aoe_shape.h"
+
+//各形状只保存检测核心用到的参数, 其余(法线, 边的长度等)展开检测参数时由这些参数推出, 结果与AreaShape逐位一致.
+struct AoeCircleRecord
+{
+    f32 min_radius_sq;
+    f32 max_radius;
+};
+
+struct AoeFanRecord
+{
+    f32 radian_radius;
+    f32 radian;
+    f32 dir_x;
+    f32 dir_y;
+    f32 left_x; //左右两条边的方向 法线由方向旋转90度得到
+    f32 left_y;
+    f32 right_x;
+    f32 right_y;
+};
+
+struct AoeRectRecord
+{
+    f32 distance;
+    f32 center_x;
+    f32 center_y;
+    f32 dir_x;
+    f32 dir_y;
+    f32 half_length;
+    f32 half_wide;
+};
+
+struct AoeCapsuleRecord
+{
+    f32 dir_x;
+    f32 dir_y;
+    f32 length;
+    f32 sweep_radius;
+};
+
+//视锥和多边形的参数放不进一条缓存行, 存放在容器的附加数组中
+struct AoeExtRecord
+{
+    u32 index;
+};
+
+const u32 AOE_RECORD_FLAG_CIRCLE = 0x1; //扇形接近360度 按圆检测
+const u32 AOE_RECORD_FLAG_WIDE = 0x2; //扇形半角超过90度
+const u32 AOE_RECORD_FLAG_COLLIDE = 0x4; //矩形检测定位点碰撞
+const u32 AOE_RECORD_FLAG_FRAME = 0x8; //矩形只检测边框
+
+//紧凑形状记录 一条记录占一条缓存行. 圆形/扇形/矩形/胶囊检测时只读这一条缓存行.
+struct alignas(64) AoeShapeRecord
+{
+    u32 shape_type; //AreaShapeType, 空闲的记录为-1
+    u32 flags;
+    Point3 anchor;
+    f32 anchor_radius;
+    f32 high;
+    union
+    {
+        AoeCircleRecord circle;
+        AoeFanRecord fan;
+        AoeRectRecord rect;
+        AoeCapsuleRecord capsule;
+        AoeExtRecord ext;
+    };
+};
+
+static_assert(sizeof(AoeShapeRecord) == 64, "shape record must fit one cache line");
+
+//常驻形状(地面效果等)的容器. 记录连续存放在按缓存行对齐的数组中, 删除的记录进入空闲链表, 句柄(记录下标)在删除前保持不变.
+//视锥和多边形的检测参数较大, 放在各自的附加数组中, 记录只保存其下标.
+class AoeShapePool
+{
+public:
+    AoeShapePool();
+    ~AoeShapePool();
+    AoeShapePool(const AoeShapePool&) = delete;
+    AoeShapePool& operator=(const AoeShapePool&) = delete;
+    //预留记录空间 避免反复扩容
+    s32 Reserve(u32 capacity);
+    //从已Init的AreaShape压缩出一条记录, 句柄写入handle
+    s32 Add(const AreaShape& shape, u32& handle);
+    s32 Remove(u32 handle);
+    void Clear();
+    //批量检测, 参数和返回值与AreaShape::PointsInRange相同
+    s32 PointsInRange(u32 handle, const AreaPoints& points, u64* hit_bits, f32* dist_sq) const;
+    //展开检测参数, 与AreaShape::BuildKernel的结果一致. 类型不匹配或句柄无效时返回非0
+    s32 BuildKernel(u32 handle, AreaCircleKernel& kernel) const;
+    s32 BuildKernel(u32 handle, AreaFanKernel& kernel) const;
+    s32 BuildKernel(u32 handle, AreaRectKernel& kernel) const;
+    s32 BuildKernel(u32 handle, AreaFovKernel& kernel) const;
+    s32 BuildKernel(u32 handle, AreaCapsuleKernel& kernel) const;
+    s32 BuildKernel(u32 handle, AreaPolygonKernel& kernel) const;
+    bool IsValid(u32 handle) const { return handle < slot_count_ && records_[handle].shape_type != AREA_SHAPE_NONE; }
+    //记录数组 下标[0, slot_count())中shape_type为-1的是空闲记录
+    const AoeShapeRecord* records() const { return records_; }
+    u32 slot_count() const { return slot_count_; }
+    u32 shape_count() const { return slot_count_ - (u32)free_slots_.size(); }
+    //记录和附加数组占用的字节数
+    u64 memory_bytes() const;
+private:
+    u32 AllocExt(std::vector<u32>& free_list, u32 size);
+private:
+    u8* memory_; //records_对齐前的原始内存
+    AoeShapeRecord* records_;
+    u32 capacity_;
+    u32 slot_count_;
+    std::vector<u32> free_slots_;
+    std::vector<AreaFovKernel> fovs_;
+    std::vector<u32> free_fovs_;
+    std::vector<AreaPolygonKernel> polygons_;
+    std::vector<u32> free_polygons_;
+};
+
+
+#endif //
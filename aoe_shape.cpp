@@ -15,10 +15,41 @@
 * limitations under the License.
 */
 
+//逐点检测中的调试日志在编译期去掉. 需要时在编译参数中指定FN_LOG_COMPILE_MIN_PRIORITY=0
+#ifndef FN_LOG_COMPILE_MIN_PRIORITY
+#define FN_LOG_COMPILE_MIN_PRIORITY 2
+#endif
 #include "aoe_shape.h"
+#include "aoe_stat.h"
 #include "glm/glm.hpp"
 #include "glm/matrix.hpp"
 #include "glm/gtc/matrix_transform.hpp"
+#include <algorithm>
+
+//包围盒在xy平面上扩展到包含以center为圆心的圆
+static void AreaBoundsMerge(AreaBounds& bounds, const Point3& center, f32 radius)
+{
+    bounds.min.x = std::min(bounds.min.x, center.x - radius);
+    bounds.min.y = std::min(bounds.min.y, center.y - radius);
+    bounds.max.x = std::max(bounds.max.x, center.x + radius);
+    bounds.max.y = std::max(bounds.max.y, center.y + radius);
+}
+
+//包围圆取形状给出的圆和包围盒外接圆中较小的一个
+static void AreaBoundsFit(AreaBounds& bounds, const Point3& center, f32 radius)
+{
+    f32 half_x = (bounds.max.x - bounds.min.x) * 0.5f;
+    f32 half_y = (bounds.max.y - bounds.min.y) * 0.5f;
+    f32 box_radius = sqrtf(half_x * half_x + half_y * half_y);
+    if (box_radius < radius)
+    {
+        bounds.center = Point3(bounds.min.x + half_x, bounds.min.y + half_y, center.z);
+        bounds.radius = box_radius;
+        return;
+    }
+    bounds.center = center;
+    bounds.radius = radius;
+}
 
 s32 AreaShapeRect::Init(DeviationShape deviation, f32 radius, bool collide_test, bool frame_test)
 {
@@ -45,30 +76,19 @@ s32 AreaShapeRect::Init(DeviationShape deviation, f32 radius, bool collide_test,
     frame_test_ = frame_test;
     collide_test_ = collide_test;
 
-    Point3 vertex_point = deviation.pivot_pos;
-    vertex_point.z = 0.0f;
     anchor_ = deviation.pivot_pos;
     anchor_radius_ = radius;
 
-
-    //二维逆时针的凸多边形
-    Point3 right = { tmp_dir.y, tmp_dir.x * -1.0f, 0.0f};
-    Point3 left = { tmp_dir.y * -1.0f, tmp_dir.x, 0.0f};
-    vertexs_[0] = vertex_point + right * (wide * 0.5f);
-    vertexs_[1] = (vertexs_[0] + tmp_dir * len);
-    lines_[0] = vertexs_[1] - vertexs_[0];
-    line_inv_length_[0] = 1.0f / len;
-
-    vertexs_[2] = (vertexs_[1] + left * wide);
-    lines_[1] = vertexs_[2] - vertexs_[1];
-    line_inv_length_[1] = 1.0f / wide;
-
-    vertexs_[3] = vertexs_[0] + left * wide;
-    lines_[2] = vertexs_[3] - vertexs_[2];
-    line_inv_length_[2] = line_inv_length_[0];
-
-    lines_[3] = vertexs_[0] - vertexs_[3];
-    line_inv_length_[3] = line_inv_length_[1];
+    //局部坐标系: 定位点在矩形一条短边的中点, 矩形沿朝向延伸len
+    dir_ = Point3(tmp_dir.x, tmp_dir.y, 0.0f);
+    if (!dir_.normalize())
+    {
+        LOGFMTE("dir 2d normalize false");
+        return -4;
+    }
+    half_length_ = len * 0.5f;
+    half_wide_ = wide * 0.5f;
+    center_ = Point3(anchor_.x + dir_.x * half_length_, anchor_.y + dir_.y * half_length_, anchor_.z);
 
     distance_ = sqrtf(wide*wide + len * len);
     high_ = high;
@@ -106,49 +126,33 @@ s32 AreaShapeRect::PointInRange(const Point3& pos, f32 radius, f32 & dist_sq)
         return 0;
     }
 
-    //二维凸多边形的点包含检测 判断目标半径 
-    f32 min_shorted_line = distance_;
-    for (size_t i = 0; i < VERTEX_SIZE; i++)
+    //转到矩形局部坐标系, 按对称性折到第一象限. over_x/over_y为超出半长/半宽的距离, 负数表示在内侧
+    f32 local_x = pos.x - center_.x;
+    f32 local_y = pos.y - center_.y;
+    f32 over_x = fabsf(local_x * dir_.x + local_y * dir_.y) - half_length_;
+    f32 over_y = fabsf(local_y * dir_.x - local_x * dir_.y) - half_wide_;
+    f32 out_x = over_x > 0.0f ? over_x : 0.0f;
+    f32 out_y = over_y > 0.0f ? over_y : 0.0f;
+    f32 out_sq = out_x * out_x + out_y * out_y; //到矩形的最近距离的平方
+    if (out_sq > 0.0f)
     {
-        const Point3& line = lines_[i];
-        Point3 test_side(pos.x - vertexs_[i].x, pos.y - vertexs_[i].y, 0.0f);
-        if (test_side.is_zero())
+        if (radius < FLOAT_POINT_PRECISION)
         {
-            return 0;
+            return 2;
         }
-        Point3 cross = line.cross(test_side);
-        if (cross.z < 0) //
+        //在矩形外部 碰撞圆需要与矩形相交
+        if (out_sq > radius * radius)
         {
-            if (radius < FLOAT_POINT_PRECISION)
-            {
-                return 2;
-            }
-            //在凸多边形外部 需要检测下碰撞圆是否全部在外侧  
-            f32 shorted_line = cross.length() * line_inv_length_[i];
-            if (shorted_line > radius)
-            {
-                return 3;
-            }
-            else
-            {
-                if (min_shorted_line > shorted_line)
-                {
-                    min_shorted_line = shorted_line;
-                }
-            }
-        }
-        else if (frame_test_)
-        {
-            f32 shorted_line = cross.length() * line_inv_length_[i];
-            if (min_shorted_line > shorted_line)
-            {
-                min_shorted_line = shorted_line;
-            }
+            return 3;
         }
+        return 0;
     }
+
+    //在矩形内部 边框只检测碰撞圆是否压到最近的边
     if (frame_test_)
     {
-        if (min_shorted_line > radius)
+        f32 over = over_x > over_y ? over_x : over_y;
+        if (over < -radius)
         {
             return 4;
         }
@@ -158,6 +162,40 @@ s32 AreaShapeRect::PointInRange(const Point3& pos, f32 radius, f32 & dist_sq)
 
 
 
+void AreaShapeRect::BuildKernel(AreaRectKernel& kernel) const
+{
+    kernel.anchor = anchor_;
+    kernel.anchor_radius = anchor_radius_;
+    kernel.distance = distance_;
+    kernel.high = high_;
+    kernel.collide_test = collide_test_;
+    kernel.frame_test = frame_test_;
+    kernel.center = center_;
+    kernel.dir = dir_;
+    kernel.half_length = half_length_;
+    kernel.half_wide = half_wide_;
+}
+
+s32 AreaShapeRect::PointsInRange(const AreaPoints& points, u64* hit_bits, f32* dist_sq)
+{
+    AreaRectKernel kernel;
+    BuildKernel(kernel);
+    return RunAreaKernel(kernel, points, hit_bits, dist_sq);
+}
+
+void AreaShapeRect::Bounds(AreaBounds& bounds) const
+{
+    //旋转后的矩形加上定位点的碰撞圆
+    f32 extent_x = fabsf(dir_.x) * half_length_ + fabsf(dir_.y) * half_wide_;
+    f32 extent_y = fabsf(dir_.y) * half_length_ + fabsf(dir_.x) * half_wide_;
+    bounds.min = Point3(center_.x - extent_x, center_.y - extent_y, anchor_.z - high_);
+    bounds.max = Point3(center_.x + extent_x, center_.y + extent_y, anchor_.z + high_);
+    AreaBoundsMerge(bounds, anchor_, anchor_radius_);
+    f32 corner = sqrtf(half_length_ * half_length_ + half_wide_ * half_wide_);
+    AreaBoundsFit(bounds, center_, corner > half_length_ + anchor_radius_ ? corner : half_length_ + anchor_radius_);
+}
+
+
 s32 AreaShapeFan::Init(DeviationShape deviation, f32 radius)
 {
     if (deviation.pivot_scale.x < FLOAT_POINT_PRECISION || deviation.pivot_scale.y < FLOAT_POINT_PRECISION)
@@ -178,9 +216,11 @@ s32 AreaShapeFan::Init(DeviationShape deviation, f32 radius)
     radian_radius_ = deviation.pivot_scale.y;
     high_ = deviation.pivot_scale.z;
     is_circle_ = deviation.pivot_scale.x > 360.0f * 0.8f ? true : false; //超过一定度数(接近360度)则认为是一个圆
+    is_wide_ = false;
+    edge_length_ = radian_radius_ + anchor_radius_;
+    left_dir_ = right_dir_ = left_normal_ = right_normal_ = Point3(0.0f, 0.0f, 0.0f);
     if (!is_circle_)
     {
-        radian_domain_ = cos(radian_);
         normalize_dir_ = deviation.pivot_dir;
         if (normalize_dir_.is_zero())
         {
@@ -192,6 +232,14 @@ s32 AreaShapeFan::Init(DeviationShape deviation, f32 radius)
             LOGFMTE("dir normalize false");
             return -6;
         }
+        //两条边由朝向分别旋转正负半角得到
+        f32 sin_half = sinf(radian_);
+        f32 cos_half = cosf(radian_);
+        is_wide_ = radian_ > PI * 0.5f;
+        left_dir_ = Point3(normalize_dir_.x * cos_half - normalize_dir_.y * sin_half, normalize_dir_.x * sin_half + normalize_dir_.y * cos_half, 0.0f);
+        right_dir_ = Point3(normalize_dir_.x * cos_half + normalize_dir_.y * sin_half, normalize_dir_.y * cos_half - normalize_dir_.x * sin_half, 0.0f);
+        left_normal_ = Point3(-left_dir_.y, left_dir_.x, 0.0f);
+        right_normal_ = Point3(right_dir_.y, -right_dir_.x, 0.0f);
     }
     return 0;
 }
@@ -229,25 +277,49 @@ s32 AreaShapeFan::PointInRange(const Point3& pos, f32 radius, f32 & dist_sq)
 
     if (!is_circle_)
     {
-        f32 radian_domain = test_line.dot(normalize_dir_) * Point3::INVERSE_SQRT(dist_sq); //值域总是在[-1,+1], angle[180, 0]
-        if (radian_domain  > radian_domain_)
+        //在两条边的内侧即在扇形角度内. 半角超过90度时只需要在其中一条边的内侧
+        f32 left_dist = test_line.x * left_normal_.x + test_line.y * left_normal_.y;
+        f32 right_dist = test_line.x * right_normal_.x + test_line.y * right_normal_.y;
+        bool in_radian = is_wide_ ? (left_dist <= 0.0f || right_dist <= 0.0f) : (left_dist <= 0.0f && right_dist <= 0.0f);
+        if (in_radian)
         {
             return 0;
         }
 
-        //判断目标半径是否相交比较浪费性能 如果目标圆太小最好直接忽略
         if (radius < FLOAT_POINT_PRECISION)
         {
-            LOGFMTD("range over radian. cur %f,  fan %f", acos(radian_domain) / 2.0f / 3.14f*360.0f, radian_ / 2.0f / 3.14f*360.0f);
+            LOGFMTD("range over radian. left:<%f>, right:<%f>", left_dist, right_dist);
             return 3;
         }
 
-        f32 radian_add_domain = radius * radius / 2.0f / dist_sq;
-        if (acos(radian_domain) < acos(1 - radian_add_domain) + radian_)
+        //角度外时离扇形最近的点在同侧的边上, 检测目标圆与这条边(线段)是否相交
+        f32 side = normalize_dir_.x * test_line.y - normalize_dir_.y * test_line.x;
+        const Point3& edge_dir = side >= 0.0f ? left_dir_ : right_dir_;
+        f32 edge_dist = side >= 0.0f ? left_dist : right_dist;
+        f32 project = test_line.x * edge_dir.x + test_line.y * edge_dir.y;
+        f32 radius_sq_target = radius * radius;
+        //投影在顶点之后时最近点是顶点, 前面的半径和检测已经排除
+        if (project <= 0.0f)
+        {
+            LOGFMTD("range over radian. behind apex project:<%f>", project);
+            return 4;
+        }
+        if (project < edge_length_)
+        {
+            if (edge_dist * edge_dist <= radius_sq_target)
+            {
+                return 0;
+            }
+            LOGFMTD("range over radian. edge dist:<%f>", edge_dist);
+            return 4;
+        }
+        f32 end_x = test_line.x - edge_dir.x * edge_length_;
+        f32 end_y = test_line.y - edge_dir.y * edge_length_;
+        if (end_x * end_x + end_y * end_y <= radius_sq_target)
         {
             return 0;
         }
-        LOGFMTD("range over radian. cur %f,  fan %f", acos(radian_domain) / 2.0f / 3.14f*360.0f, radian_ / 2.0f / 3.14f*360.0f);
+        LOGFMTD("range over radian. end dist_sq:<%f>", end_x * end_x + end_y * end_y);
         return 4;
     }
     return 0;
@@ -256,6 +328,60 @@ s32 AreaShapeFan::PointInRange(const Point3& pos, f32 radius, f32 & dist_sq)
 
 
 
+void AreaShapeFan::BuildKernel(AreaFanKernel& kernel) const
+{
+    kernel.anchor = anchor_;
+    kernel.anchor_radius = anchor_radius_;
+    kernel.normalize_dir = normalize_dir_;
+    kernel.radian = radian_;
+    kernel.radian_radius = radian_radius_;
+    kernel.high = high_;
+    kernel.is_circle = is_circle_;
+    kernel.is_wide = is_wide_;
+    kernel.edge_length = edge_length_;
+    kernel.left_dir = left_dir_;
+    kernel.right_dir = right_dir_;
+    kernel.left_normal = left_normal_;
+    kernel.right_normal = right_normal_;
+}
+
+s32 AreaShapeFan::PointsInRange(const AreaPoints& points, u64* hit_bits, f32* dist_sq)
+{
+    AreaFanKernel kernel;
+    BuildKernel(kernel);
+    return RunAreaKernel(kernel, points, hit_bits, dist_sq);
+}
+
+void AreaShapeFan::Bounds(AreaBounds& bounds) const
+{
+    bounds.min = Point3(anchor_.x - anchor_radius_, anchor_.y - anchor_radius_, anchor_.z - high_);
+    bounds.max = Point3(anchor_.x + anchor_radius_, anchor_.y + anchor_radius_, anchor_.z + high_);
+    if (is_circle_)
+    {
+        AreaBoundsMerge(bounds, anchor_, edge_length_);
+        AreaBoundsFit(bounds, anchor_, edge_length_);
+        return;
+    }
+    //两条边的端点, 以及落在扇形角度内的坐标轴方向上的弧顶点
+    Point3 left_end = Point3(anchor_.x + left_dir_.x * edge_length_, anchor_.y + left_dir_.y * edge_length_, anchor_.z);
+    Point3 right_end = Point3(anchor_.x + right_dir_.x * edge_length_, anchor_.y + right_dir_.y * edge_length_, anchor_.z);
+    AreaBoundsMerge(bounds, left_end, 0.0f);
+    AreaBoundsMerge(bounds, right_end, 0.0f);
+    const f32 axis[4][2] = { { 1.0f, 0.0f }, { -1.0f, 0.0f }, { 0.0f, 1.0f }, { 0.0f, -1.0f } };
+    for (u32 i = 0; i < 4; i++)
+    {
+        f32 left_dist = axis[i][0] * left_normal_.x + axis[i][1] * left_normal_.y;
+        f32 right_dist = axis[i][0] * right_normal_.x + axis[i][1] * right_normal_.y;
+        bool in_radian = is_wide_ ? (left_dist <= 0.0f || right_dist <= 0.0f) : (left_dist <= 0.0f && right_dist <= 0.0f);
+        if (in_radian)
+        {
+            AreaBoundsMerge(bounds, Point3(anchor_.x + axis[i][0] * edge_length_, anchor_.y + axis[i][1] * edge_length_, anchor_.z), 0.0f);
+        }
+    }
+    AreaBoundsFit(bounds, anchor_, edge_length_);
+}
+
+
 s32 AreaShapeCircle::Init(DeviationShape deviation, f32 radius)
 {
     anchor_ = deviation.pivot_pos;
@@ -299,51 +425,59 @@ s32 AreaShapeCircle::PointInRange(const Point3& pos, f32 radius, f32 & dist_sq)
 }
 
 
-s32 AreaShapeFov::Init(DeviationShape deviation, f32 radius)
+void AreaShapeCircle::BuildKernel(AreaCircleKernel& kernel) const
 {
-    shape = deviation;
-    return 0;
+    kernel.anchor = anchor_;
+    kernel.anchor_radius = anchor_radius_;
+    kernel.min_radius_sq = min_radius_sq_;
+    kernel.max_radius = max_radius_;
+    kernel.high = high_;
 }
 
+s32 AreaShapeCircle::PointsInRange(const AreaPoints& points, u64* hit_bits, f32* dist_sq)
+{
+    AreaCircleKernel kernel;
+    BuildKernel(kernel);
+    return RunAreaKernel(kernel, points, hit_bits, dist_sq);
+}
 
-s32 AreaShapeFov::PointInRange(const Point3& pos, f32 radius, f32& dist_sq)
+void AreaShapeCircle::Bounds(AreaBounds& bounds) const
+{
+    f32 radius = max_radius_ + anchor_radius_;
+    bounds.min = Point3(anchor_.x - radius, anchor_.y - radius, anchor_.z - high_);
+    bounds.max = Point3(anchor_.x + radius, anchor_.y + radius, anchor_.z + high_);
+    bounds.center = anchor_;
+    bounds.radius = radius;
+}
+
+
+s32 AreaShapeFov::Init(DeviationShape deviation, f32 radius)
 {
     (void)radius;
-    Point3 apex = shape.pivot_pos;
-    Point3 dir = shape.pivot_dir;
-    float pitch = shape.pivot_offset.z; 
-    float yaw = shape.pivot_offset.x; 
-    float fov = shape.pivot_scale.x; 
-    float aspect = shape.pivot_scale.y; 
-    float near_radius = shape.pivot_ext.x;
-    float far_radius = shape.pivot_scale.z; 
-    Point3 check_pos = pos;
+    Point3 apex = deviation.pivot_pos;
+    Point3 dir = deviation.pivot_dir;
+    float pitch = deviation.pivot_offset.z; 
+    float yaw = deviation.pivot_offset.x; 
+    float fov = deviation.pivot_scale.x; 
+    float aspect = deviation.pivot_scale.y; 
+    float near_radius = deviation.pivot_ext.x;
+    float far_radius = deviation.pivot_scale.z; 
     if (fov <= FLOAT_POINT_PRECISION || aspect <= FLOAT_POINT_PRECISION)
     {
-        return 1;
+        LOGFMTE("config error. fov:<%f>, aspect:<%f>", fov, aspect);
+        return -2;
     }
     if (near_radius + far_radius < FLOAT_POINT_PRECISION)
     {
-        return 2;
+        LOGFMTE("config error. near:<%f>, far:<%f>", near_radius, far_radius);
+        return -3;
     }
     if (dir.is_zero())
     {
-        return 3;
-    }
-
-    Point3 target_dir = check_pos - apex;
-    float dist_check = target_dir.length();
-    dist_sq = dist_check * dist_check;
-    if (dist_check > far_radius)
-    {
-        return 4;
-    }
-    if (target_dir.is_zero())
-    {
-        return 0;
+        LOGFMTE("dir zero");
+        return -4;
     }
 
-
     if (!FLOAT_IS_ZERO(yaw) )
     {
         glm::mat4 fov_mat4_dir(1.0f);
@@ -355,7 +489,8 @@ s32 AreaShapeFov::PointInRange(const Point3& pos, f32 radius, f32& dist_sq)
         dir.z = fov_v_dir.z;
         if (dir.is_zero())
         {
-            return 8;
+            LOGFMTE("fov yaw correction error. yaw:<%f>", yaw);
+            return -5;
         }
         dir.normalize();
     }
@@ -374,26 +509,13 @@ s32 AreaShapeFov::PointInRange(const Point3& pos, f32 radius, f32& dist_sq)
         dir.z = fov_v_dir.z;
         if (dir.is_zero())
         {
-            return 7;
+            LOGFMTE("fov pitch correction error. pitch:<%f>", pitch);
+            return -6;
         }
         dir.normalize();
     }
+    kernel_.dir = dir;
 
-
-
-    target_dir.normalize();
-    float max_fov = std::fmaxf(fov, fov * aspect);
-    float cos_angle = target_dir.dot(dir);
-    if (cos_angle < 0.0f)
-    {
-        return 9;
-    }
-    float real_angle = std::acosf(target_dir.dot(dir)) * ANGLE_PER_PI;
-    if (real_angle > max_fov / 2.0f)
-    {
-        return 10;
-    }
-    
     //视锥检测  
     Point3 top_dir;
     Point3 botton_dir;
@@ -446,59 +568,259 @@ s32 AreaShapeFov::PointInRange(const Point3& pos, f32 radius, f32& dist_sq)
     left_botton_dir.normalize();
     left_top_dir.normalize();
 
+    //四棱锥两组对面的法线 目标只需要判断点积符号
+    kernel_.top_normal = right_top_dir.cross(left_top_dir);
+    kernel_.botton_normal = right_botton_dir.cross(left_botton_dir);
+    kernel_.left_normal = left_botton_dir.cross(left_top_dir);
+    kernel_.right_normal = right_botton_dir.cross(right_top_dir);
+
+    //近距长方体
+    kernel_.left_top_pos = apex + left_top_dir * near_radius;
+    kernel_.left_botton_pos = apex + left_botton_dir * near_radius;
+    kernel_.right_top_pos = apex + right_top_dir * near_radius;
+    kernel_.vertical_dir = botton_dir - top_dir;
+    kernel_.horizontal_dir = right_dir - left_dir;
+
+    //与朝向的夹角不超过半视角: cos >= cos(half), 两边平方后不需要开方和acos. 半视角超过90度时由cos<0的判定覆盖.
+    float half_fov = std::fmaxf(fov, fov * aspect) / 2.0f;
+    float cos_half = half_fov < 90.0f ? cosf(half_fov * PI_PER_ANGLE) : 0.0f;
+    kernel_.apex = apex;
+    kernel_.far_sq = far_radius * far_radius;
+    kernel_.near_sq = near_radius * near_radius;
+    kernel_.cos_half_sq = cos_half * cos_half;
+    far_radius_ = far_radius;
+    half_radian_ = (half_fov < 90.0f ? half_fov : 90.0f) * PI_PER_ANGLE;
+    return 0;
+}
+
 
-    //return 0;
-    //四楞体视锥
-    Point3 normal = right_top_dir.cross(left_top_dir);
-    float diff = normal.dot(target_dir);
-    u32 sign_bit = SignBitF(diff);
-    normal = right_botton_dir.cross(left_botton_dir);
-    diff = normal.dot(target_dir);
-    if (SignBitF(diff) == sign_bit)
+s32 AreaShapeFov::PointInRange(const Point3& pos, f32 radius, f32& dist_sq)
+{
+    return AreaKernelPointInRange(kernel_, pos, radius, dist_sq);
+}
+
+s32 AreaShapeFov::PointsInRange(const AreaPoints& points, u64* hit_bits, f32* dist_sq)
+{
+    return RunAreaKernel(kernel_, points, hit_bits, dist_sq);
+}
+
+void AreaShapeFov::BuildKernel(AreaFovKernel& kernel) const
+{
+    kernel = kernel_;
+}
+
+void AreaShapeFov::Bounds(AreaBounds& bounds) const
+{
+    //命中的目标都在以apex为球心的远距球和外接圆锥的交集内.
+    //对每个坐标轴方向, 与朝向夹角不超过半角时取到远距, 否则取圆锥边界上最靠近该轴的母线, 超过90度时只有apex
+    const Point3& apex = kernel_.apex;
+    const Point3& dir = kernel_.dir;
+    f32 extent[6];
+    const f32 cosine[6] = { dir.x, -dir.x, dir.y, -dir.y, dir.z, -dir.z };
+    for (u32 i = 0; i < 6; i++)
     {
-        return 15;
+        f32 angle = acosf(PRUNING(cosine[i], -1.0f, 1.0f)) - half_radian_;
+        extent[i] = angle <= 0.0f ? far_radius_ : (angle < PI * 0.5f ? far_radius_ * cosf(angle) : 0.0f);
     }
-    normal = left_botton_dir.cross(left_top_dir);
-    diff = normal.dot(target_dir);
-    sign_bit = SignBitF(diff);
-    normal = right_botton_dir.cross(right_top_dir);
-    diff = normal.dot(target_dir);
-    if (SignBitF(diff) == sign_bit)
+    bounds.min = Point3(apex.x - extent[1], apex.y - extent[3], apex.z - extent[5]);
+    bounds.max = Point3(apex.x + extent[0], apex.y + extent[2], apex.z + extent[4]);
+    AreaBoundsFit(bounds, apex, far_radius_);
+}
+
+
+
+
+
+
+
+s32 AreaShapeCapsule::Init(DeviationShape deviation, f32 radius)
+{
+    f32 length = deviation.pivot_scale.x;
+    f32 sweep_radius = deviation.pivot_scale.y;
+    if (length < 0.0f || sweep_radius < 0.0f)
+    {
+        LOGFMTE("config error. length:<%f>, radius:<%f>", length, sweep_radius);
+        return -2;
+    }
+    dir_ = Point3(deviation.pivot_dir.x, deviation.pivot_dir.y, 0.0f);
+    if (!dir_.normalize())
     {
-        return 17;
+        LOGFMTE("dir 2d normalize false");
+        return -4;
     }
+    anchor_ = deviation.pivot_pos;
+    anchor_radius_ = radius;
+    length_ = length;
+    sweep_radius_ = sweep_radius;
+    high_ = deviation.pivot_scale.z;
+    return 0;
+}
 
-    //近距
-    if (dist_check <= near_radius)
+s32 AreaShapeCapsule::PointInRange(const Point3& pos, f32 radius, f32& dist_sq)
+{
+    //高度差检测
+    float height_dist = fabsf(pos.z - anchor_.z);
+    if (height_dist > high_)
     {
-        return 0;
+        LOGFMTD("range capsule too high anchor z:<%f>, test z:<%f>, limit high:<%f>", anchor_.z, pos.z, high_);
+        return 1;
+    }
+
+    f32 dx = pos.x - anchor_.x;
+    f32 dy = pos.y - anchor_.y;
+    dist_sq = dx * dx + dy * dy;
+
+    //目标在线段上的投影截断到[0, length_]即为线段上的最近点
+    f32 project = dx * dir_.x + dy * dir_.y;
+    project = project < 0.0f ? 0.0f : project;
+    project = project > length_ ? length_ : project;
+    f32 off_x = dx - dir_.x * project;
+    f32 off_y = dy - dir_.y * project;
+    f32 range = sweep_radius_ + radius + anchor_radius_;
+    if (off_x * off_x + off_y * off_y > range * range)
+    {
+        LOGFMTD("range capsule too far project:<%f>", project);
+        return 2;
     }
+    return 0;
+}
+
+void AreaShapeCapsule::BuildKernel(AreaCapsuleKernel& kernel) const
+{
+    kernel.anchor = anchor_;
+    kernel.anchor_radius = anchor_radius_;
+    kernel.dir = dir_;
+    kernel.length = length_;
+    kernel.sweep_radius = sweep_radius_;
+    kernel.high = high_;
+}
+
+s32 AreaShapeCapsule::PointsInRange(const AreaPoints& points, u64* hit_bits, f32* dist_sq)
+{
+    AreaCapsuleKernel kernel;
+    BuildKernel(kernel);
+    return RunAreaKernel(kernel, points, hit_bits, dist_sq);
+}
+
+void AreaShapeCapsule::Bounds(AreaBounds& bounds) const
+{
+    f32 reach = sweep_radius_ + anchor_radius_;
+    f32 half_length = length_ * 0.5f;
+    bounds.min = Point3(anchor_.x - reach, anchor_.y - reach, anchor_.z - high_);
+    bounds.max = Point3(anchor_.x + reach, anchor_.y + reach, anchor_.z + high_);
+    AreaBoundsMerge(bounds, Point3(anchor_.x + dir_.x * length_, anchor_.y + dir_.y * length_, anchor_.z), reach);
+    bounds.center = Point3(anchor_.x + dir_.x * half_length, anchor_.y + dir_.y * half_length, anchor_.z);
+    bounds.radius = half_length + reach;
+}
 
-    Point3 right_top_pos = apex + right_top_dir * near_radius;
-    Point3 right_botton_pos = apex + right_botton_dir * near_radius;
-    Point3 left_botton_pos = apex + left_botton_dir * near_radius;
-    Point3 left_top_pos = apex + left_top_dir * near_radius;
 
-    //长方体远摄
-    diff = (check_pos - left_top_pos).dot(botton_dir - top_dir);
-    sign_bit = SignBitF(diff);
-    diff = (check_pos - left_botton_pos).dot(botton_dir - top_dir);
-    if (SignBitF(diff) == sign_bit)
+s32 AreaShapePolygon::Init(DeviationShape deviation, const Point3* vertexs, u32 count, f32 radius)
+{
+    if (count < 3 || count > AREA_POLYGON_MAX_VERTEX)
+    {
+        LOGFMTE("config error. vertex count:<%u>", count);
+        return -2;
+    }
+    Point3 dir = Point3(deviation.pivot_dir.x, deviation.pivot_dir.y, 0.0f);
+    if (!dir.normalize())
+    {
+        LOGFMTE("dir 2d normalize false");
+        return -4;
+    }
+    AreaPolygonKernel& k = kernel_;
+    k.anchor = deviation.pivot_pos;
+    k.anchor_radius = radius;
+    k.high = deviation.pivot_scale.z;
+    k.count = count;
+
+    //局部坐标转到朝向上 统一成逆时针
+    f32 area = 0.0f;
+    for (u32 i = 0; i < count; i++)
+    {
+        k.vertex_x[i] = dir.x * vertexs[i].x - dir.y * vertexs[i].y;
+        k.vertex_y[i] = dir.y * vertexs[i].x + dir.x * vertexs[i].y;
+    }
+    for (u32 i = 0; i < count; i++)
     {
-        return 20;
+        u32 next = (i + 1) % count;
+        area += k.vertex_x[i] * k.vertex_y[next] - k.vertex_x[next] * k.vertex_y[i];
+    }
+    if (fabsf(area) < FLOAT_POINT_PRECISION)
+    {
+        LOGFMTE("polygon degenerate. area:<%f>", area * 0.5f);
+        return -3;
+    }
+    if (area < 0.0f)
+    {
+        std::reverse(k.vertex_x, k.vertex_x + count);
+        std::reverse(k.vertex_y, k.vertex_y + count);
     }
 
-    diff = (check_pos - left_top_pos).dot(right_dir - left_dir);
-    sign_bit = SignBitF(diff);
-    diff = (check_pos - right_top_pos).dot(right_dir - left_dir);
-    if (SignBitF(diff) == sign_bit)
+    k.reach = radius;
+    for (u32 i = 0; i < count; i++)
     {
-        return 21;
+        u32 next = (i + 1) % count;
+        f32 edge_x = k.vertex_x[next] - k.vertex_x[i];
+        f32 edge_y = k.vertex_y[next] - k.vertex_y[i];
+        f32 length = sqrtf(edge_x * edge_x + edge_y * edge_y);
+        if (length < FLOAT_POINT_PRECISION)
+        {
+            LOGFMTE("polygon edge too short. edge:<%u>", i);
+            return -3;
+        }
+        k.normal_x[i] = edge_y / length;
+        k.normal_y[i] = -edge_x / length;
+        k.edge_length[i] = length;
+        f32 vertex_dist = sqrtf(k.vertex_x[i] * k.vertex_x[i] + k.vertex_y[i] * k.vertex_y[i]);
+        k.reach = vertex_dist > k.reach ? vertex_dist : k.reach;
     }
 
+    //所有顶点都在每条边的内侧才是凸多边形
+    for (u32 i = 0; i < count; i++)
+    {
+        for (u32 j = 0; j < count; j++)
+        {
+            f32 side = (k.vertex_x[j] - k.vertex_x[i]) * k.normal_x[i] + (k.vertex_y[j] - k.vertex_y[i]) * k.normal_y[i];
+            if (side > FLOAT_POINT_PRECISION)
+            {
+                LOGFMTE("polygon not convex. edge:<%u>, vertex:<%u>", i, j);
+                return -3;
+            }
+        }
+    }
     return 0;
 }
 
+s32 AreaShapePolygon::PointInRange(const Point3& pos, f32 radius, f32& dist_sq)
+{
+    return AreaKernelPointInRange(kernel_, pos, radius, dist_sq);
+}
+
+s32 AreaShapePolygon::PointsInRange(const AreaPoints& points, u64* hit_bits, f32* dist_sq)
+{
+    return RunAreaKernel(kernel_, points, hit_bits, dist_sq);
+}
+
+void AreaShapePolygon::BuildKernel(AreaPolygonKernel& kernel) const
+{
+    kernel = kernel_;
+}
+
+void AreaShapePolygon::Bounds(AreaBounds& bounds) const
+{
+    const AreaPolygonKernel& k = kernel_;
+    bounds.min = Point3(k.anchor.x, k.anchor.y, k.anchor.z - k.high);
+    bounds.max = Point3(k.anchor.x, k.anchor.y, k.anchor.z + k.high);
+    for (u32 i = 0; i < k.count; i++)
+    {
+        AreaBoundsMerge(bounds, Point3(k.anchor.x + k.vertex_x[i], k.anchor.y + k.vertex_y[i], k.anchor.z), 0.0f);
+    }
+    //目标与定位点重合时总是命中
+    f32 collide = std::max(k.anchor_radius, sqrtf(FLOAT_POINT_PRECISION));
+    AreaBoundsMerge(bounds, k.anchor, collide);
+    AreaBoundsFit(bounds, k.anchor, std::max(k.reach, collide));
+}
+
 
 
 
@@ -507,7 +829,9 @@ s32 AreaShapeFov::PointInRange(const Point3& pos, f32 radius, f32& dist_sq)
 
 AreaShape::AreaShape()
 {
-    shape_type_ = -1;
+    shape_type_ = AREA_SHAPE_NONE;
+    bounds_ = AreaBounds();
+    anchor_ = Point3(0.0f, 0.0f, 0.0f);
 }
 
 s32 AreaShape::Init(u32 shape_type, DeviationShape deviation, f32 radius)
@@ -518,7 +842,7 @@ s32 AreaShape::Init(u32 shape_type, DeviationShape deviation, f32 radius)
         shape_type, radius, deviation.pivot_pos.x, deviation.pivot_pos.y, deviation.pivot_pos.z,
         deviation.pivot_dir.x, deviation.pivot_dir.y, deviation.pivot_dir.z, 
         deviation.pivot_scale.x, deviation.pivot_scale.y, deviation.pivot_scale.z);
-    if (-1 != shape_type_)
+    if (AREA_SHAPE_NONE != shape_type_)
     {
         LOGFMTE("range init conflict: shape_type old:<%u>, now:<%u>", shape_type_, shape_type);
         return -1;
@@ -552,7 +876,29 @@ s32 AreaShape::Init(u32 shape_type, DeviationShape deviation, f32 radius)
     case AREA_SHAPE_FOV:
         ret = fov_.Init(deviation, radius);
         break;
-    default:
+    case AREA_SHAPE_CAPSULE:
+        ret = capsule_.Init(deviation, radius);
+        break;
+    case AREA_SHAPE_POLYGON:
+    {
+        //正多边形 第一个顶点在朝向上, 逆时针排列. 边数先按浮点检查范围再取整, NaN和超出u32的值在这里拦下
+        f32 sides = deviation.pivot_scale.x + 0.5f;
+        if (!(sides >= 3.0f && sides < AREA_POLYGON_MAX_VERTEX + 1.0f))
+        {
+            LOGFMTE("range init polygon param error. pivot_scale.x:<%f>", deviation.pivot_scale.x);
+            return -2;
+        }
+        u32 count = (u32)sides;
+        Point3 vertexs[AREA_POLYGON_MAX_VERTEX];
+        for (u32 i = 0; i < count; i++)
+        {
+            f32 angle = PI2 * i / count;
+            vertexs[i] = Point3(cosf(angle) * deviation.pivot_scale.y, sinf(angle) * deviation.pivot_scale.y, 0.0f);
+        }
+        ret = polygon_.Init(deviation, vertexs, count, radius);
+        break;
+    }
+    default:
         LOGFMTE("unknown range shape_type:<%u>", shape_type);
         return -5;
     }
@@ -561,14 +907,64 @@ s32 AreaShape::Init(u32 shape_type, DeviationShape deviation, f32 radius)
         LOGFMTE("range init shape error:<%d>, shape_type:<%u>", ret, shape_type);
         return ret;
     }
+    switch (shape_type)
+    {
+    case AREA_SHAPE_CIRCLE:
+    case AREA_SHAPE_RING:
+        circle_.Bounds(bounds_);
+        break;
+    case AREA_SHAPE_FAN:
+        fan_.Bounds(bounds_);
+        break;
+    case AREA_SHAPE_RECT:
+    case AREA_SHAPE_FRAME:
+        rect_.Bounds(bounds_);
+        break;
+    case AREA_SHAPE_CAPSULE:
+        capsule_.Bounds(bounds_);
+        break;
+    case AREA_SHAPE_POLYGON:
+        polygon_.Bounds(bounds_);
+        break;
+    default:
+        fov_.Bounds(bounds_);
+        break;
+    }
+    anchor_ = deviation.pivot_pos;
     shape_type_ = shape_type;
     return 0;
 }
 
+s32 AreaShape::InitPolygon(DeviationShape deviation, const Point3* vertexs, u32 count, f32 radius)
+{
+    deviation.pivot_dir.z = 0;
+    if (AREA_SHAPE_NONE != shape_type_)
+    {
+        LOGFMTE("range init conflict: shape_type old:<%u>, now:<%u>", shape_type_, (u32)AREA_SHAPE_POLYGON);
+        return -1;
+    }
+    if (vertexs == NULL || deviation.pivot_dir.is_zero())
+    {
+        LOGFMTE("range init polygon param error. count:<%u>, deviation.pivot_dir:<%f,%f,%f>",
+            count, deviation.pivot_dir.x, deviation.pivot_dir.y, deviation.pivot_dir.z);
+        return -2;
+    }
+    s32 ret = polygon_.Init(deviation, vertexs, count, radius);
+    if (ret != 0)
+    {
+        LOGFMTE("range init polygon error:<%d>, count:<%u>", ret, count);
+        return ret;
+    }
+    polygon_.Bounds(bounds_);
+    anchor_ = deviation.pivot_pos;
+    shape_type_ = AREA_SHAPE_POLYGON;
+    return 0;
+}
+
 s32 AreaShape::PointInRange(const Point3& pos, f32 radius, f32& dist_sq)
 {
     s32 ret = 0;
-    if (-1 == shape_type_)
+    if (AREA_SHAPE_NONE == shape_type_)
     {
         LOGFMTE("point in range test error. not init.");
         return -1;
@@ -594,7 +990,13 @@ s32 AreaShape::PointInRange(const Point3& pos, f32 radius, f32& dist_sq)
     case AREA_SHAPE_FOV:
         ret = fov_.PointInRange(pos, radius, dist_sq);
         break;
-    default:
+    case AREA_SHAPE_CAPSULE:
+        ret = capsule_.PointInRange(pos, radius, dist_sq);
+        break;
+    case AREA_SHAPE_POLYGON:
+        ret = polygon_.PointInRange(pos, radius, dist_sq);
+        break;
+    default:
         LOGFMTE("point in range test error. range not init. pos:<%f,%f,%f>, radius:<%f>, ret:<%d>, shape_type_:<%u>", 
             pos.x, pos.y, pos.z, radius, ret, shape_type_);
         return -4;
@@ -606,12 +1008,258 @@ s32 AreaShape::PointInRange(const Point3& pos, f32 radius, f32& dist_sq)
         return ret;
     }
 
+    AoeStatRecord(shape_type_, ret);
     return ret;
 }
 
+s32 AreaShape::PointsInRange(const AreaPoints& points, u64* hit_bits, f32* dist_sq)
+{
+    if (AREA_SHAPE_NONE == shape_type_)
+    {
+        LOGFMTE("points in range test error. not init.");
+        return -1;
+    }
+    if (hit_bits == NULL || (points.count > 0 && (points.x == NULL || points.y == NULL || points.z == NULL)))
+    {
+        LOGFMTE("points in range test error. param null. count:<%u>, shape_type_:<%u>", points.count, shape_type_);
+        return -2;
+    }
+
+    s32 ret = 0;
+    switch (shape_type_)
+    {
+    case AREA_SHAPE_CIRCLE:
+    case AREA_SHAPE_RING:
+        ret = circle_.PointsInRange(points, hit_bits, dist_sq);
+        break;
+    case AREA_SHAPE_FAN:
+        ret = fan_.PointsInRange(points, hit_bits, dist_sq);
+        break;
+    case AREA_SHAPE_RECT:
+    case AREA_SHAPE_FRAME:
+        ret = rect_.PointsInRange(points, hit_bits, dist_sq);
+        break;
+    case AREA_SHAPE_FOV:
+        ret = fov_.PointsInRange(points, hit_bits, dist_sq);
+        break;
+    case AREA_SHAPE_CAPSULE:
+        ret = capsule_.PointsInRange(points, hit_bits, dist_sq);
+        break;
+    case AREA_SHAPE_POLYGON:
+        ret = polygon_.PointsInRange(points, hit_bits, dist_sq);
+        break;
+    default:
+        LOGFMTE("points in range test error. range not init. count:<%u>, shape_type_:<%u>", points.count, shape_type_);
+        return -4;
+    }
+#if AOE_STAT_ENABLE
+    if (ret >= 0 && AoeStatEnabled())
+    {
+        //批量检测只给出命中位, 未命中的目标逐个补测, 由PointInRange记录未通过的阶段
+        AoeStatRecordHits(shape_type_, (u32)ret);
+        for (u32 i = 0; i < points.count; i++)
+        {
+            if (!AreaHitTest(hit_bits, i))
+            {
+                f32 miss_dist_sq = 0.0f;
+                PointInRange(Point3(points.x[i], points.y[i], points.z[i]), points.radius != NULL ? points.radius[i] : 0.0f, miss_dist_sq);
+            }
+        }
+    }
+#endif
+    return ret;
+}
+
+//按(dist_sq, 下标)比较 堆顶为当前第k近
+static bool AreaNearestLess(const AreaNearest& a, const AreaNearest& b)
+{
+    return a.dist_sq < b.dist_sq || (a.dist_sq == b.dist_sq && a.index < b.index);
+}
+
+s32 AreaShape::NearestInRange(const AreaPoints& points, u32 k, std::vector<AreaNearest>& nearest)
+{
+    nearest.clear();
+    if (AREA_SHAPE_NONE == shape_type_)
+    {
+        LOGFMTE("nearest in range error. not init.");
+        return -1;
+    }
+    if (points.count > 0 && (points.x == NULL || points.y == NULL || points.z == NULL))
+    {
+        LOGFMTE("nearest in range error. param null. count:<%u>, shape_type_:<%u>", points.count, shape_type_);
+        return -2;
+    }
+    if (k == 0)
+    {
+        return 0;
+    }
+
+    //目标按下标顺序扫描, 距离相同的后来者不会比堆中的更优, 所以筛选和替换都用严格小于
+    AreaNearerKernel nearer;
+    nearer.origin = anchor_;
+    nearer.use_z = shape_type_ == AREA_SHAPE_FOV;
+    nearer.limit_sq = 0.0f;
+    //筛选通过的目标先攒起来, 凑够一块再做形状检测, 避免每块只有零星几个目标时反复进入检测
+    f32 xs[AREA_NEAREST_BLOCK * 2];
+    f32 ys[AREA_NEAREST_BLOCK * 2];
+    f32 zs[AREA_NEAREST_BLOCK * 2];
+    f32 radius[AREA_NEAREST_BLOCK * 2];
+    u32 index[AREA_NEAREST_BLOCK * 2];
+    f32 dist_sq[AREA_NEAREST_BLOCK * 2];
+    u64 hit_bits[AREA_NEAREST_BLOCK * 2 / 64];
+    u32 count = 0;
+    for (u32 begin = 0; begin < points.count; begin += AREA_NEAREST_BLOCK)
+    {
+        u32 end = begin + AREA_NEAREST_BLOCK < points.count ? begin + AREA_NEAREST_BLOCK : points.count;
+        u64 pass = ~0ull >> (AREA_NEAREST_BLOCK - (end - begin));
+        if (nearest.size() == k)
+        {
+            //堆满之后绝大多数目标在这里跳过
+            nearer.limit_sq = nearest.front().dist_sq;
+            AreaPoints span = { points.x + begin, points.y + begin, points.z + begin, NULL, end - begin };
+            if (RunAreaKernel(nearer, span, &pass, NULL) == 0)
+            {
+                pass = 0;
+            }
+        }
+        while (pass != 0)
+        {
+            u32 bit = 0;
+            while (((pass >> bit) & 1u) == 0)
+            {
+                bit++;
+            }
+            pass &= pass - 1;
+            u32 i = begin + bit;
+            xs[count] = points.x[i];
+            ys[count] = points.y[i];
+            zs[count] = points.z[i];
+            radius[count] = points.radius != NULL ? points.radius[i] : 0.0f;
+            index[count] = i;
+            count++;
+        }
+        if (count == 0 || (count < AREA_NEAREST_BLOCK && nearest.size() == k && end < points.count))
+        {
+            continue;
+        }
+
+        AreaPoints block = { xs, ys, zs, points.radius != NULL ? radius : NULL, count };
+        s32 ret = PointsInRange(block, hit_bits, dist_sq);
+        if (ret < 0)
+        {
+            return ret;
+        }
+        for (u32 i = 0; i < count && ret > 0; i++)
+        {
+            if (!AreaHitTest(hit_bits, i))
+            {
+                continue;
+            }
+            if (nearest.size() < k)
+            {
+                nearest.push_back({ index[i], dist_sq[i] });
+                std::push_heap(nearest.begin(), nearest.end(), AreaNearestLess);
+                continue;
+            }
+            if (dist_sq[i] < nearest.front().dist_sq)
+            {
+                std::pop_heap(nearest.begin(), nearest.end(), AreaNearestLess);
+                nearest.back() = { index[i], dist_sq[i] };
+                std::push_heap(nearest.begin(), nearest.end(), AreaNearestLess);
+            }
+        }
+        count = 0;
+    }
+    std::sort_heap(nearest.begin(), nearest.end(), AreaNearestLess);
+    return (s32)nearest.size();
+}
+
+s32 AreaShape::Bounds(AreaBounds& bounds) const
+{
+    if (AREA_SHAPE_NONE == shape_type_)
+    {
+        LOGFMTE("bounds error. range not init.");
+        return -1;
+    }
+    bounds = bounds_;
+    return 0;
+}
+
+s32 AreaShape::BoundingCircle(Point3& center, f32& radius) const
+{
+    if (AREA_SHAPE_NONE == shape_type_)
+    {
+        LOGFMTE("bounding circle error. range not init.");
+        return -1;
+    }
+    center = bounds_.center;
+    radius = bounds_.radius;
+    return 0;
+}
+
+s32 AreaShape::BuildKernel(AreaCircleKernel& kernel) const
+{
+    if (shape_type_ != AREA_SHAPE_CIRCLE && shape_type_ != AREA_SHAPE_RING)
+    {
+        return -1;
+    }
+    circle_.BuildKernel(kernel);
+    return 0;
+}
+
+s32 AreaShape::BuildKernel(AreaFanKernel& kernel) const
+{
+    if (shape_type_ != AREA_SHAPE_FAN)
+    {
+        return -1;
+    }
+    fan_.BuildKernel(kernel);
+    return 0;
+}
+
+s32 AreaShape::BuildKernel(AreaRectKernel& kernel) const
+{
+    if (shape_type_ != AREA_SHAPE_RECT && shape_type_ != AREA_SHAPE_FRAME)
+    {
+        return -1;
+    }
+    rect_.BuildKernel(kernel);
+    return 0;
+}
+
+s32 AreaShape::BuildKernel(AreaFovKernel& kernel) const
+{
+    if (shape_type_ != AREA_SHAPE_FOV)
+    {
+        return -1;
+    }
+    fov_.BuildKernel(kernel);
+    return 0;
+}
+
+s32 AreaShape::BuildKernel(AreaCapsuleKernel& kernel) const
+{
+    if (shape_type_ != AREA_SHAPE_CAPSULE)
+    {
+        return -1;
+    }
+    capsule_.BuildKernel(kernel);
+    return 0;
+}
+
+s32 AreaShape::BuildKernel(AreaPolygonKernel& kernel) const
+{
+    if (shape_type_ != AREA_SHAPE_POLYGON)
+    {
+        return -1;
+    }
+    polygon_.BuildKernel(kernel);
+    return 0;
+}
+
+
 
 
 
-
 
 
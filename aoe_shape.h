@@ -21,6 +21,7 @@
 
 #include "aoe_common.h"
 #include "vector3.h"
+#include "aoe_kernel.h"
 #include <array>
 
 using Point3 = Vector3<float>;
@@ -31,10 +32,28 @@ struct DeviationShape
     Point3 pivot_pos;   //轴点坐标, 三组数据用来查看服务器选定目标的区域形状参数, 配置无效的情况下这三组数据同样无效.
     Point3 pivot_dir;   //朝向.
     Point3 pivot_offset; //上, 右
-    Point3 pivot_scale; //长宽高,弧度半径高, 内径外径高
+    Point3 pivot_scale; //长宽高,弧度半径高, 内径外径高, 胶囊长度半径高, 正多边形边数半径高
     Point3 pivot_ext;   //扩展
 };
 
+//形状的包围体, 包含定位点半径, 不含目标半径. 目标在包围体外(按目标半径扩展后)一定不会命中.
+struct AreaBounds
+{
+    Point3 min; //轴对齐包围盒 z为高度范围
+    Point3 max;
+    Point3 center; //二维包围圆
+    f32 radius;
+};
+
+//NearestInRange的结果
+struct AreaNearest
+{
+    u32 index; //points中的下标
+    f32 dist_sq;
+};
+
+const u32 AREA_NEAREST_BLOCK = 64; //每次按当前第K近的距离筛选的目标数 通过的目标凑够一块再做形状检测
+
 enum AreaShapeType
 {
     AREA_SHAPE_CIRCLE = 0,
@@ -43,18 +62,24 @@ enum AreaShapeType
     AREA_SHAPE_RING = 3,
     AREA_SHAPE_FRAME = 4,
     AREA_SHAPE_FOV = 5,
+    AREA_SHAPE_CAPSULE = 6,
+    AREA_SHAPE_POLYGON = 7,
 };
+const u32 AREA_SHAPE_NONE = (u32)-1; //未初始化的shape_type_
 
 class AreaShapeRect
 {
 public:
-    static const std::size_t VERTEX_SIZE = 4;
     s32 Init(DeviationShape deviation, f32 radius, bool collide_test, bool frame_test);
     s32 PointInRange(const Point3& pos, f32 radius, f32 & dist_sq);
+    s32 PointsInRange(const AreaPoints& points, u64* hit_bits, f32* dist_sq);
+    void BuildKernel(AreaRectKernel& kernel) const;
+    void Bounds(AreaBounds& bounds) const;
 private:
-    std::array<Point3, VERTEX_SIZE> vertexs_; //凸多边形的多有顶点
-    std::array<f32, VERTEX_SIZE> line_inv_length_; //凸多边形顶点组成的每个边长的倒数
-    std::array<Point3, VERTEX_SIZE> lines_; //凸多边形顶点组成的每个边长的倒数
+    Point3 center_; //矩形中心
+    Point3 dir_; //长边方向(二维单位向量)
+    f32 half_length_; //沿dir_的半长
+    f32 half_wide_; //垂直dir_的半宽
     Point3 anchor_; //定位点
     f32 anchor_radius_; //定位点半径
     f32 distance_;
@@ -68,15 +93,23 @@ class AreaShapeFan
 public:
     s32 Init(DeviationShape deviation, f32 radius);
     s32 PointInRange(const Point3& pos, f32 radius, f32 & dist_sq);
+    s32 PointsInRange(const AreaPoints& points, u64* hit_bits, f32* dist_sq);
+    void BuildKernel(AreaFanKernel& kernel) const;
+    void Bounds(AreaBounds& bounds) const;
 private:
     Point3 anchor_; //定位点
     f32 anchor_radius_; //定位点半径
     bool is_circle_; //是否是圆
     Point3 normalize_dir_; //朝向
     f32 radian_; //弧度 (half)
-    f32 radian_domain_; //余弦值域 (half)
     f32 radian_radius_; //扇形半径
     f32 high_;
+    bool is_wide_; //半角超过90度 扇形不再是凸的
+    f32 edge_length_; //两条边的长度 扇形半径加定位点半径
+    Point3 left_dir_; //左右两条边的方向
+    Point3 right_dir_;
+    Point3 left_normal_; //左右两条边朝外的法线
+    Point3 right_normal_;
 };
 
 class AreaShapeCircle
@@ -85,6 +118,9 @@ public:
     //param2为大圆半径, param1为挖空的小圆半径 小圆大小可以为0
     s32 Init(DeviationShape deviation, f32 radius);
     s32 PointInRange(const Point3& pos, f32 radius, f32 & dist_sq);
+    s32 PointsInRange(const AreaPoints& points, u64* hit_bits, f32* dist_sq);
+    void BuildKernel(AreaCircleKernel& kernel) const;
+    void Bounds(AreaBounds& bounds) const;
 private:
     Point3 anchor_; //定位点
     f32 anchor_radius_; //定位点半径
@@ -100,8 +136,45 @@ public:
     //param2为大圆半径, param1为挖空的小圆半径 小圆大小可以为0
     s32 Init(DeviationShape deviation, f32 radius);
     s32 PointInRange(const Point3& pos, f32 radius, f32& dist_sq);
+    s32 PointsInRange(const AreaPoints& points, u64* hit_bits, f32* dist_sq);
+    void BuildKernel(AreaFovKernel& kernel) const;
+    void Bounds(AreaBounds& bounds) const;
+private:
+    AreaFovKernel kernel_; //朝向修正/视锥平面在Init时算好, 检测时只做点积
+    f32 far_radius_;
+    f32 half_radian_; //视锥外接圆锥的半角 不超过90度
+};
+
+//胶囊体: 圆沿朝向扫过一段距离(冲锋, 投射物轨迹等). param1为扫过的长度 可以为0, param2为圆的半径
+class AreaShapeCapsule
+{
+public:
+    s32 Init(DeviationShape deviation, f32 radius);
+    s32 PointInRange(const Point3& pos, f32 radius, f32& dist_sq);
+    s32 PointsInRange(const AreaPoints& points, u64* hit_bits, f32* dist_sq);
+    void BuildKernel(AreaCapsuleKernel& kernel) const;
+    void Bounds(AreaBounds& bounds) const;
+private:
+    Point3 anchor_; //定位点 线段起点
+    f32 anchor_radius_; //定位点半径
+    Point3 dir_; //线段方向(二维单位向量)
+    f32 length_; //线段长度
+    f32 sweep_radius_; //扫过的圆的半径
+    f32 high_;
+};
+
+//凸多边形(梯形, 六边形等). 顶点为局部坐标: x沿朝向, y为朝向的左侧, 原点为定位点. 顺时针或逆时针均可
+class AreaShapePolygon
+{
+public:
+    s32 Init(DeviationShape deviation, const Point3* vertexs, u32 count, f32 radius);
+    s32 PointInRange(const Point3& pos, f32 radius, f32& dist_sq);
+    s32 PointsInRange(const AreaPoints& points, u64* hit_bits, f32* dist_sq);
+    void BuildKernel(AreaPolygonKernel& kernel) const;
+    void Bounds(AreaBounds& bounds) const;
 private:
-    DeviationShape shape;
+    //顶点转到世界朝向并算好各边法线, 检测时只做点积. 顶点表定长内嵌, 复制AreaShape时不涉及堆分配
+    AreaPolygonKernel kernel_;
 };
 
 
@@ -111,9 +184,30 @@ class AreaShape
 public:
     AreaShape();
     ~AreaShape() {}
+    //AREA_SHAPE_POLYGON按正多边形初始化: param1为边数, param2为外接圆半径, 第一个顶点在朝向上
     s32 Init(u32 shape_type, DeviationShape deviation, f32 radius);
+    //任意凸多边形 顶点个数3到AREA_POLYGON_MAX_VERTEX, 坐标含义见AreaShapePolygon. 高度取deviation.pivot_scale.z
+    s32 InitPolygon(DeviationShape deviation, const Point3* vertexs, u32 count, f32 radius);
     s32 PointInRange(const Point3& pos, f32 radius, f32& dist_sq);
+    //批量检测 points为SoA形式的目标数组, 命中结果写入hit_bits(至少AreaHitWords(points.count)个).
+    //dist_sq可以为NULL. 结果与逐个调用PointInRange一致. 返回命中个数, 负数为错误.
+    s32 PointsInRange(const AreaPoints& points, u64* hit_bits, f32* dist_sq);
+    //命中目标中dist_sq最小的k个, 按(dist_sq, 下标)从小到大写入nearest. 返回个数, 负数为错误.
+    //维护大小为k的最大堆, dist_sq不小于当前第k近的目标不再做形状检测. 结果与全部检测后排序取前k个一致.
+    s32 NearestInRange(const AreaPoints& points, u32 k, std::vector<AreaNearest>& nearest);
+    //包围体在Init时按形状类型算好, 供网格/树等粗筛使用.
+    s32 Bounds(AreaBounds& bounds) const;
+    //二维包围圆(含定位点半径, 不含目标半径). 目标与圆心的距离超过radius加目标半径时一定不会命中.
+    s32 BoundingCircle(Point3& center, f32& radius) const;
+    //导出检测参数, 供已知形状类型的调用方使用特化的检测(见aoe_shape_t.h). 类型不匹配时返回非0
+    s32 BuildKernel(AreaCircleKernel& kernel) const;
+    s32 BuildKernel(AreaFanKernel& kernel) const;
+    s32 BuildKernel(AreaRectKernel& kernel) const;
+    s32 BuildKernel(AreaFovKernel& kernel) const;
+    s32 BuildKernel(AreaCapsuleKernel& kernel) const;
+    s32 BuildKernel(AreaPolygonKernel& kernel) const;
     u32 shape_type() const { return shape_type_; }
+    const Point3& anchor() const { return anchor_; }
 private:
     union
     {
@@ -121,9 +215,14 @@ private:
         AreaShapeCircle circle_;
         AreaShapeRect rect_;
         AreaShapeFov fov_;
+        AreaShapeCapsule capsule_;
+        AreaShapePolygon polygon_; //union的大小由多边形顶点表决定 整个AreaShape约404字节
     };
     u32 shape_type_;
+    AreaBounds bounds_;
+    Point3 anchor_; //dist_sq的原点 视锥为三维距离, 其余形状为二维距离
 };
+static_assert(sizeof(AreaShape) <= 404, "polygon vertex table grew, AreaShape copies get bigger");
 
 
 #endif // 
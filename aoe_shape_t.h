@@ -0,0 +1,430 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+#ifndef AOE_SHAPE_T_H
+#define AOE_SHAPE_T_H
+
+#include "aoe_shape.h"
+
+//编译期特化的形状检测.
+//AreaShape在Init和PointInRange中按shape_type_分支, 各形状内部还要判断collide_test_/frame_test_/目标半径是否为0.
+//已知形状类型的调用方可以使用AreaShapeT<Type, ZeroRadius, Frame>, 这些判断在编译期确定, 单点检测不含分支.
+//  Type: AreaShapeType
+//  ZeroRadius: 目标半径总是0, 省掉所有与目标半径相关的计算
+//  Frame: 矩形是否做边框检测, 默认由Type决定(AREA_SHAPE_FRAME)
+//检测结果与AreaShape::PointInRange的命中结果一致. PointInRange只返回0(命中)或1(未命中).
+
+template<u32 Type, bool ZeroRadius = false, bool Frame = (Type == AREA_SHAPE_FRAME)>
+class AreaShapeT;
+
+
+template<class Engine, class Kernel, u32 Type, bool ZeroRadius>
+class AreaShapeTBase
+{
+public:
+    static const u32 SHAPE_TYPE = Type;
+    static const bool ZERO_RADIUS = ZeroRadius;
+
+    //初始化流程与AreaShape::Init相同
+    s32 Init(DeviationShape deviation, f32 radius)
+    {
+        AreaShape shape;
+        s32 ret = shape.Init(Type, deviation, radius);
+        if (ret != 0)
+        {
+            return ret;
+        }
+        return Load(shape);
+    }
+
+    //从已初始化的AreaShape取参数
+    s32 Load(const AreaShape& shape)
+    {
+        if (shape.shape_type() != Type)
+        {
+            LOGFMTE("area shape t load error. shape_type:<%u>, expect:<%u>", shape.shape_type(), Type);
+            return -1;
+        }
+        shape.BuildKernel(kernel_);
+        static_cast<Engine*>(this)->Prepare();
+        return 0;
+    }
+
+    s32 PointInRange(const Point3& pos, f32 radius, f32& dist_sq) const
+    {
+        return static_cast<const Engine*>(this)->Test(pos.x, pos.y, pos.z, ZeroRadius ? 0.0f : radius, dist_sq) ? 0 : 1;
+    }
+
+    //访问者形式的批量入口 对每个命中的目标调用visitor(index, dist_sq), 返回命中个数.
+    //检测循环只做无分支的压缩写入, 每凑满一批再回调.
+    template<class Visitor>
+    s32 VisitInRange(const AreaPoints& points, Visitor&& visitor) const
+    {
+        if (!ZeroRadius && points.radius == NULL && points.count > 0)
+        {
+            LOGFMTE("area shape t visit error. radius null. shape_type:<%u>", Type);
+            return -1;
+        }
+        const Engine& engine = *static_cast<const Engine*>(this);
+        const u32 BATCH_SIZE = 64;
+        u32 index[BATCH_SIZE];
+        f32 dist[BATCH_SIZE];
+        s32 hits = 0;
+        for (u32 begin = 0; begin < points.count; begin += BATCH_SIZE)
+        {
+            u32 end = begin + BATCH_SIZE < points.count ? begin + BATCH_SIZE : points.count;
+            u32 count = 0;
+            for (u32 i = begin; i < end; i++)
+            {
+                f32 dist_sq = 0.0f;
+                bool hit = engine.Test(points.x[i], points.y[i], points.z[i], ZeroRadius ? 0.0f : points.radius[i], dist_sq);
+                index[count] = i;
+                dist[count] = dist_sq;
+                count += hit ? 1 : 0;
+            }
+            for (u32 i = 0; i < count; i++)
+            {
+                visitor(index[i], dist[i]);
+            }
+            hits += (s32)count;
+        }
+        return hits;
+    }
+
+    const Kernel& kernel() const { return kernel_; }
+protected:
+    Kernel kernel_;
+};
+
+
+template<u32 Type, bool ZeroRadius>
+class AreaShapeCircleT : public AreaShapeTBase<AreaShapeCircleT<Type, ZeroRadius>, AreaCircleKernel, Type, ZeroRadius>
+{
+public:
+    void Prepare()
+    {
+        const AreaCircleKernel& k = this->kernel_;
+        f32 reach = k.max_radius + 0.0f + k.anchor_radius;
+        reach_sq_ = reach * reach;
+        ring_sq_ = (Type == AREA_SHAPE_RING && k.min_radius_sq >= FLOAT_POINT_PRECISION) ? k.min_radius_sq : -1.0f;
+    }
+
+    inline bool Test(f32 x, f32 y, f32 z, f32 radius, f32& dist_sq) const
+    {
+        const AreaCircleKernel& k = this->kernel_;
+        f32 dx = x - k.anchor.x;
+        f32 dy = y - k.anchor.y;
+        dist_sq = dx * dx + dy * dy;
+        f32 range = k.max_radius + radius + k.anchor_radius;
+        f32 range_sq = ZeroRadius ? reach_sq_ : range * range;
+        bool hit = !(fabsf(z - k.anchor.z) > k.high) & !(dist_sq > range_sq);
+        if (Type == AREA_SHAPE_RING)
+        {
+            hit = hit & !(dist_sq < ring_sq_);
+        }
+        return hit;
+    }
+private:
+    f32 reach_sq_;
+    f32 ring_sq_;
+};
+
+
+template<bool ZeroRadius>
+class AreaShapeFanT : public AreaShapeTBase<AreaShapeFanT<ZeroRadius>, AreaFanKernel, AREA_SHAPE_FAN, ZeroRadius>
+{
+public:
+    void Prepare()
+    {
+        const AreaFanKernel& k = this->kernel_;
+        f32 reach = k.radian_radius + 0.0f + k.anchor_radius;
+        reach_sq_ = reach * reach;
+        anchor_sq_ = k.anchor_radius * k.anchor_radius;
+    }
+
+    inline bool Test(f32 x, f32 y, f32 z, f32 radius, f32& dist_sq) const
+    {
+        const AreaFanKernel& k = this->kernel_;
+        f32 dx = x - k.anchor.x;
+        f32 dy = y - k.anchor.y;
+        dist_sq = dx * dx + dy * dy;
+        f32 range = k.radian_radius + radius + k.anchor_radius;
+        f32 both = radius + k.anchor_radius;
+        f32 range_sq = ZeroRadius ? reach_sq_ : range * range;
+        f32 both_sq = ZeroRadius ? anchor_sq_ : both * both;
+        bool hit = !(fabsf(z - k.anchor.z) > k.high) & !(dist_sq > range_sq);
+        if (k.is_circle)
+        {
+            return hit;
+        }
+        f32 left = dx * k.left_normal.x + dy * k.left_normal.y;
+        f32 right = dx * k.right_normal.x + dy * k.right_normal.y;
+        bool in_radian = k.is_wide ? ((left <= 0.0f) | (right <= 0.0f)) : ((left <= 0.0f) & (right <= 0.0f));
+        bool accept = (dist_sq < FLOAT_POINT_PRECISION) | (dist_sq <= both_sq) | in_radian;
+        if (!ZeroRadius)
+        {
+            bool is_left = k.normalize_dir.x * dy - k.normalize_dir.y * dx >= 0.0f;
+            f32 edge_x = is_left ? k.left_dir.x : k.right_dir.x;
+            f32 edge_y = is_left ? k.left_dir.y : k.right_dir.y;
+            f32 edge_dist = is_left ? left : right;
+            f32 project = dx * edge_x + dy * edge_y;
+            f32 radius_sq = radius * radius;
+            f32 end_x = dx - edge_x * k.edge_length;
+            f32 end_y = dy - edge_y * k.edge_length;
+            bool on_edge = (project < k.edge_length) & (edge_dist * edge_dist <= radius_sq);
+            bool on_end = !(project < k.edge_length) & (end_x * end_x + end_y * end_y <= radius_sq);
+            accept = accept | (!(radius < FLOAT_POINT_PRECISION) & (project > 0.0f) & (on_edge | on_end));
+        }
+        return hit & accept;
+    }
+private:
+    f32 reach_sq_;
+    f32 anchor_sq_;
+};
+
+
+template<u32 Type, bool ZeroRadius, bool Frame>
+class AreaShapeRectT : public AreaShapeTBase<AreaShapeRectT<Type, ZeroRadius, Frame>, AreaRectKernel, Type, ZeroRadius>
+{
+public:
+    void Prepare()
+    {
+        const AreaRectKernel& k = this->kernel_;
+        f32 reach = k.distance + 0.0f + k.anchor_radius;
+        reach_sq_ = reach * reach;
+        anchor_sq_ = k.anchor_radius * k.anchor_radius;
+    }
+
+    //AreaShape中矩形和边框都开启了collide_test
+    inline bool Test(f32 x, f32 y, f32 z, f32 radius, f32& dist_sq) const
+    {
+        const AreaRectKernel& k = this->kernel_;
+        f32 dx = x - k.anchor.x;
+        f32 dy = y - k.anchor.y;
+        dist_sq = dx * dx + dy * dy;
+        f32 range = k.distance + radius + k.anchor_radius;
+        f32 both = radius + k.anchor_radius;
+        f32 range_sq = ZeroRadius ? reach_sq_ : range * range;
+        f32 both_sq = ZeroRadius ? anchor_sq_ : both * both;
+        bool in_high = !(fabsf(z - k.anchor.z) > k.high);
+        bool overlap = (dist_sq < FLOAT_POINT_PRECISION) | (!(dist_sq > range_sq) & (dist_sq < both_sq));
+        bool far = dist_sq > range_sq;
+
+        f32 local_x = x - k.center.x;
+        f32 local_y = y - k.center.y;
+        f32 over_x = fabsf(local_x * k.dir.x + local_y * k.dir.y) - k.half_length;
+        f32 over_y = fabsf(local_y * k.dir.x - local_x * k.dir.y) - k.half_wide;
+        f32 out_x = over_x > 0.0f ? over_x : 0.0f;
+        f32 out_y = over_y > 0.0f ? over_y : 0.0f;
+        f32 out_sq = out_x * out_x + out_y * out_y;
+        bool outside = out_sq > 0.0f;
+        bool out_hit = ZeroRadius ? false : !(radius < FLOAT_POINT_PRECISION) & !(out_sq > radius * radius);
+        f32 over = over_x > over_y ? over_x : over_y;
+        bool in_hit = !(Frame & (over < -radius));
+        bool edge_hit = outside ? out_hit : in_hit;
+        return in_high & (overlap | (!far & edge_hit));
+    }
+private:
+    f32 reach_sq_;
+    f32 anchor_sq_;
+};
+
+
+class AreaShapeFovT : public AreaShapeTBase<AreaShapeFovT, AreaFovKernel, AREA_SHAPE_FOV, true>
+{
+public:
+    void Prepare() {}
+
+    static inline f32 Dot(f32 x, f32 y, f32 z, const Point3& v) { return x * v.x + y * v.y + z * v.z; }
+    //SignBitF(a) == SignBitF(b)
+    static inline bool SameSign(f32 a, f32 b)
+    {
+        u32 ua, ub;
+        memcpy(&ua, &a, sizeof(ua));
+        memcpy(&ub, &b, sizeof(ub));
+        return ((ua ^ ub) & (1u << 31)) == 0;
+    }
+
+    inline bool Test(f32 x, f32 y, f32 z, f32 radius, f32& dist_sq) const
+    {
+        (void)radius;
+        const AreaFovKernel& k = kernel_;
+        f32 tx = x - k.apex.x;
+        f32 ty = y - k.apex.y;
+        f32 tz = z - k.apex.z;
+        dist_sq = tx * tx + ty * ty + tz * tz;
+        bool zero = (fabsf(tx) < FLOAT_POINT_PRECISION) & (fabsf(ty) < FLOAT_POINT_PRECISION) & (fabsf(tz) < FLOAT_POINT_PRECISION);
+        f32 cos_dist = Dot(tx, ty, tz, k.dir);
+        bool inside = !(cos_dist < 0.0f) & !(cos_dist * cos_dist < k.cos_half_sq * dist_sq);
+        inside = inside & !SameSign(Dot(tx, ty, tz, k.top_normal), Dot(tx, ty, tz, k.botton_normal));
+        inside = inside & !SameSign(Dot(tx, ty, tz, k.left_normal), Dot(tx, ty, tz, k.right_normal));
+
+        bool near_box = dist_sq <= k.near_sq;
+        bool box_out = SameSign(Dot(x - k.left_top_pos.x, y - k.left_top_pos.y, z - k.left_top_pos.z, k.vertical_dir),
+            Dot(x - k.left_botton_pos.x, y - k.left_botton_pos.y, z - k.left_botton_pos.z, k.vertical_dir));
+        box_out = box_out | SameSign(Dot(x - k.left_top_pos.x, y - k.left_top_pos.y, z - k.left_top_pos.z, k.horizontal_dir),
+            Dot(x - k.right_top_pos.x, y - k.right_top_pos.y, z - k.right_top_pos.z, k.horizontal_dir));
+        bool in_far = !(dist_sq > k.far_sq);
+        return in_far & (zero | (inside & (near_box | !box_out)));
+    }
+};
+
+
+template<bool ZeroRadius>
+class AreaShapeCapsuleT : public AreaShapeTBase<AreaShapeCapsuleT<ZeroRadius>, AreaCapsuleKernel, AREA_SHAPE_CAPSULE, ZeroRadius>
+{
+public:
+    void Prepare()
+    {
+        const AreaCapsuleKernel& k = this->kernel_;
+        f32 reach = k.sweep_radius + 0.0f + k.anchor_radius;
+        reach_sq_ = reach * reach;
+    }
+
+    inline bool Test(f32 x, f32 y, f32 z, f32 radius, f32& dist_sq) const
+    {
+        const AreaCapsuleKernel& k = this->kernel_;
+        f32 dx = x - k.anchor.x;
+        f32 dy = y - k.anchor.y;
+        dist_sq = dx * dx + dy * dy;
+        f32 project = dx * k.dir.x + dy * k.dir.y;
+        project = project < 0.0f ? 0.0f : project;
+        project = project > k.length ? k.length : project;
+        f32 off_x = dx - k.dir.x * project;
+        f32 off_y = dy - k.dir.y * project;
+        f32 range = k.sweep_radius + radius + k.anchor_radius;
+        f32 range_sq = ZeroRadius ? reach_sq_ : range * range;
+        return !(fabsf(z - k.anchor.z) > k.high) & !(off_x * off_x + off_y * off_y > range_sq);
+    }
+private:
+    f32 reach_sq_;
+};
+
+
+template<bool ZeroRadius>
+class AreaShapePolygonT : public AreaShapeTBase<AreaShapePolygonT<ZeroRadius>, AreaPolygonKernel, AREA_SHAPE_POLYGON, ZeroRadius>
+{
+public:
+    void Prepare()
+    {
+        const AreaPolygonKernel& k = this->kernel_;
+        reach_sq_ = k.reach * k.reach;
+        anchor_sq_ = k.anchor_radius * k.anchor_radius;
+    }
+
+    inline bool Test(f32 x, f32 y, f32 z, f32 radius, f32& dist_sq) const
+    {
+        const AreaPolygonKernel& k = this->kernel_;
+        f32 dx = x - k.anchor.x;
+        f32 dy = y - k.anchor.y;
+        dist_sq = dx * dx + dy * dy;
+        f32 range = k.reach + radius;
+        f32 both = radius + k.anchor_radius;
+        f32 range_sq = ZeroRadius ? reach_sq_ : range * range;
+        f32 both_sq = ZeroRadius ? anchor_sq_ : both * both;
+        bool in_high = !(fabsf(z - k.anchor.z) > k.high);
+        bool far = dist_sq > range_sq;
+        bool overlap = (dist_sq < FLOAT_POINT_PRECISION) | (dist_sq < both_sq);
+
+        f32 over = 0.0f;
+        for (u32 i = 0; i < k.count; i++)
+        {
+            f32 side = (dx - k.vertex_x[i]) * k.normal_x[i] + (dy - k.vertex_y[i]) * k.normal_y[i];
+            over = (i == 0 || side > over) ? side : over;
+        }
+        bool edge_hit = over <= 0.0f;
+        if (!ZeroRadius && !edge_hit && !(radius < FLOAT_POINT_PRECISION))
+        {
+            f32 out_sq = 0.0f;
+            for (u32 i = 0; i < k.count; i++)
+            {
+                f32 rel_x = dx - k.vertex_x[i];
+                f32 rel_y = dy - k.vertex_y[i];
+                f32 project = rel_y * k.normal_x[i] - rel_x * k.normal_y[i];
+                project = project < 0.0f ? 0.0f : project;
+                project = project > k.edge_length[i] ? k.edge_length[i] : project;
+                f32 off_x = rel_x + k.normal_y[i] * project;
+                f32 off_y = rel_y - k.normal_x[i] * project;
+                f32 edge_sq = off_x * off_x + off_y * off_y;
+                out_sq = (i == 0 || edge_sq < out_sq) ? edge_sq : out_sq;
+            }
+            edge_hit = !(out_sq > radius * radius);
+        }
+        return in_high & !far & (overlap | edge_hit);
+    }
+private:
+    f32 reach_sq_;
+    f32 anchor_sq_;
+};
+
+
+template<bool ZeroRadius, bool Frame>
+class AreaShapeT<AREA_SHAPE_CIRCLE, ZeroRadius, Frame> : public AreaShapeCircleT<AREA_SHAPE_CIRCLE, ZeroRadius> {};
+
+template<bool ZeroRadius, bool Frame>
+class AreaShapeT<AREA_SHAPE_RING, ZeroRadius, Frame> : public AreaShapeCircleT<AREA_SHAPE_RING, ZeroRadius> {};
+
+template<bool ZeroRadius, bool Frame>
+class AreaShapeT<AREA_SHAPE_FAN, ZeroRadius, Frame> : public AreaShapeFanT<ZeroRadius> {};
+
+template<bool ZeroRadius, bool Frame>
+class AreaShapeT<AREA_SHAPE_RECT, ZeroRadius, Frame> : public AreaShapeRectT<AREA_SHAPE_RECT, ZeroRadius, Frame> {};
+
+template<bool ZeroRadius, bool Frame>
+class AreaShapeT<AREA_SHAPE_FRAME, ZeroRadius, Frame> : public AreaShapeRectT<AREA_SHAPE_FRAME, ZeroRadius, Frame> {};
+
+template<bool ZeroRadius, bool Frame>
+class AreaShapeT<AREA_SHAPE_FOV, ZeroRadius, Frame> : public AreaShapeFovT {};
+
+template<bool ZeroRadius, bool Frame>
+class AreaShapeT<AREA_SHAPE_CAPSULE, ZeroRadius, Frame> : public AreaShapeCapsuleT<ZeroRadius> {};
+
+template<bool ZeroRadius, bool Frame>
+class AreaShapeT<AREA_SHAPE_POLYGON, ZeroRadius, Frame> : public AreaShapePolygonT<ZeroRadius> {};
+
+
+//对已初始化的AreaShape只做一次类型分派, 然后用对应的特化类型跑整批目标.
+//points.radius为NULL时使用ZeroRadius版本.
+template<class Visitor>
+s32 AreaShapeVisitInRange(const AreaShape& shape, const AreaPoints& points, Visitor&& visitor)
+{
+    bool zero_radius = points.radius == NULL;
+    switch (shape.shape_type())
+    {
+#define AREA_SHAPE_T_VISIT(type) \
+    case type: \
+        if (zero_radius) { AreaShapeT<type, true> engine; engine.Load(shape); return engine.VisitInRange(points, visitor); } \
+        else { AreaShapeT<type, false> engine; engine.Load(shape); return engine.VisitInRange(points, visitor); }
+    AREA_SHAPE_T_VISIT(AREA_SHAPE_CIRCLE)
+    AREA_SHAPE_T_VISIT(AREA_SHAPE_RING)
+    AREA_SHAPE_T_VISIT(AREA_SHAPE_FAN)
+    AREA_SHAPE_T_VISIT(AREA_SHAPE_RECT)
+    AREA_SHAPE_T_VISIT(AREA_SHAPE_FRAME)
+    AREA_SHAPE_T_VISIT(AREA_SHAPE_FOV)
+    AREA_SHAPE_T_VISIT(AREA_SHAPE_CAPSULE)
+    AREA_SHAPE_T_VISIT(AREA_SHAPE_POLYGON)
+#undef AREA_SHAPE_T_VISIT
+    default:
+        break;
+    }
+    LOGFMTE("area shape visit error. range not init. shape_type:<%u>", shape.shape_type());
+    return -1;
+}
+
+
+#endif //
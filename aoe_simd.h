@@ -0,0 +1,234 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+#ifndef AOE_SIMD_H
+#define AOE_SIMD_H
+
+#include "comm_def.h"
+
+//指令集由编译选项决定, 各指令集的检测核心在单独的编译单元中以对应选项编译(见CMakeLists.txt), 运行时按CPU选择.
+//msvc下SSE4.1不需要额外选项.
+#if defined(__SSE4_1__) || (defined(_MSC_VER) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)))
+#define AOE_SIMD_SSE41 1
+#include <smmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define AOE_SIMD_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX512F__)
+#define AOE_SIMD_AVX512 1
+#include <immintrin.h>
+#endif
+
+//批量检测用的向量封装. 每种宽度提供同一套接口, 检测核心只写一份模板.
+//所有运算的顺序与标量路径(Vector3)保持一致, 保证批量结果和逐点结果逐位相同.
+//F为浮点向量, M为逐通道掩码.
+//这些封装会被以不同指令集选项编译的多个编译单元包含, 放在匿名空间内, 每个编译单元各用各的,
+//避免链接器把-mavx2/-mavx512f编译出的副本合并给其他编译单元使用.
+
+namespace
+{
+
+struct AoeSimdScalar
+{
+    static const u32 WIDTH = 1;
+    typedef f32 F;
+    typedef bool M;
+
+    static inline F Load(const f32* p) { return *p; }
+    static inline void Store(f32* p, F v) { *p = v; }
+    static inline F Set(f32 v) { return v; }
+    static inline F Add(F a, F b) { return a + b; }
+    static inline F Sub(F a, F b) { return a - b; }
+    static inline F Mul(F a, F b) { return a * b; }
+    static inline F Div(F a, F b) { return a / b; }
+    static inline F Sqrt(F a) { return sqrtf(a); }
+    static inline F Abs(F a) { return fabsf(a); }
+    static inline M Lt(F a, F b) { return a < b; }
+    static inline M Le(F a, F b) { return a <= b; }
+    static inline M Gt(F a, F b) { return a > b; }
+    static inline M Ge(F a, F b) { return a >= b; }
+    static inline M False() { return false; }
+    static inline M And(M a, M b) { return a && b; }
+    static inline M Or(M a, M b) { return a || b; }
+    static inline M AndNot(M a, M b) { return a && !b; }
+    static inline M Not(M a) { return !a; }
+    static inline F Select(M m, F a, F b) { return m ? a : b; }
+    static inline u32 Bits(M m) { return m ? 1u : 0u; }
+    static inline bool All(M m) { return m; }
+    //SignBitF(a) == SignBitF(b)
+    static inline M SameSign(F a, F b)
+    {
+        u32 ua, ub;
+        memcpy(&ua, &a, sizeof(ua));
+        memcpy(&ub, &b, sizeof(ub));
+        return ((ua ^ ub) & (1u << 31)) == 0;
+    }
+    //与Vector3::INVERSE_SQRT相同的近似
+    static inline F InvSqrt(F val)
+    {
+        f32 xhalf = 0.5f * val;
+        s32 i;
+        memcpy(&i, &val, sizeof(i));
+        i = 0x5f3759df - (i >> 1);
+        memcpy(&val, &i, sizeof(val));
+        val = val * (1.5f - xhalf * val * val);
+        return val;
+    }
+};
+
+#if AOE_SIMD_SSE41
+struct AoeSimdSSE41
+{
+    static const u32 WIDTH = 4;
+    typedef __m128 F;
+    typedef __m128 M;
+
+    static inline F Load(const f32* p) { return _mm_loadu_ps(p); }
+    static inline void Store(f32* p, F v) { _mm_storeu_ps(p, v); }
+    static inline F Set(f32 v) { return _mm_set1_ps(v); }
+    static inline F Add(F a, F b) { return _mm_add_ps(a, b); }
+    static inline F Sub(F a, F b) { return _mm_sub_ps(a, b); }
+    static inline F Mul(F a, F b) { return _mm_mul_ps(a, b); }
+    static inline F Div(F a, F b) { return _mm_div_ps(a, b); }
+    static inline F Sqrt(F a) { return _mm_sqrt_ps(a); }
+    static inline F Abs(F a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static inline M Lt(F a, F b) { return _mm_cmplt_ps(a, b); }
+    static inline M Le(F a, F b) { return _mm_cmple_ps(a, b); }
+    static inline M Gt(F a, F b) { return _mm_cmpgt_ps(a, b); }
+    static inline M Ge(F a, F b) { return _mm_cmpge_ps(a, b); }
+    static inline M False() { return _mm_setzero_ps(); }
+    static inline M And(M a, M b) { return _mm_and_ps(a, b); }
+    static inline M Or(M a, M b) { return _mm_or_ps(a, b); }
+    static inline M AndNot(M a, M b) { return _mm_andnot_ps(b, a); }
+    static inline M Not(M a) { return _mm_xor_ps(a, _mm_castsi128_ps(_mm_set1_epi32(-1))); }
+    static inline F Select(M m, F a, F b) { return _mm_blendv_ps(b, a, m); }
+    static inline u32 Bits(M m) { return (u32)_mm_movemask_ps(m); }
+    static inline bool All(M m) { return _mm_movemask_ps(m) == 0xf; }
+    static inline M SameSign(F a, F b)
+    {
+        __m128i x = _mm_castps_si128(_mm_xor_ps(a, b));
+        return _mm_castsi128_ps(_mm_cmpgt_epi32(x, _mm_set1_epi32(-1)));
+    }
+    static inline F InvSqrt(F val)
+    {
+        F xhalf = _mm_mul_ps(_mm_set1_ps(0.5f), val);
+        __m128i i = _mm_castps_si128(val);
+        i = _mm_sub_epi32(_mm_set1_epi32(0x5f3759df), _mm_srai_epi32(i, 1));
+        val = _mm_castsi128_ps(i);
+        return _mm_mul_ps(val, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(_mm_mul_ps(xhalf, val), val)));
+    }
+};
+#endif
+
+#if AOE_SIMD_AVX2
+struct AoeSimdAVX2
+{
+    static const u32 WIDTH = 8;
+    typedef __m256 F;
+    typedef __m256 M;
+
+    static inline F Load(const f32* p) { return _mm256_loadu_ps(p); }
+    static inline void Store(f32* p, F v) { _mm256_storeu_ps(p, v); }
+    static inline F Set(f32 v) { return _mm256_set1_ps(v); }
+    static inline F Add(F a, F b) { return _mm256_add_ps(a, b); }
+    static inline F Sub(F a, F b) { return _mm256_sub_ps(a, b); }
+    static inline F Mul(F a, F b) { return _mm256_mul_ps(a, b); }
+    static inline F Div(F a, F b) { return _mm256_div_ps(a, b); }
+    static inline F Sqrt(F a) { return _mm256_sqrt_ps(a); }
+    static inline F Abs(F a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static inline M Lt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static inline M Le(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static inline M Gt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static inline M Ge(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static inline M False() { return _mm256_setzero_ps(); }
+    static inline M And(M a, M b) { return _mm256_and_ps(a, b); }
+    static inline M Or(M a, M b) { return _mm256_or_ps(a, b); }
+    static inline M AndNot(M a, M b) { return _mm256_andnot_ps(b, a); }
+    static inline M Not(M a) { return _mm256_xor_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(-1))); }
+    static inline F Select(M m, F a, F b) { return _mm256_blendv_ps(b, a, m); }
+    static inline u32 Bits(M m) { return (u32)_mm256_movemask_ps(m); }
+    static inline bool All(M m) { return _mm256_movemask_ps(m) == 0xff; }
+    static inline M SameSign(F a, F b)
+    {
+        __m256i x = _mm256_castps_si256(_mm256_xor_ps(a, b));
+        return _mm256_castsi256_ps(_mm256_cmpgt_epi32(x, _mm256_set1_epi32(-1)));
+    }
+    static inline F InvSqrt(F val)
+    {
+        F xhalf = _mm256_mul_ps(_mm256_set1_ps(0.5f), val);
+        __m256i i = _mm256_castps_si256(val);
+        i = _mm256_sub_epi32(_mm256_set1_epi32(0x5f3759df), _mm256_srai_epi32(i, 1));
+        val = _mm256_castsi256_ps(i);
+        return _mm256_mul_ps(val, _mm256_sub_ps(_mm256_set1_ps(1.5f), _mm256_mul_ps(_mm256_mul_ps(xhalf, val), val)));
+    }
+};
+#endif
+
+#if AOE_SIMD_AVX512
+//只依赖AVX512F, 掩码直接使用k寄存器
+struct AoeSimdAVX512
+{
+    static const u32 WIDTH = 16;
+    typedef __m512 F;
+    typedef __mmask16 M;
+
+    static inline F Load(const f32* p) { return _mm512_loadu_ps(p); }
+    static inline void Store(f32* p, F v) { _mm512_storeu_ps(p, v); }
+    static inline F Set(f32 v) { return _mm512_set1_ps(v); }
+    static inline F Add(F a, F b) { return _mm512_add_ps(a, b); }
+    static inline F Sub(F a, F b) { return _mm512_sub_ps(a, b); }
+    static inline F Mul(F a, F b) { return _mm512_mul_ps(a, b); }
+    static inline F Div(F a, F b) { return _mm512_div_ps(a, b); }
+    static inline F Sqrt(F a) { return _mm512_sqrt_ps(a); }
+    static inline F Abs(F a) { return _mm512_abs_ps(a); }
+    static inline M Lt(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static inline M Le(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+    static inline M Gt(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static inline M Ge(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+    static inline M False() { return 0; }
+    static inline M And(M a, M b) { return (M)(a & b); }
+    static inline M Or(M a, M b) { return (M)(a | b); }
+    static inline M AndNot(M a, M b) { return (M)(a & ~b); }
+    static inline M Not(M a) { return (M)~a; }
+    static inline F Select(M m, F a, F b) { return _mm512_mask_blend_ps(m, b, a); }
+    static inline u32 Bits(M m) { return (u32)m; }
+    static inline bool All(M m) { return m == 0xffff; }
+    static inline M SameSign(F a, F b)
+    {
+        __m512i x = _mm512_xor_si512(_mm512_castps_si512(a), _mm512_castps_si512(b));
+        return _mm512_cmpgt_epi32_mask(x, _mm512_set1_epi32(-1));
+    }
+    static inline F InvSqrt(F val)
+    {
+        F xhalf = _mm512_mul_ps(_mm512_set1_ps(0.5f), val);
+        __m512i i = _mm512_castps_si512(val);
+        i = _mm512_sub_epi32(_mm512_set1_epi32(0x5f3759df), _mm512_srai_epi32(i, 1));
+        val = _mm512_castsi512_ps(i);
+        return _mm512_mul_ps(val, _mm512_sub_ps(_mm512_set1_ps(1.5f), _mm512_mul_ps(_mm512_mul_ps(xhalf, val), val)));
+    }
+};
+#endif
+
+}
+
+
+#endif //
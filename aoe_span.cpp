@@ -0,0 +1,638 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "aoe_span.h"
+#include <math.h>
+
+const f32 AOE_SPAN_SLACK = 0.01f; //候选区间按网格间距放宽的比例
+
+//一行中的x区间 从小到大且互不相交
+struct AoeSpanRow
+{
+    u32 count;
+    bool joined; //并入过相交的另一个区域, 区间中间可能有不命中的部分
+    f32 lo[AOE_SPAN_ROW_MAX];
+    f32 hi[AOE_SPAN_ROW_MAX];
+};
+
+static inline void AoeSpanSet(AoeSpanRow& row, f32 lo, f32 hi)
+{
+    row.count = lo <= hi ? 1 : 0;
+    row.joined = false;
+    row.lo[0] = lo;
+    row.hi[0] = hi;
+}
+
+static inline void AoeSpanRemove(AoeSpanRow& row, u32 index)
+{
+    for (u32 i = index + 1; i < row.count; i++)
+    {
+        row.lo[i - 1] = row.lo[i];
+        row.hi[i - 1] = row.hi[i];
+    }
+    row.count--;
+}
+
+//保留 a * x + b <= 0 的部分
+static void AoeSpanClip(AoeSpanRow& row, f32 a, f32 b)
+{
+    if (fabsf(a) < 1e-6f)
+    {
+        if (b > 0.0f)
+        {
+            row.count = 0;
+        }
+        return;
+    }
+    f32 bound = -b / a;
+    for (u32 i = row.count; i > 0; i--)
+    {
+        if (a > 0.0f)
+        {
+            row.hi[i - 1] = bound < row.hi[i - 1] ? bound : row.hi[i - 1];
+        }
+        else
+        {
+            row.lo[i - 1] = bound > row.lo[i - 1] ? bound : row.lo[i - 1];
+        }
+        if (row.lo[i - 1] > row.hi[i - 1])
+        {
+            AoeSpanRemove(row, i - 1);
+        }
+    }
+}
+
+//保留 normal * (p - base) <= c 的部分, p = (x, y, z)
+static inline void AoeSpanPlane(AoeSpanRow& row, const Point3& normal, const Point3& base, f32 y, f32 z, f32 c)
+{
+    AoeSpanClip(row, normal.x, normal.y * (y - base.y) + normal.z * (z - base.z) - normal.x * base.x - c);
+}
+
+//圆(center, radius)在y行上的弦 不相交时lo > hi
+static inline void AoeSpanChord(const Point3& center, f32 radius, f32 y, f32& lo, f32& hi)
+{
+    f32 dy = y - center.y;
+    f32 half_sq = radius * radius - dy * dy;
+    if (radius < 0.0f || half_sq < 0.0f)
+    {
+        lo = 1.0f;
+        hi = 0.0f;
+        return;
+    }
+    f32 half = sqrtf(half_sq);
+    lo = center.x - half;
+    hi = center.x + half;
+}
+
+//保留与弦相交的部分
+static inline void AoeSpanClipChord(AoeSpanRow& row, const Point3& center, f32 radius, f32 y)
+{
+    f32 lo = 0.0f;
+    f32 hi = 0.0f;
+    AoeSpanChord(center, radius, y, lo, hi);
+    AoeSpanClip(row, 1.0f, -hi);
+    AoeSpanClip(row, -1.0f, lo);
+}
+
+//挖掉开区间(lo, hi)
+static void AoeSpanCut(AoeSpanRow& row, f32 lo, f32 hi)
+{
+    if (lo >= hi)
+    {
+        return;
+    }
+    for (u32 i = row.count; i > 0; i--)
+    {
+        u32 index = i - 1;
+        if (hi <= row.lo[index] || lo >= row.hi[index])
+        {
+            continue;
+        }
+        bool keep_left = row.lo[index] <= lo;
+        bool keep_right = row.hi[index] >= hi;
+        if (keep_left && keep_right && row.count < AOE_SPAN_ROW_MAX)
+        {
+            for (u32 j = row.count; j > index + 1; j--)
+            {
+                row.lo[j] = row.lo[j - 1];
+                row.hi[j] = row.hi[j - 1];
+            }
+            row.count++;
+            row.lo[index + 1] = hi;
+            row.hi[index + 1] = row.hi[index];
+            row.hi[index] = lo;
+        }
+        else if (keep_left)
+        {
+            //区间个数已满时保留整段 由两端的修正处理
+            row.hi[index] = keep_right ? row.hi[index] : lo;
+        }
+        else if (keep_right)
+        {
+            row.lo[index] = hi;
+        }
+        else
+        {
+            AoeSpanRemove(row, index);
+        }
+    }
+}
+
+static inline void AoeSpanCutRow(AoeSpanRow& row, const AoeSpanRow& hole)
+{
+    for (u32 i = 0; i < hole.count; i++)
+    {
+        AoeSpanCut(row, hole.lo[i], hole.hi[i]);
+    }
+}
+
+//并上[lo, hi] 与已有区间相交时合并, 不相交时单独一段
+//不相交的两段之间确实有不命中的部分, 分开后各自由两端修正, 不会把中间的空隙算作命中.
+//返回是否与已有区间合并
+static bool AoeSpanAdd(AoeSpanRow& row, f32 lo, f32 hi)
+{
+    if (lo > hi)
+    {
+        return false;
+    }
+    u32 index = 0;
+    while (index < row.count && row.hi[index] < lo)
+    {
+        index++;
+    }
+    u32 last = index;
+    while (last < row.count && row.lo[last] <= hi)
+    {
+        lo = row.lo[last] < lo ? row.lo[last] : lo;
+        hi = row.hi[last] > hi ? row.hi[last] : hi;
+        last++;
+    }
+    bool merged = last > index;
+    if (last == index)
+    {
+        if (row.count >= AOE_SPAN_ROW_MAX)
+        {
+            return false;
+        }
+        for (u32 i = row.count; i > index; i--)
+        {
+            row.lo[i] = row.lo[i - 1];
+            row.hi[i] = row.hi[i - 1];
+        }
+        row.count++;
+        last = index + 1;
+    }
+    row.lo[index] = lo;
+    row.hi[index] = hi;
+    for (u32 i = last; i < row.count; i++)
+    {
+        row.lo[index + 1 + i - last] = row.lo[i];
+        row.hi[index + 1 + i - last] = row.hi[i];
+    }
+    row.count -= last - index - 1;
+    return merged;
+}
+
+static inline bool AoeSpanAddChord(AoeSpanRow& row, const Point3& center, f32 radius, f32 y)
+{
+    f32 lo = 0.0f;
+    f32 hi = 0.0f;
+    AoeSpanChord(center, radius, y, lo, hi);
+    return AoeSpanAdd(row, lo, hi);
+}
+
+//并上定位点的碰撞圆. 形状和碰撞圆都按目标半径放宽, 两者的候选区间相交时真正的命中部分不一定相接,
+//合并后标记joined, 由AoeSpanEmit逐个检测合并后的区间
+static inline void AoeSpanAddAnchor(AoeSpanRow& row, const Point3& anchor, f32 radius, f32 y)
+{
+    if (AoeSpanAddChord(row, anchor, radius, y))
+    {
+        row.joined = true;
+    }
+}
+
+//与定位点重合时必定命中的半径
+static inline f32 AoeSpanAnchorRadius(f32 both)
+{
+    f32 precision = sqrtf(FLOAT_POINT_PRECISION);
+    return both > precision ? both : precision;
+}
+
+//以下按形状类型求y行的候选区间, slack为放宽的距离, 只用来容纳浮点误差: 命中和挖掉的部分都向外放宽.
+//候选区间与形状边界基本重合, 区间之间的空隙都是真正不命中的部分. 每个候选区间内的命中是连续的, 两端由AoeSpanEmit逐个修正.
+//并入定位点碰撞圆(或视锥近距球)的行例外, 标记为joined.
+
+static void AoeSpanCircle(AoeSpanRow& row, const AreaCircleKernel& k, f32 y, f32 z, f32 radius, f32 slack)
+{
+    if (fabsf(z - k.anchor.z) > k.high)
+    {
+        row.count = 0;
+        return;
+    }
+    AoeSpanClipChord(row, k.anchor, k.max_radius + radius + k.anchor_radius + slack, y);
+    if (k.min_radius_sq >= FLOAT_POINT_PRECISION)
+    {
+        f32 lo = 0.0f;
+        f32 hi = 0.0f;
+        AoeSpanChord(k.anchor, sqrtf(k.min_radius_sq) + slack, y, lo, hi);
+        AoeSpanCut(row, lo, hi);
+    }
+}
+
+static void AoeSpanFan(AoeSpanRow& row, const AreaFanKernel& k, f32 y, f32 z, f32 radius, f32 slack)
+{
+    if (fabsf(z - k.anchor.z) > k.high)
+    {
+        row.count = 0;
+        return;
+    }
+    AoeSpanClipChord(row, k.anchor, k.radian_radius + radius + k.anchor_radius + slack, y);
+    if (k.is_circle || row.count == 0)
+    {
+        return;
+    }
+    f32 anchor_radius = AoeSpanAnchorRadius(radius + k.anchor_radius);
+    Point3 left(k.left_normal.x, k.left_normal.y, 0.0f);
+    Point3 right(k.right_normal.x, k.right_normal.y, 0.0f);
+    if (!k.is_wide)
+    {
+        //两条边按目标半径外推后的夹角
+        AoeSpanPlane(row, left, k.anchor, y, z, radius + slack);
+        AoeSpanPlane(row, right, k.anchor, y, z, radius + slack);
+        AoeSpanPlane(row, Point3(-k.normalize_dir.x, -k.normalize_dir.y, 0.0f), k.anchor, y, z, radius + slack);
+        AoeSpanAddAnchor(row, k.anchor, anchor_radius + slack, y);
+        return;
+    }
+    //大于180度时挖掉离两条边都超过目标半径的夹角, 定位点附近除外
+    AoeSpanRow hole;
+    AoeSpanSet(hole, row.lo[0], row.hi[row.count - 1]);
+    AoeSpanPlane(hole, left * -1.0f, k.anchor, y, z, -radius + slack);
+    AoeSpanPlane(hole, right * -1.0f, k.anchor, y, z, -radius + slack);
+    if (hole.count == 0)
+    {
+        return;
+    }
+    f32 lo = 0.0f;
+    f32 hi = 0.0f;
+    AoeSpanChord(k.anchor, anchor_radius + slack, y, lo, hi);
+    AoeSpanCut(hole, lo, hi);
+    AoeSpanCutRow(row, hole);
+}
+
+static void AoeSpanRect(AoeSpanRow& row, const AreaRectKernel& k, f32 y, f32 z, f32 radius, f32 slack)
+{
+    if (fabsf(z - k.anchor.z) > k.high)
+    {
+        row.count = 0;
+        return;
+    }
+    AoeSpanClipChord(row, k.anchor, k.distance + radius + k.anchor_radius + slack, y);
+    Point3 dir(k.dir.x, k.dir.y, 0.0f);
+    Point3 side(-k.dir.y, k.dir.x, 0.0f);
+    f32 length = k.half_length + radius + slack;
+    f32 wide = k.half_wide + radius + slack;
+    AoeSpanPlane(row, dir, k.center, y, z, length);
+    AoeSpanPlane(row, dir * -1.0f, k.center, y, z, length);
+    AoeSpanPlane(row, side, k.center, y, z, wide);
+    AoeSpanPlane(row, side * -1.0f, k.center, y, z, wide);
+    f32 anchor_radius = AoeSpanAnchorRadius(radius + k.anchor_radius);
+    if (k.collide_test)
+    {
+        AoeSpanAddAnchor(row, k.anchor, anchor_radius + slack, y);
+    }
+    if (!k.frame_test || row.count == 0)
+    {
+        return;
+    }
+    //方框挖掉离四条边都超过目标半径的部分
+    AoeSpanRow hole;
+    AoeSpanSet(hole, row.lo[0], row.hi[row.count - 1]);
+    length = k.half_length - radius + slack;
+    wide = k.half_wide - radius + slack;
+    AoeSpanPlane(hole, dir, k.center, y, z, length);
+    AoeSpanPlane(hole, dir * -1.0f, k.center, y, z, length);
+    AoeSpanPlane(hole, side, k.center, y, z, wide);
+    AoeSpanPlane(hole, side * -1.0f, k.center, y, z, wide);
+    if (hole.count == 0)
+    {
+        return;
+    }
+    if (k.collide_test)
+    {
+        f32 lo = 0.0f;
+        f32 hi = 0.0f;
+        AoeSpanChord(k.anchor, anchor_radius + slack, y, lo, hi);
+        AoeSpanCut(hole, lo, hi);
+    }
+    AoeSpanCutRow(row, hole);
+}
+
+//过顶点的平面 只保留朝向所在的一侧
+static inline void AoeSpanFovSide(AoeSpanRow& row, const AreaFovKernel& k, const Point3& normal, f32 y, f32 z, f32 slack)
+{
+    f32 forward = normal.x * k.dir.x + normal.y * k.dir.y + normal.z * k.dir.z;
+    if (forward == 0.0f)
+    {
+        return;
+    }
+    Point3 inner = forward > 0.0f ? normal * -1.0f : normal;
+    AoeSpanPlane(row, inner, k.apex, y, z, slack * normal.length());
+}
+
+//两个平行平面之间 direction从base_lo指向base_hi一侧
+static inline void AoeSpanFovSlab(AoeSpanRow& row, const Point3& direction, const Point3& base_lo, const Point3& base_hi, f32 y, f32 z, f32 slack)
+{
+    f32 length = direction.length();
+    AoeSpanPlane(row, direction * -1.0f, base_lo, y, z, slack * length);
+    AoeSpanPlane(row, direction, base_hi, y, z, slack * length);
+}
+
+static void AoeSpanFov(AoeSpanRow& row, const AreaFovKernel& k, f32 y, f32 z, f32 slack)
+{
+    f32 dz = z - k.apex.z;
+    f32 far_sq = k.far_sq - dz * dz;
+    if (far_sq < 0.0f)
+    {
+        row.count = 0;
+        return;
+    }
+    AoeSpanClipChord(row, k.apex, sqrtf(far_sq) + slack, y);
+    AoeSpanPlane(row, k.dir * -1.0f, k.apex, y, z, slack * k.dir.length());
+    AoeSpanFovSide(row, k, k.top_normal, y, z, slack);
+    AoeSpanFovSide(row, k, k.botton_normal, y, z, slack);
+    AoeSpanFovSide(row, k, k.left_normal, y, z, slack);
+    AoeSpanFovSide(row, k, k.right_normal, y, z, slack);
+    if (row.count == 0)
+    {
+        return;
+    }
+    //近距球内 或者在近距长方体延伸出的柱体内
+    AoeSpanRow near_box = row;
+    f32 near_sq = k.near_sq - dz * dz;
+    if (near_sq >= 0.0f)
+    {
+        AoeSpanClipChord(near_box, k.apex, sqrtf(near_sq) + slack, y);
+    }
+    else
+    {
+        near_box.count = 0;
+    }
+    AoeSpanFovSlab(row, k.vertical_dir, k.left_top_pos, k.left_botton_pos, y, z, slack);
+    AoeSpanFovSlab(row, k.horizontal_dir, k.left_top_pos, k.right_top_pos, y, z, slack);
+    if (near_box.count == 0)
+    {
+        return;
+    }
+    //近距球与长方体柱的并集 中间可能有不命中的部分
+    if (AoeSpanAdd(row, near_box.lo[0], near_box.hi[near_box.count - 1]))
+    {
+        row.joined = true;
+    }
+}
+
+static void AoeSpanCapsule(AoeSpanRow& row, const AreaCapsuleKernel& k, f32 y, f32 z, f32 radius, f32 slack)
+{
+    if (fabsf(z - k.anchor.z) > k.high)
+    {
+        row.count = 0;
+        return;
+    }
+    //两端的圆和中间的矩形
+    f32 reach = k.sweep_radius + radius + k.anchor_radius + slack;
+    Point3 dir(k.dir.x, k.dir.y, 0.0f);
+    Point3 side(-k.dir.y, k.dir.x, 0.0f);
+    AoeSpanPlane(row, dir, k.anchor, y, z, k.length + slack);
+    AoeSpanPlane(row, dir * -1.0f, k.anchor, y, z, slack);
+    AoeSpanPlane(row, side, k.anchor, y, z, reach);
+    AoeSpanPlane(row, side * -1.0f, k.anchor, y, z, reach);
+    AoeSpanAddChord(row, k.anchor, reach, y);
+    AoeSpanAddChord(row, k.anchor + dir * k.length, reach, y);
+}
+
+static void AoeSpanPolygon(AoeSpanRow& row, const AreaPolygonKernel& k, f32 y, f32 z, f32 radius, f32 slack)
+{
+    if (fabsf(z - k.anchor.z) > k.high)
+    {
+        row.count = 0;
+        return;
+    }
+    AoeSpanClipChord(row, k.anchor, k.reach + radius + slack, y);
+    for (u32 i = 0; i < k.count && row.count > 0; i++)
+    {
+        Point3 normal(k.normal_x[i], k.normal_y[i], 0.0f);
+        AoeSpanPlane(row, normal, k.anchor, y, z, k.normal_x[i] * k.vertex_x[i] + k.normal_y[i] * k.vertex_y[i] + radius + slack);
+    }
+    AoeSpanAddAnchor(row, k.anchor, AoeSpanAnchorRadius(radius + k.anchor_radius) + slack, y);
+}
+
+static inline bool AoeSpanHit(AreaShape& shape, const AoeSpanGrid& grid, f32 y, u32 col, f32 radius)
+{
+    f32 dist_sq = 0.0f;
+    return shape.PointInRange(Point3(grid.origin.x + col * grid.step, y, grid.origin.z), radius, dist_sq) == 0;
+}
+
+//第index个区间换算成列范围 两侧各多取一个不在相邻区间内的采样点, 窄于间距的区间也能找到命中. 与网格不相交时返回false
+static inline bool AoeSpanCols(const AoeSpanGrid& grid, const AoeSpanRow& row, u32 index, u32& first, u32& last)
+{
+    f32 col_lo = ceilf((row.lo[index] - grid.origin.x) / grid.step) - 1.0f;
+    f32 col_hi = floorf((row.hi[index] - grid.origin.x) / grid.step) + 1.0f;
+    if (index > 0 && grid.origin.x + col_lo * grid.step <= row.hi[index - 1])
+    {
+        col_lo += 1.0f;
+    }
+    if (index + 1 < row.count && grid.origin.x + col_hi * grid.step >= row.lo[index + 1])
+    {
+        col_hi -= 1.0f;
+    }
+    if (col_hi < 0.0f || col_lo > (f32)(grid.cols - 1) || col_lo > col_hi)
+    {
+        return false;
+    }
+    first = col_lo > 0.0f ? (u32)col_lo : 0;
+    last = col_hi < (f32)(grid.cols - 1) ? (u32)col_hi : grid.cols - 1;
+    return true;
+}
+
+//追加[begin, end) 与同一行的前一段相接时合并
+static inline void AoeSpanPush(std::vector<AoeSpan>& spans, size_t row_first, u32 row_index, u32 begin, u32 end)
+{
+    if (spans.size() > row_first && spans.back().end >= begin)
+    {
+        spans.back().end = end > spans.back().end ? end : spans.back().end;
+        return;
+    }
+    spans.push_back({ row_index, begin, end });
+}
+
+//候选区间换算成列范围, 两端逐个检测收缩到命中, 没有收缩过的一端再向外扩展到不命中.
+//joined的行两端之间也逐个检测, 在不命中的位置断开.
+static void AoeSpanEmit(AreaShape& shape, const AoeSpanGrid& grid, u32 row_index, f32 y, f32 radius, const AoeSpanRow& row, std::vector<AoeSpan>& spans)
+{
+    size_t row_first = spans.size();
+    for (u32 i = 0; i < row.count; i++)
+    {
+        u32 first = 0;
+        u32 last = 0;
+        if (!AoeSpanCols(grid, row, i, first, last))
+        {
+            continue;
+        }
+        u32 begin = first;
+        u32 end = last;
+        while (first <= last && !AoeSpanHit(shape, grid, y, first, radius))
+        {
+            first++;
+        }
+        if (first > last)
+        {
+            continue;
+        }
+        while (last > first && !AoeSpanHit(shape, grid, y, last, radius))
+        {
+            last--;
+        }
+        while (first == begin && first > 0 && AoeSpanHit(shape, grid, y, first - 1, radius))
+        {
+            first--;
+            begin = first;
+        }
+        while (last == end && last + 1 < grid.cols && AoeSpanHit(shape, grid, y, last + 1, radius))
+        {
+            last++;
+            end = last;
+        }
+        if (row.joined)
+        {
+            for (u32 col = first + 1; col < last; col++)
+            {
+                if (AoeSpanHit(shape, grid, y, col, radius))
+                {
+                    continue;
+                }
+                AoeSpanPush(spans, row_first, row_index, first, col);
+                while (col + 1 < last && !AoeSpanHit(shape, grid, y, col + 1, radius))
+                {
+                    col++;
+                }
+                first = col + 1;
+            }
+        }
+        AoeSpanPush(spans, row_first, row_index, first, last + 1);
+    }
+}
+
+s32 AoeShapeSpans(AreaShape& shape, const AoeSpanGrid& grid, f32 radius, std::vector<AoeSpan>& spans)
+{
+    if (!(grid.step > 0.0f) || grid.cols == 0 || grid.rows == 0 || radius < 0.0f)
+    {
+        LOGFMTE("shape spans param error. step:<%f>, cols:<%u>, rows:<%u>, radius:<%f>", grid.step, grid.cols, grid.rows, radius);
+        return -1;
+    }
+    AreaBounds bounds;
+    s32 ret = shape.Bounds(bounds);
+    if (ret != 0)
+    {
+        LOGFMTE("shape spans error:<%d>. shape not init.", ret);
+        return ret;
+    }
+    f32 z = grid.origin.z;
+    f32 slack = grid.step * AOE_SPAN_SLACK;
+    if (z < bounds.min.z - radius - slack || z > bounds.max.z + radius + slack)
+    {
+        return 0;
+    }
+
+    //包围盒覆盖的行 与定位点重合的判定距离不在包围盒内, 一起放宽
+    f32 extend = radius + slack + sqrtf(FLOAT_POINT_PRECISION);
+    f32 row_lo = ceilf((bounds.min.y - extend - grid.origin.y) / grid.step);
+    f32 row_hi = floorf((bounds.max.y + extend - grid.origin.y) / grid.step);
+    if (row_hi < 0.0f || row_lo > (f32)(grid.rows - 1) || row_lo > row_hi)
+    {
+        return 0;
+    }
+    u32 first_row = row_lo > 0.0f ? (u32)row_lo : 0;
+    u32 last_row = row_hi < (f32)(grid.rows - 1) ? (u32)row_hi : grid.rows - 1;
+    f32 min_x = bounds.min.x - extend;
+    f32 max_x = bounds.max.x + extend;
+
+    AreaCircleKernel circle;
+    AreaFanKernel fan;
+    AreaRectKernel rect;
+    AreaFovKernel fov;
+    AreaCapsuleKernel capsule;
+    AreaPolygonKernel polygon;
+    u32 shape_type = shape.shape_type();
+    switch (shape_type)
+    {
+    case AREA_SHAPE_CIRCLE:
+    case AREA_SHAPE_RING:
+        shape.BuildKernel(circle);
+        break;
+    case AREA_SHAPE_FAN:
+        shape.BuildKernel(fan);
+        break;
+    case AREA_SHAPE_RECT:
+    case AREA_SHAPE_FRAME:
+        shape.BuildKernel(rect);
+        break;
+    case AREA_SHAPE_FOV:
+        shape.BuildKernel(fov);
+        break;
+    case AREA_SHAPE_CAPSULE:
+        shape.BuildKernel(capsule);
+        break;
+    case AREA_SHAPE_POLYGON:
+        shape.BuildKernel(polygon);
+        break;
+    default:
+        LOGFMTE("shape spans error. unknown shape type:<%u>", shape_type);
+        return -2;
+    }
+
+    size_t total = spans.size();
+    for (u32 row_index = first_row; row_index <= last_row; row_index++)
+    {
+        f32 y = grid.origin.y + row_index * grid.step;
+        AoeSpanRow row;
+        AoeSpanSet(row, min_x, max_x);
+        switch (shape_type)
+        {
+        case AREA_SHAPE_CIRCLE:
+        case AREA_SHAPE_RING:
+            AoeSpanCircle(row, circle, y, z, radius, slack);
+            break;
+        case AREA_SHAPE_FAN:
+            AoeSpanFan(row, fan, y, z, radius, slack);
+            break;
+        case AREA_SHAPE_RECT:
+        case AREA_SHAPE_FRAME:
+            AoeSpanRect(row, rect, y, z, radius, slack);
+            break;
+        case AREA_SHAPE_FOV:
+            AoeSpanFov(row, fov, y, z, slack);
+            break;
+        case AREA_SHAPE_CAPSULE:
+            AoeSpanCapsule(row, capsule, y, z, radius, slack);
+            break;
+        case AREA_SHAPE_POLYGON:
+            AoeSpanPolygon(row, polygon, y, z, radius, slack);
+            break;
+        }
+        AoeSpanEmit(shape, grid, row_index, y, radius, row, spans);
+    }
+    return (s32)(spans.size() - total);
+}
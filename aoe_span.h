@@ -0,0 +1,51 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+#ifndef AOE_SPAN_H
+#define AOE_SPAN_H
+
+#include "aoe_shape.h"
+
+//规则网格 第row行第col列的采样点为(origin.x + col * step, origin.y + row * step, origin.z)
+struct AoeSpanGrid
+{
+    Point3 origin;
+    f32 step;
+    u32 cols;
+    u32 rows;
+};
+
+//一行中连续命中的采样点 列范围[begin, end)
+struct AoeSpan
+{
+    u32 row;
+    u32 begin;
+    u32 end;
+};
+
+const u32 AOE_SPAN_ROW_MAX = 4; //一行中解析区间的最大个数 圆环/扇形大于180度/方框挖空后最多三段
+
+//形状在网格上的覆盖: 逐行用形状参数解析出采样行与形状(按目标半径扩展)相交的x区间, 换算成列范围,
+//只在区间两端用PointInRange逐个收缩/扩展修正浮点误差, 不再检测每个格子. 检测次数与行数成正比.
+//例外是定位点碰撞圆(视锥为近距球)与形状的候选区间相交的行, 这些行在两端之间逐个检测.
+//结果与对每个采样点调用PointInRange(采样点, radius)完全一致, 按行从小到大, 同一行按列从小到大追加到spans.
+//视锥为采样平面z = origin.z上的截面. 返回追加的段数, 负数为错误.
+s32 AoeShapeSpans(AreaShape& shape, const AoeSpanGrid& grid, f32 radius, std::vector<AoeSpan>& spans);
+
+
+#endif //
@@ -0,0 +1,197 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "aoe_stat.h"
+#include <chrono>
+#include <mutex>
+
+struct AoeStatState
+{
+    AoeStatSlot slots[AOE_STAT_SLOT_MAX];
+    std::mutex lock; //只在线程分配/归还槽位时使用
+    u32 free_slots[AOE_STAT_SLOT_MAX];
+    u32 free_count;
+    std::atomic<u32> interval_ms;
+    std::atomic<s64> next_dump_ms;
+    AoeStatState()
+    {
+        for (u32 i = 0; i < AOE_STAT_SLOT_MAX; i++)
+        {
+            for (u32 shape = 0; shape < AOE_STAT_SHAPE_MAX; shape++)
+            {
+                for (u32 code = 0; code < AOE_STAT_CODE_MAX; code++)
+                {
+                    slots[i].counts[shape][code].store(0, std::memory_order_relaxed);
+                }
+            }
+            slots[i].shared = i == 0;
+        }
+        free_count = 0;
+        for (u32 i = AOE_STAT_SLOT_MAX - 1; i > 0; i--)
+        {
+            free_slots[free_count++] = i;
+        }
+        interval_ms.store(0);
+        next_dump_ms.store(0);
+    }
+};
+
+static AoeStatState& AoeStatInstance()
+{
+    static AoeStatState state;
+    return state;
+}
+
+std::atomic<bool>& AoeStatSwitch()
+{
+    static std::atomic<bool> enable(false);
+    return enable;
+}
+
+//线程退出时归还槽位, 槽位中的计数保留, 由下一个使用者继续累加
+struct AoeStatSlotHolder
+{
+    u32 index = 0;
+    ~AoeStatSlotHolder()
+    {
+        if (index == 0)
+        {
+            return;
+        }
+        AoeStatState& state = AoeStatInstance();
+        std::lock_guard<std::mutex> guard(state.lock);
+        state.free_slots[state.free_count++] = index;
+        AoeStatLocalSlot() = NULL;
+    }
+};
+
+AoeStatSlot* AoeStatAcquireSlot()
+{
+    static thread_local AoeStatSlotHolder holder;
+    AoeStatState& state = AoeStatInstance();
+    if (holder.index == 0)
+    {
+        std::lock_guard<std::mutex> guard(state.lock);
+        if (state.free_count > 0)
+        {
+            holder.index = state.free_slots[--state.free_count];
+        }
+    }
+    return &state.slots[holder.index];
+}
+
+void AoeStatMerge(AoeStatTable& table)
+{
+    memset(&table, 0, sizeof(table));
+    AoeStatState& state = AoeStatInstance();
+    for (u32 i = 0; i < AOE_STAT_SLOT_MAX; i++)
+    {
+        for (u32 shape = 0; shape < AOE_STAT_SHAPE_MAX; shape++)
+        {
+            for (u32 code = 0; code < AOE_STAT_CODE_MAX; code++)
+            {
+                table.counts[shape][code] += state.slots[i].counts[shape][code].load(std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+void AoeStatReset()
+{
+    AoeStatState& state = AoeStatInstance();
+    for (u32 i = 0; i < AOE_STAT_SLOT_MAX; i++)
+    {
+        for (u32 shape = 0; shape < AOE_STAT_SHAPE_MAX; shape++)
+        {
+            for (u32 code = 0; code < AOE_STAT_CODE_MAX; code++)
+            {
+                state.slots[i].counts[shape][code].store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+void AoeStatDump()
+{
+    AoeStatTable table;
+    AoeStatMerge(table);
+    for (u32 shape = 0; shape < AOE_STAT_SHAPE_MAX; shape++)
+    {
+        u64 total = 0;
+        for (u32 code = 0; code < AOE_STAT_CODE_MAX; code++)
+        {
+            total += table.counts[shape][code];
+        }
+        if (total == 0)
+        {
+            continue;
+        }
+        char line[1024];
+        s32 len = snprintf(line, sizeof(line), "aoe stat shape_type:<%u> total:<%llu>", shape, (unsigned long long)total);
+        for (u32 code = 0; code < AOE_STAT_CODE_MAX && len > 0 && len < (s32)sizeof(line); code++)
+        {
+            u64 count = table.counts[shape][code];
+            if (count == 0)
+            {
+                continue;
+            }
+            const char* name = code == AOE_STAT_CODE_OTHER ? "other" : NULL;
+            if (name != NULL)
+            {
+                len += snprintf(line + len, sizeof(line) - len, " %s:<%llu, %.2lf%%>", name, (unsigned long long)count, count * 100.0 / total);
+            }
+            else
+            {
+                len += snprintf(line + len, sizeof(line) - len, " %u:<%llu, %.2lf%%>", code, (unsigned long long)count, count * 100.0 / total);
+            }
+        }
+        LOGFMTI("%s", line);
+    }
+}
+
+static s64 AoeStatNowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void AoeStatSetDumpInterval(u32 interval_ms)
+{
+    AoeStatState& state = AoeStatInstance();
+    state.interval_ms.store(interval_ms);
+    state.next_dump_ms.store(AoeStatNowMs() + interval_ms);
+}
+
+void AoeStatTick()
+{
+    AoeStatState& state = AoeStatInstance();
+    u32 interval = state.interval_ms.load(std::memory_order_relaxed);
+    if (interval == 0)
+    {
+        return;
+    }
+    s64 now = AoeStatNowMs();
+    s64 next = state.next_dump_ms.load(std::memory_order_relaxed);
+    if (now < next)
+    {
+        return;
+    }
+    //多个线程同时到期时只有一个输出
+    if (state.next_dump_ms.compare_exchange_strong(next, now + interval))
+    {
+        AoeStatDump();
+    }
+}
@@ -0,0 +1,124 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+#ifndef AOE_STAT_H
+#define AOE_STAT_H
+
+#include "aoe_common.h"
+#include <atomic>
+
+//检测统计: 按形状类型和PointInRange的返回码计数, 用来观察各个提前返回的阶段在实际负载下的分布.
+//每个线程写自己的计数槽, 不加锁也没有原子加; 读取时合并所有槽. 运行时默认关闭, 关闭时只多一次判断.
+//定义AOE_STAT_ENABLE为0可以在编译期去掉统计.
+#ifndef AOE_STAT_ENABLE
+#define AOE_STAT_ENABLE 1
+#endif
+
+const u32 AOE_STAT_SHAPE_MAX = 8;
+const u32 AOE_STAT_CODE_MAX = 32;
+const u32 AOE_STAT_CODE_OTHER = AOE_STAT_CODE_MAX - 1; //超出范围的返回码
+const u32 AOE_STAT_SLOT_MAX = 64; //超出的线程共用0号槽, 0号槽使用原子加
+
+struct AoeStatTable
+{
+    u64 counts[AOE_STAT_SHAPE_MAX][AOE_STAT_CODE_MAX];
+};
+
+struct alignas(64) AoeStatSlot
+{
+    std::atomic<u64> counts[AOE_STAT_SHAPE_MAX][AOE_STAT_CODE_MAX];
+    bool shared;
+
+    inline void Add(u32 shape_type, u32 code, u64 count)
+    {
+        std::atomic<u64>& counter = counts[shape_type < AOE_STAT_SHAPE_MAX ? shape_type : AOE_STAT_SHAPE_MAX - 1][code];
+        if (shared)
+        {
+            counter.fetch_add(count, std::memory_order_relaxed);
+        }
+        else
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+        }
+    }
+};
+
+std::atomic<bool>& AoeStatSwitch();
+AoeStatSlot* AoeStatAcquireSlot();
+
+inline AoeStatSlot*& AoeStatLocalSlot()
+{
+    static thread_local AoeStatSlot* slot = NULL;
+    return slot;
+}
+
+inline AoeStatSlot* AoeStatSlotOfThread()
+{
+    AoeStatSlot*& slot = AoeStatLocalSlot();
+    if (slot == NULL)
+    {
+        slot = AoeStatAcquireSlot();
+    }
+    return slot;
+}
+
+//code为PointInRange的返回值 负数(错误)不计
+inline void AoeStatRecord(u32 shape_type, s32 code)
+{
+#if AOE_STAT_ENABLE
+    if (code < 0 || !AoeStatSwitch().load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    AoeStatSlotOfThread()->Add(shape_type, code < (s32)AOE_STAT_CODE_OTHER ? (u32)code : AOE_STAT_CODE_OTHER, 1);
+#else
+    (void)shape_type;
+    (void)code;
+#endif
+}
+
+//批量检测的命中个数一次计入返回码0. 未命中的目标由调用方逐个补测后按各自的返回码计入
+inline void AoeStatRecordHits(u32 shape_type, u32 hits)
+{
+#if AOE_STAT_ENABLE
+    if (!AoeStatSwitch().load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    AoeStatSlotOfThread()->Add(shape_type, 0, hits);
+#else
+    (void)shape_type;
+    (void)hits;
+#endif
+}
+
+inline void AoeStatEnable(bool enable) { AoeStatSwitch().store(enable, std::memory_order_relaxed); }
+inline bool AoeStatEnabled() { return AoeStatSwitch().load(std::memory_order_relaxed); }
+
+//合并所有线程的计数. 与写入并发时结果是近似值.
+void AoeStatMerge(AoeStatTable& table);
+void AoeStatReset();
+//通过fn_log输出合并后的非0计数
+void AoeStatDump();
+//interval_ms为0时关闭定时输出
+void AoeStatSetDumpInterval(u32 interval_ms);
+//由调用方在主循环中调用, 到达间隔时输出一次
+void AoeStatTick();
+
+
+#endif //
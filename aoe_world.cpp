@@ -0,0 +1,355 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "aoe_world.h"
+#include <algorithm>
+
+AoeWorld::AoeWorld()
+{
+    min_x_ = 0.0f;
+    min_y_ = 0.0f;
+    cell_size_ = 0.0f;
+    inv_cell_size_ = 0.0f;
+    cols_ = 0;
+    rows_ = 0;
+    max_radius_ = 0.0f;
+    stamp_ = 0;
+}
+
+s32 AoeWorld::Init(f32 min_x, f32 min_y, f32 width, f32 height, f32 cell_size)
+{
+    if (cell_size < FLOAT_POINT_PRECISION || width < cell_size || height < cell_size)
+    {
+        LOGFMTE("world init param error. width:<%f>, height:<%f>, cell_size:<%f>", width, height, cell_size);
+        return -1;
+    }
+    if (cols_ != 0)
+    {
+        LOGFMTE("world init conflict.");
+        return -2;
+    }
+    min_x_ = min_x;
+    min_y_ = min_y;
+    cell_size_ = cell_size;
+    inv_cell_size_ = 1.0f / cell_size;
+    cols_ = (u32)ceilf(width * inv_cell_size_);
+    rows_ = (u32)ceilf(height * inv_cell_size_);
+    cells_.resize((size_t)cols_ * rows_);
+    cell_stamps_.resize(cells_.size(), 0);
+    return 0;
+}
+
+void AoeWorld::Clear()
+{
+    ids_.clear();
+    xs_.clear();
+    ys_.clear();
+    zs_.clear();
+    radius_.clear();
+    cell_of_.clear();
+    bucket_pos_.clear();
+    stamps_.clear();
+    slot_of_.clear();
+    for (auto& cell : cells_)
+    {
+        cell.clear();
+    }
+    max_radius_ = 0.0f;
+    stamp_++;
+}
+
+u32 AoeWorld::CellIndex(f32 x, f32 y) const
+{
+    s32 col = (s32)floorf((x - min_x_) * inv_cell_size_);
+    s32 row = (s32)floorf((y - min_y_) * inv_cell_size_);
+    col = PRUNING(col, 0, (s32)cols_ - 1);
+    row = PRUNING(row, 0, (s32)rows_ - 1);
+    return (u32)row * cols_ + (u32)col;
+}
+
+void AoeWorld::CellRange(const Point3& center, f32 radius, u32& min_col, u32& min_row, u32& max_col, u32& max_row) const
+{
+    CellRange(center.x - radius, center.y - radius, center.x + radius, center.y + radius, min_col, min_row, max_col, max_row);
+}
+
+void AoeWorld::CellRange(f32 min_x, f32 min_y, f32 max_x, f32 max_y, u32& min_col, u32& min_row, u32& max_col, u32& max_row) const
+{
+    s32 begin_col = (s32)floorf((min_x - min_x_) * inv_cell_size_);
+    s32 begin_row = (s32)floorf((min_y - min_y_) * inv_cell_size_);
+    s32 end_col = (s32)floorf((max_x - min_x_) * inv_cell_size_);
+    s32 end_row = (s32)floorf((max_y - min_y_) * inv_cell_size_);
+    min_col = (u32)PRUNING(begin_col, 0, (s32)cols_ - 1);
+    min_row = (u32)PRUNING(begin_row, 0, (s32)rows_ - 1);
+    max_col = (u32)PRUNING(end_col, 0, (s32)cols_ - 1);
+    max_row = (u32)PRUNING(end_row, 0, (s32)rows_ - 1);
+}
+
+void AoeWorld::Attach(u32 slot, u32 cell)
+{
+    cell_of_[slot] = cell;
+    bucket_pos_[slot] = (u32)cells_[cell].size();
+    cells_[cell].push_back(slot);
+    cell_stamps_[cell] = stamps_[slot];
+}
+
+void AoeWorld::Detach(u32 slot)
+{
+    std::vector<u32>& bucket = cells_[cell_of_[slot]];
+    u32 pos = bucket_pos_[slot];
+    u32 last = bucket.back();
+    bucket[pos] = last;
+    bucket_pos_[last] = pos;
+    bucket.pop_back();
+}
+
+s32 AoeWorld::AddEntity(u64 id, const Point3& pos, f32 radius)
+{
+    if (cols_ == 0)
+    {
+        LOGFMTE("world not init.");
+        return -1;
+    }
+    if (slot_of_.find(id) != slot_of_.end())
+    {
+        LOGFMTE("world add entity conflict. id:<%llu>", id);
+        return -2;
+    }
+    u32 slot = (u32)ids_.size();
+    ids_.push_back(id);
+    xs_.push_back(pos.x);
+    ys_.push_back(pos.y);
+    zs_.push_back(pos.z);
+    radius_.push_back(radius);
+    cell_of_.push_back(0);
+    bucket_pos_.push_back(0);
+    stamps_.push_back(++stamp_);
+    slot_of_[id] = slot;
+    Attach(slot, CellIndex(pos.x, pos.y));
+    if (radius > max_radius_)
+    {
+        max_radius_ = radius;
+    }
+    return 0;
+}
+
+s32 AoeWorld::MoveEntity(u64 id, const Point3& pos)
+{
+    auto iter = slot_of_.find(id);
+    if (iter == slot_of_.end())
+    {
+        LOGFMTE("world move entity not found. id:<%llu>", id);
+        return -1;
+    }
+    u32 slot = iter->second;
+    xs_[slot] = pos.x;
+    ys_[slot] = pos.y;
+    zs_[slot] = pos.z;
+    stamps_[slot] = ++stamp_;
+    u32 cell = CellIndex(pos.x, pos.y);
+    if (cell != cell_of_[slot])
+    {
+        Detach(slot);
+        Attach(slot, cell);
+    }
+    else
+    {
+        cell_stamps_[cell] = stamp_;
+    }
+    return 0;
+}
+
+s32 AoeWorld::RemoveEntity(u64 id)
+{
+    auto iter = slot_of_.find(id);
+    if (iter == slot_of_.end())
+    {
+        LOGFMTE("world remove entity not found. id:<%llu>", id);
+        return -1;
+    }
+    u32 slot = iter->second;
+    slot_of_.erase(iter);
+    Detach(slot);
+    stamp_++;
+
+    //末尾实体移到空出的槽位
+    u32 last = (u32)ids_.size() - 1;
+    if (slot != last)
+    {
+        ids_[slot] = ids_[last];
+        xs_[slot] = xs_[last];
+        ys_[slot] = ys_[last];
+        zs_[slot] = zs_[last];
+        radius_[slot] = radius_[last];
+        cell_of_[slot] = cell_of_[last];
+        bucket_pos_[slot] = bucket_pos_[last];
+        stamps_[slot] = stamps_[last];
+        cells_[cell_of_[slot]][bucket_pos_[slot]] = slot;
+        slot_of_[ids_[slot]] = slot;
+    }
+    ids_.pop_back();
+    xs_.pop_back();
+    ys_.pop_back();
+    zs_.pop_back();
+    radius_.pop_back();
+    cell_of_.pop_back();
+    bucket_pos_.pop_back();
+    stamps_.pop_back();
+    return 0;
+}
+
+s32 AoeWorld::Query(AreaShape& shape, std::vector<AoeHit>& hits)
+{
+    if (cols_ == 0)
+    {
+        LOGFMTE("world not init.");
+        return -1;
+    }
+    AreaBounds bounds;
+    s32 ret = shape.Bounds(bounds);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    u32 min_col = 0;
+    u32 min_row = 0;
+    u32 max_col = 0;
+    u32 max_row = 0;
+    CellRange(bounds.min.x - max_radius_, bounds.min.y - max_radius_, bounds.max.x + max_radius_, bounds.max.y + max_radius_,
+        min_col, min_row, max_col, max_row);
+
+    candidate_slots_.clear();
+    candidate_x_.clear();
+    candidate_y_.clear();
+    candidate_z_.clear();
+    candidate_radius_.clear();
+    for (u32 row = min_row; row <= max_row; row++)
+    {
+        for (u32 col = min_col; col <= max_col; col++)
+        {
+            for (u32 slot : cells_[row * cols_ + col])
+            {
+                candidate_slots_.push_back(slot);
+                candidate_x_.push_back(xs_[slot]);
+                candidate_y_.push_back(ys_[slot]);
+                candidate_z_.push_back(zs_[slot]);
+                candidate_radius_.push_back(radius_[slot]);
+            }
+        }
+    }
+    u32 count = (u32)candidate_slots_.size();
+    if (count == 0)
+    {
+        return 0;
+    }
+    candidate_dist_.resize(count);
+    candidate_bits_.resize(AreaHitWords(count));
+    AreaPoints points = { candidate_x_.data(), candidate_y_.data(), candidate_z_.data(), candidate_radius_.data(), count };
+    ret = shape.PointsInRange(points, candidate_bits_.data(), candidate_dist_.data());
+    if (ret <= 0)
+    {
+        return ret;
+    }
+    for (u32 word = 0; word < (u32)candidate_bits_.size(); word++)
+    {
+        u64 bits = candidate_bits_[word];
+        while (bits != 0)
+        {
+            u32 bit = 0;
+            while (((bits >> bit) & 1u) == 0)
+            {
+                bit++;
+            }
+            bits &= bits - 1;
+            u32 index = word * 64 + bit;
+            hits.push_back({ ids_[candidate_slots_[index]], candidate_dist_[index] });
+        }
+    }
+    return ret;
+}
+
+s32 AoeWorld::QueryNearest(AreaShape& shape, u32 k, std::vector<AoeHit>& hits)
+{
+    if (cols_ == 0)
+    {
+        LOGFMTE("world not init.");
+        return -1;
+    }
+    AreaBounds bounds;
+    s32 ret = shape.Bounds(bounds);
+    if (ret != 0)
+    {
+        return ret;
+    }
+    if (k == 0)
+    {
+        return 0;
+    }
+
+    u32 min_col = 0;
+    u32 min_row = 0;
+    u32 max_col = 0;
+    u32 max_row = 0;
+    CellRange(bounds.min.x - max_radius_, bounds.min.y - max_radius_, bounds.max.x + max_radius_, bounds.max.y + max_radius_,
+        min_col, min_row, max_col, max_row);
+    const Point3& anchor = shape.anchor();
+    near_cells_.clear();
+    for (u32 row = min_row; row <= max_row; row++)
+    {
+        for (u32 col = min_col; col <= max_col; col++)
+        {
+            u32 cell = row * cols_ + col;
+            if (cells_[cell].empty())
+            {
+                continue;
+            }
+            f32 dx = min_x_ + (col + 0.5f) * cell_size_ - anchor.x;
+            f32 dy = min_y_ + (row + 0.5f) * cell_size_ - anchor.y;
+            near_cells_.push_back(std::make_pair(dx * dx + dy * dy, cell));
+        }
+    }
+    std::sort(near_cells_.begin(), near_cells_.end());
+
+    candidate_slots_.clear();
+    candidate_x_.clear();
+    candidate_y_.clear();
+    candidate_z_.clear();
+    candidate_radius_.clear();
+    for (const auto& near_cell : near_cells_)
+    {
+        for (u32 slot : cells_[near_cell.second])
+        {
+            candidate_slots_.push_back(slot);
+            candidate_x_.push_back(xs_[slot]);
+            candidate_y_.push_back(ys_[slot]);
+            candidate_z_.push_back(zs_[slot]);
+            candidate_radius_.push_back(radius_[slot]);
+        }
+    }
+    u32 count = (u32)candidate_slots_.size();
+    AreaPoints points = { candidate_x_.data(), candidate_y_.data(), candidate_z_.data(), candidate_radius_.data(), count };
+    ret = shape.NearestInRange(points, k, nearest_);
+    if (ret <= 0)
+    {
+        return ret;
+    }
+    for (const AreaNearest& near_hit : nearest_)
+    {
+        hits.push_back({ ids_[candidate_slots_[near_hit.index]], near_hit.dist_sq });
+    }
+    return ret;
+}
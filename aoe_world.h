@@ -0,0 +1,97 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+#ifndef AOE_WORLD_H
+#define AOE_WORLD_H
+
+#include "aoe_shape.h"
+#include <unordered_map>
+
+struct AoeHit
+{
+    u64 id;
+    f32 dist_sq;
+};
+
+//均匀网格空间索引. 实体按二维坐标放入格子, 查询时只检测与形状包围圆重叠的格子中的实体.
+//超出网格范围的实体归入边缘格子, 结果不受影响.
+class AoeWorld
+{
+public:
+    AoeWorld();
+    ~AoeWorld() {}
+    //网格覆盖[min_x, min_x + width) x [min_y, min_y + height)
+    s32 Init(f32 min_x, f32 min_y, f32 width, f32 height, f32 cell_size);
+    s32 AddEntity(u64 id, const Point3& pos, f32 radius);
+    s32 MoveEntity(u64 id, const Point3& pos);
+    s32 RemoveEntity(u64 id);
+    void Clear();
+    //对形状包围盒覆盖的格子中的实体做批量检测, 命中的实体追加到hits. 返回命中个数, 负数为错误.
+    s32 Query(AreaShape& shape, std::vector<AoeHit>& hits);
+    //命中实体中dist_sq最小的k个, 从近到远追加到hits. 格子按离形状定位点由近到远收集, 尽早收紧第k近的距离.
+    s32 QueryNearest(AreaShape& shape, u32 k, std::vector<AoeHit>& hits);
+    u32 entity_count() const { return (u32)ids_.size(); }
+    f32 cell_size() const { return cell_size_; }
+    //每次增加/移动/删除实体时递增, 实体和所在格子记录最后一次进入或移动时的值. 供AoeAura做增量检测
+    u64 stamp() const { return stamp_; }
+    u32 CellIndex(f32 x, f32 y) const;
+    //包围圆覆盖的格子范围(含)
+    void CellRange(const Point3& center, f32 radius, u32& min_col, u32& min_row, u32& max_col, u32& max_row) const;
+    //二维矩形覆盖的格子范围(含)
+    void CellRange(f32 min_x, f32 min_y, f32 max_x, f32 max_y, u32& min_col, u32& min_row, u32& max_col, u32& max_row) const;
+private:
+    void Attach(u32 slot, u32 cell);
+    void Detach(u32 slot);
+    friend class AoeAura;
+private:
+    f32 min_x_;
+    f32 min_y_;
+    f32 cell_size_;
+    f32 inv_cell_size_;
+    u32 cols_;
+    u32 rows_;
+    f32 max_radius_; //所有实体中最大的半径 查询时用来扩展包围圆
+    u64 stamp_;
+
+    //实体数据 按槽位存放 删除时与末尾交换
+    std::vector<u64> ids_;
+    std::vector<f32> xs_;
+    std::vector<f32> ys_;
+    std::vector<f32> zs_;
+    std::vector<f32> radius_;
+    std::vector<u32> cell_of_;
+    std::vector<u32> bucket_pos_; //在所在格子桶中的下标
+    std::vector<u64> stamps_;
+    std::unordered_map<u64, u32> slot_of_;
+    std::vector<std::vector<u32>> cells_;
+    std::vector<u64> cell_stamps_; //格子中最后一次有实体进入或移动时的stamp
+
+    //查询时收集候选实体的缓存
+    std::vector<u32> candidate_slots_;
+    std::vector<f32> candidate_x_;
+    std::vector<f32> candidate_y_;
+    std::vector<f32> candidate_z_;
+    std::vector<f32> candidate_radius_;
+    std::vector<f32> candidate_dist_;
+    std::vector<u64> candidate_bits_;
+    std::vector<std::pair<f32, u32>> near_cells_; //(格子中心到定位点的距离平方, 格子)
+    std::vector<AreaNearest> nearest_;
+};
+
+
+#endif //
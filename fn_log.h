@@ -44,6 +44,7 @@
 
 #include <cstddef>
 #include <cstring>
+#include <cerrno>
 #include <stdio.h>
 #include <iostream>
 #include <vector>
@@ -52,6 +53,7 @@
 #include <algorithm>
 #include <array>
 #include <mutex>
+#include <condition_variable>
 #include <thread>
 #include <functional>
 #include <regex>
@@ -67,6 +69,9 @@
 #include <unordered_set>
 #include <memory>
 #include <atomic>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
 #ifdef WIN32
 #ifndef KEEP_INPUT_QUICK_EDIT
@@ -124,6 +129,8 @@ namespace FNLog
         inline long open(const char* path, const char* mod, struct stat& file_stat);
         inline void close();
         inline void write(const char* data, size_t len);
+        //copy into the staging buffer, flush() writes it with one system call. stage_size 0 falls back to write().  
+        inline void write_staged(const char* data, size_t len, size_t stage_size);
         inline void flush();
 
         inline std::string read_line();
@@ -138,9 +145,13 @@ namespace FNLog
         static inline struct tm time_to_tm(time_t t);
 
         static inline bool rollback(const std::string& path, int depth, int max_depth);
+    private:
+        inline bool write_raw(const char* data, size_t len);
     public:
         char chunk_1_[128];
         FILE* file_;
+        std::vector<char> stage_;
+        size_t stage_len_;
     };
 
 
@@ -169,6 +180,11 @@ namespace FNLog
     }
     void FileHandler::close()
     {
+        if (file_ != nullptr && stage_len_ > 0)
+        {
+            flush();
+        }
+        stage_len_ = 0;
         if (file_ != nullptr)
         {
 #if !defined(__APPLE__) && !defined(WIN32) 
@@ -188,6 +204,7 @@ namespace FNLog
     FileHandler::FileHandler()
     {
         file_ = nullptr;
+        stage_len_ = 0;
     }
     FileHandler::~FileHandler()
     {
@@ -209,8 +226,84 @@ namespace FNLog
             }
         }
     }
+    void FileHandler::write_staged(const char* data, size_t len, size_t stage_size)
+    {
+        if (file_ == nullptr || len == 0)
+        {
+            return;
+        }
+        if (stage_.size() != stage_size)
+        {
+            flush();
+            if (file_ == nullptr)
+            {
+                return;
+            }
+            stage_.resize(stage_size);
+            stage_.shrink_to_fit();
+        }
+        if (stage_size == 0)
+        {
+            write(data, len);
+            return;
+        }
+        if (stage_len_ + len > stage_size)
+        {
+            flush();
+            if (file_ == nullptr)
+            {
+                return;
+            }
+        }
+        if (len >= stage_size)
+        {
+            if (!write_raw(data, len))
+            {
+                close();
+            }
+            return;
+        }
+        memcpy(&stage_[stage_len_], data, len);
+        stage_len_ += len;
+    }
+
+    bool FileHandler::write_raw(const char* data, size_t len)
+    {
+        //bytes from write() may still stay in the stdio buffer. 
+        fflush(file_);
+        while (len > 0)
+        {
+#ifdef WIN32
+            int ret = ::_write(::_fileno(file_), data, (unsigned int)len);
+#else
+            ssize_t ret = ::write(fileno(file_), data, len);
+            if (ret < 0 && errno == EINTR)
+            {
+                continue;
+            }
+#endif
+            if (ret <= 0)
+            {
+                return false;
+            }
+            data += ret;
+            len -= (size_t)ret;
+        }
+        return true;
+    }
+
     void FileHandler::flush()
     {
+        if (file_ && stage_len_ > 0)
+        {
+            size_t len = stage_len_;
+            stage_len_ = 0;
+            if (!write_raw(stage_.data(), len))
+            {
+                close();
+                return;
+            }
+        }
         if (file_)
         {
             fflush(file_);
@@ -565,6 +658,18 @@ public:
 #define FN_LOG_MAX_LOG_QUEUE_SIZE 10000
 #endif
 
+#ifndef FN_LOG_MAX_PRODUCER_SIZE //spsc channel: max threads holding a producer ring of one channel at the same time 
+#define FN_LOG_MAX_PRODUCER_SIZE 64
+#endif
+
+#ifndef FN_LOG_PRODUCER_RING_SIZE //spsc channel: bytes of each producer ring. a log takes 48 bytes and its content length.  
+#define FN_LOG_PRODUCER_RING_SIZE (1024*1024)
+#endif
+
+
+#ifndef FN_LOG_MAX_SPIN_COUNT //async channel: max yield rounds of the channel thread before it parks on empty queue 
+#define FN_LOG_MAX_SPIN_COUNT 256
+#endif
 
 #ifndef FN_LOG_HOTUPDATE_INTERVEL
 #define FN_LOG_HOTUPDATE_INTERVEL 5
@@ -578,6 +683,12 @@ public:
 #define FN_LOG_SHM_KEY 0x9110
 #endif 
 
+//compile time lowest priority (value of LogPriority: 0 trace, 1 debug, 2 info ... 6 fatal).
+//log call sites below it are removed by compiler and their arguments are never evaluated.
+#ifndef FN_LOG_COMPILE_MIN_PRIORITY
+#define FN_LOG_COMPILE_MIN_PRIORITY 0
+#endif
+
 
 namespace FNLog
 {
@@ -630,6 +741,7 @@ namespace FNLog
         int precise_; //create time millionsecond suffix
         unsigned int thread_;
         int content_len_;
+        int defer_pos_; //deferred format args begin here in content, -1 is plain text.  
         char content_[LOG_SIZE]; //content
     };
 
@@ -653,6 +765,7 @@ namespace FNLog
         DEVICE_CFG_FILE_ROLLBACK, 
         DEVICE_CFG_UDP_IP,
         DEVICE_CFG_UDP_PORT,
+        DEVICE_CFG_FILE_BATCH_SIZE, //staging buffer bytes of file device, 0 is one fwrite per log. 
         DEVICE_CFG_MAX_ID
     };
 
@@ -699,6 +812,7 @@ namespace FNLog
     {
         CHANNEL_ASYNC,
         CHANNEL_SYNC,
+        CHANNEL_ASYNC_SPSC, //async, every producer thread has its own ring. (yaml: "sync: spsc")
     };
 
     enum ChannelConfigEnum
@@ -743,6 +857,35 @@ namespace FNLog
         LogData buffer_[BUFFER_LEN];
     };
 
+    //the ring of one producer thread in spsc channel. only the owner thread hold and push, only the channel thread proc. 
+    //producers never touch shared index. it's allocated in heap and not recovered from shm.
+    //byte ring of one producer thread. the indexes are byte offsets.  
+    //record: int record size (-1 wraps to offset 0) + LogData without the unused content.   
+    struct ProducerRing
+    {
+    public:
+        static const int BUFFER_SIZE = FN_LOG_PRODUCER_RING_SIZE;
+        static const int ALIGN_SIZE = 8;
+        static const int HEAD_SIZE = 8;
+        static const int LOG_HEAD_SIZE = (int)sizeof(LogData) - LogData::LOG_SIZE;
+        static const int MAX_RECORD_SIZE = (HEAD_SIZE + (int)sizeof(LogData) + ALIGN_SIZE - 1) / ALIGN_SIZE * ALIGN_SIZE;
+        static const int INDEX_LEN = BUFFER_SIZE / ALIGN_SIZE; //hold index count of one ring 
+        static_assert(BUFFER_SIZE % ALIGN_SIZE == 0 && BUFFER_SIZE > MAX_RECORD_SIZE * 2, "producer ring too small");
+    public:
+        char chunk_1_[CHUNK_SIZE];
+        std::atomic_ullong owner_; //owner thread token, 0 is free.  
+        int slot_;
+        int hold_idx_; //owner only. offset of next record 
+        std::atomic_llong hold_count_;
+        std::atomic_llong push_count_;
+        char chunk_2_[CHUNK_SIZE];
+        std::atomic_int write_idx_;
+        char chunk_3_[CHUNK_SIZE];
+        std::atomic_int read_idx_;
+        char chunk_4_[CHUNK_SIZE];
+        alignas(ALIGN_SIZE) char buffer_[BUFFER_SIZE];
+    };
+
     struct Channel
     {
     public:
@@ -820,6 +963,11 @@ namespace FNLog
     public:
         static const int MAX_CHANNEL_SIZE = SHMLogger::MAX_CHANNEL_SIZE;
         static const int HOTUPDATE_INTERVEL = FN_LOG_HOTUPDATE_INTERVEL;
+        static const int MAX_PRODUCER_SIZE = FN_LOG_MAX_PRODUCER_SIZE;
+        static_assert((long long)MAX_PRODUCER_SIZE * ProducerRing::INDEX_LEN < 0x7fffffff, "hold index overflow");
+        static const int MAX_SPIN_COUNT = FN_LOG_MAX_SPIN_COUNT;
+        static const int MIN_SPIN_COUNT = 8; //producers yield these rounds on full queue before park 
+        static const int MAX_PARK_TIME = 100; //ms. parked threads still check channel state and hot update. 
 
         using ReadLocks = std::array<std::mutex, MAX_CHANNEL_SIZE>;
         using ReadGuard = AutoGuard<std::mutex>;
@@ -827,6 +975,12 @@ namespace FNLog
         using AsyncThreads = std::array<std::thread, MAX_CHANNEL_SIZE>;
         using FileHandles = std::array<FileHandler, MAX_CHANNEL_SIZE* Channel::MAX_DEVICE_SIZE>;
         using UDPHandles = std::array<UDPHandler, MAX_CHANNEL_SIZE* Channel::MAX_DEVICE_SIZE>;
+        using ProducerRings = std::array<std::atomic<ProducerRing*>, MAX_CHANNEL_SIZE * MAX_PRODUCER_SIZE>;
+        using ProducerCounts = std::array<std::atomic_int, MAX_CHANNEL_SIZE>;
+
+        using WakeLocks = std::array<std::mutex, MAX_CHANNEL_SIZE>;
+        using WakeConds = std::array<std::condition_variable, MAX_CHANNEL_SIZE>;
+        using WakeFlags = std::array<std::atomic_int, MAX_CHANNEL_SIZE>;
 
     public:
         using StateLock = std::recursive_mutex;
@@ -851,6 +1005,16 @@ namespace FNLog
         ScreenLock screen_lock_;
         FileHandles file_handles_;
         UDPHandles udp_handles_;
+
+        ProducerRings producer_rings_; //spsc channel rings, never freed until logger destroy. 
+        ProducerCounts producer_counts_; //rings ever created of each channel 
+        unsigned long long generation_; //unique id of this logger instance, keys the thread local ring cache. never 0 
+
+        WakeLocks wake_locks_;
+        WakeConds consumer_conds_; //channel thread parks on empty queue 
+        WakeConds producer_conds_; //producers park on full queue 
+        WakeFlags consumer_parked_;
+        WakeFlags producer_waiting_;
     };
 
 
@@ -1006,6 +1170,7 @@ namespace FNLog
         RK_LIMIT_SIZE,
         RK_ROLLBACK,
         RK_UDP_ADDR,
+        RK_BATCH,
     };
 
 #if __GNUG__ && __GNUC__ >= 5
@@ -1022,6 +1187,8 @@ namespace FNLog
         }
         switch (*begin)
         {
+        case 'b':
+            return RK_BATCH;
         case 'c':
             if (*(begin + 1) == 'h')
             {
@@ -1125,6 +1292,10 @@ namespace FNLog
         {
             return CHANNEL_ASYNC;
         }
+        if (end - begin > 1 && *(begin + 1) == 'p')
+        {
+            return CHANNEL_ASYNC_SPSC;
+        }
         return CHANNEL_SYNC;
     }
     
@@ -1406,6 +1577,9 @@ namespace FNLog
             case RK_ROLLBACK:
                 device.config_fields_[DEVICE_CFG_FILE_ROLLBACK] = atoll(ls.line_.val_begin_);
                 break;
+            case RK_BATCH:
+                device.config_fields_[DEVICE_CFG_FILE_BATCH_SIZE] = atoll(ls.line_.val_begin_) * 1000; //only support K byte 
+                break;
             case RK_PATH:
                 if (ls.line_.val_end_ - ls.line_.val_begin_ < Device::MAX_PATH_LEN - 1
                     && ls.line_.val_end_ - ls.line_.val_begin_ >= 1)
@@ -2127,6 +2301,155 @@ namespace FNLog
         return write_bytes;
     }
 
+
+    //deferred format: the producer copies the printf args after the prefix, the channel thread renders them in DispatchLog.    
+    //args layout: render function, format literal, then every arg. string arg is int length (-1 is null) + bytes + '\0'.   
+    using DeferRender = int(*)(char* dst, int dst_len, const char* fmt, const char* args);
+
+    template<class T>
+    struct DeferArg
+    {
+        static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value, "deferred format only support number, pointer and c string");
+        static int size(T) { return (int)sizeof(T); }
+        static void write(char*& dst, T v) { memcpy(dst, &v, sizeof(T)); dst += sizeof(T); }
+        static T read(const char*& src) { T v; memcpy(&v, src, sizeof(T)); src += sizeof(T); return v; }
+    };
+
+    template<>
+    struct DeferArg<const char*>
+    {
+        static int size(const char* v) { return (int)sizeof(int) + (v ? (int)strlen(v) + 1 : 0); }
+        static void write(char*& dst, const char* v)
+        {
+            int len = v ? (int)strlen(v) : -1;
+            memcpy(dst, &len, sizeof(len));
+            dst += sizeof(len);
+            if (v)
+            {
+                memcpy(dst, v, len + 1);
+                dst += len + 1;
+            }
+        }
+        static const char* read(const char*& src)
+        {
+            int len = 0;
+            memcpy(&len, src, sizeof(len));
+            src += sizeof(len);
+            if (len < 0)
+            {
+                return nullptr;
+            }
+            const char* v = src;
+            src += len + 1;
+            return v;
+        }
+    };
+
+    template<class T>
+    using DeferType = typename std::conditional<std::is_same<typename std::decay<T>::type, char*>::value, const char*, typename std::decay<T>::type>::type;
+
+#if __GNUG__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#pragma GCC diagnostic ignored "-Wformat-security"
+#endif
+    template<class ... Args>
+    inline int DeferPrint(char* dst, int dst_len, const char* fmt, Args ... args)
+    {
+#ifdef WIN32
+        int len = _snprintf_s(dst, dst_len, _TRUNCATE, fmt, args...);
+#else
+        int len = snprintf(dst, dst_len, fmt, args...);
+#endif
+        return len < 0 ? 0 : FN_MIN(len, dst_len - 1);
+    }
+#if __GNUG__
+#pragma GCC diagnostic pop
+#endif
+
+    template<class Tuple, size_t ... I>
+    inline int DeferApply(char* dst, int dst_len, const char* fmt, Tuple& args, std::index_sequence<I...>)
+    {
+        return DeferPrint(dst, dst_len, fmt, std::get<I>(args)...);
+    }
+
+    template<class ... Args>
+    inline int DeferRenderArgs(char* dst, int dst_len, const char* fmt, const char* src)
+    {
+        //braced init reads the args from left to right. 
+        std::tuple<Args...> args{ DeferArg<Args>::read(src)... };
+        (void)src;
+        return DeferApply(dst, dst_len, fmt, args, std::index_sequence_for<Args...>());
+    }
+
+    //capture on producer. the log keeps 2 bytes for the line end added on push.  
+    //format on the spot when the args can't fit.  
+    template<class ... Args>
+    inline void DeferFormat(LogData& log, const char* fmt, Args ... args)
+    {
+        int sizes[] = { (int)(sizeof(DeferRender) + sizeof(fmt)), DeferArg<DeferType<Args>>::size(args)... };
+        int total = 0;
+        for (int size : sizes)
+        {
+            total += size;
+        }
+        if (log.content_len_ + total > LogData::LOG_SIZE - 2)
+        {
+            log.content_len_ += DeferPrint(log.content_ + log.content_len_, LogData::LOG_SIZE - log.content_len_, fmt, args...);
+            return;
+        }
+        DeferRender render = &DeferRenderArgs<DeferType<Args>...>;
+        char* dst = log.content_ + log.content_len_;
+        memcpy(dst, &render, sizeof(render));
+        dst += sizeof(render);
+        memcpy(dst, &fmt, sizeof(fmt));
+        dst += sizeof(fmt);
+        char buff[] = { '\0', (DeferArg<DeferType<Args>>::write(dst, args), '\0')... };
+        (void)buff;
+        log.defer_pos_ = log.content_len_;
+        log.content_len_ = (int)(dst - log.content_);
+    }
+
+    //render on consumer. copy the log with the args formatted into out.  
+    inline void RenderDeferLog(const LogData& log, LogData& out)
+    {
+        out.channel_id_ = log.channel_id_;
+        out.priority_ = log.priority_;
+        out.category_ = log.category_;
+        out.timestamp_ = log.timestamp_;
+        out.precise_ = log.precise_;
+        out.thread_ = log.thread_;
+        out.defer_pos_ = -1;
+        memcpy(out.content_, log.content_, log.defer_pos_);
+        out.content_len_ = log.defer_pos_;
+
+        const char* src = log.content_ + log.defer_pos_;
+        DeferRender render = nullptr;
+        const char* fmt = nullptr;
+        memcpy(&render, src, sizeof(render));
+        src += sizeof(render);
+        memcpy(&fmt, src, sizeof(fmt));
+        src += sizeof(fmt);
+        out.content_len_ += render(out.content_ + out.content_len_, LogData::LOG_SIZE - 1 - out.content_len_, fmt, src);
+        out.content_[out.content_len_++] = '\n';
+        out.content_[out.content_len_] = '\0';
+    }
+
+    //the args of a log left by a dead process point to its memory, only keep the prefix.  
+    inline void DropDeferLog(LogData& log)
+    {
+        if (log.defer_pos_ < 0 || log.defer_pos_ > log.content_len_)
+        {
+            log.defer_pos_ = -1;
+            return;
+        }
+        std::string desc = "!!!deferred args lost!!!\n";
+        log.content_len_ = FN_MIN(log.defer_pos_, LogData::LOG_SIZE - (int)desc.length() - 1);
+        memcpy(&log.content_[log.content_len_], desc.c_str(), desc.length());
+        log.content_len_ += (int)desc.length();
+        log.content_[log.content_len_] = '\0';
+        log.defer_pos_ = -1;
+    }
 }
 
 
@@ -2636,7 +2959,7 @@ namespace FNLog
         {
             return;
         }
-        writer.write(log.content_, log.content_len_);
+        writer.write_staged(log.content_, log.content_len_, (size_t)FN_MAX(AtomicLoadC(device, DEVICE_CFG_FILE_BATCH_SIZE), 0LL));
         AtomicAddL(device, DEVICE_LOG_TOTAL_WRITE_LINE);
         AtomicAddLV(device, DEVICE_LOG_TOTAL_WRITE_BYTE, log.content_len_);
         AtomicAddLV(device, DEVICE_LOG_CUR_FILE_SIZE, log.content_len_);
@@ -2864,7 +3187,7 @@ namespace FNLog
         Channel& channel = logger.shm_->channels_[channel_id];
         Device& device = channel.devices_[device_id];
         //async promise only single thread proc. needn't lock.
-        Logger::ReadGuard rg(logger.read_locks_[channel_id], channel.channel_type_ == CHANNEL_ASYNC);
+        Logger::ReadGuard rg(logger.read_locks_[channel_id], channel.channel_type_ != CHANNEL_SYNC);
         switch (device.out_type_)
         {
         case DEVICE_OUT_FILE:
@@ -2884,6 +3207,13 @@ namespace FNLog
 
     inline void DispatchLog(Logger & logger, Channel& channel, LogData& log)
     {
+        if (log.defer_pos_ >= 0)
+        {
+            static thread_local LogData render_log;
+            RenderDeferLog(log, render_log);
+            DispatchLog(logger, channel, render_log);
+            return;
+        }
         for (int device_id = 0; device_id < channel.device_size_; device_id++)
         {
             Device& device = channel.devices_[device_id];
@@ -2908,14 +3238,190 @@ namespace FNLog
     }
     
  
+    inline void FlushFileDevices(Logger& logger, int channel_id)
+    {
+        Channel& channel = logger.shm_->channels_[channel_id];
+        //sync channel flush on producer thread, the staged bytes are shared with write_staged in EnterProcDevice.  
+        Logger::ReadGuard rg(logger.read_locks_[channel_id], channel.channel_type_ != CHANNEL_SYNC);
+        for (int i = 0; i < channel.device_size_; i++)
+        {
+            if (channel.devices_[i].out_type_ == DEVICE_OUT_FILE)
+            {
+                logger.file_handles_[channel_id * Channel::MAX_DEVICE_SIZE + i].flush();
+            }
+        }
+    }
+
+    inline bool HasPendingLog(Logger& logger, int channel_id)
+    {
+        Channel& channel = logger.shm_->channels_[channel_id];
+        if (channel.channel_type_ != CHANNEL_ASYNC_SPSC)
+        {
+            RingBuffer& ring_buffer = logger.shm_->ring_buffers_[channel_id];
+            return ring_buffer.write_idx_.load(std::memory_order_acquire) != ring_buffer.read_idx_.load(std::memory_order_acquire);
+        }
+        int count = FN_MIN(logger.producer_counts_[channel_id].load(std::memory_order_acquire), (int)Logger::MAX_PRODUCER_SIZE);
+        for (int i = 0; i < count; i++)
+        {
+            ProducerRing* ring = logger.producer_rings_[channel_id * Logger::MAX_PRODUCER_SIZE + i].load(std::memory_order_acquire);
+            if (ring && ring->write_idx_.load(std::memory_order_acquire) != ring->read_idx_.load(std::memory_order_acquire))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //producer side after logs published. the fence pairs with the one in WaitChannelLog, 
+    //so either the channel thread sees the logs before park or the producer sees it parked.  
+    inline void NotifyChannelLog(Logger& logger, int channel_id)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (logger.consumer_parked_[channel_id].load(std::memory_order_relaxed))
+        {
+            Logger::ReadGuard guard(logger.wake_locks_[channel_id]);
+            logger.consumer_conds_[channel_id].notify_one();
+        }
+    }
+
+    //channel thread side after read index moved. 
+    inline void NotifyChannelSpace(Logger& logger, int channel_id)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (logger.producer_waiting_[channel_id].load(std::memory_order_relaxed))
+        {
+            Logger::ReadGuard guard(logger.wake_locks_[channel_id]);
+            logger.producer_conds_[channel_id].notify_all();
+        }
+    }
+
+    //channel thread: yield while logs keep coming, park when the queue stays empty. 
+    //spin_count adapts: doubled when spinning found logs, halved when it had to park. 
+    inline void WaitChannelLog(Logger& logger, int channel_id, int& spin_count)
+    {
+        Channel& channel = logger.shm_->channels_[channel_id];
+        for (int i = 0; i < spin_count; i++)
+        {
+            if (HasPendingLog(logger, channel_id) || channel.channel_state_ != CHANNEL_STATE_RUNNING)
+            {
+                spin_count = FN_MIN(spin_count * 2, (int)Logger::MAX_SPIN_COUNT);
+                return;
+            }
+            std::this_thread::yield();
+        }
+        spin_count = FN_MAX(spin_count / 2, (int)Logger::MIN_SPIN_COUNT);
+
+        std::unique_lock<std::mutex> lock(logger.wake_locks_[channel_id]);
+        logger.consumer_parked_[channel_id].store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        logger.consumer_conds_[channel_id].wait_for(lock, std::chrono::milliseconds((int)Logger::MAX_PARK_TIME), [&logger, &channel, channel_id]()
+        {
+            return HasPendingLog(logger, channel_id) || channel.channel_state_ != CHANNEL_STATE_RUNNING;
+        });
+        logger.consumer_parked_[channel_id].store(0, std::memory_order_relaxed);
+    }
+
+    //producer: the queue is full. yield some rounds then park until the channel thread frees space.  
+    template<class HasSpace>
+    inline void WaitChannelSpace(Logger& logger, int channel_id, int state, HasSpace has_space)
+    {
+        Channel& channel = logger.shm_->channels_[channel_id];
+        if (state <= Logger::MIN_SPIN_COUNT)
+        {
+            std::this_thread::yield();
+            return;
+        }
+        std::unique_lock<std::mutex> lock(logger.wake_locks_[channel_id]);
+        logger.producer_waiting_[channel_id].fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        logger.producer_conds_[channel_id].wait_for(lock, std::chrono::milliseconds((int)Logger::MAX_PARK_TIME), [&channel, &has_space]()
+        {
+            return has_space() || channel.channel_state_ != CHANNEL_STATE_RUNNING;
+        });
+        logger.producer_waiting_[channel_id].fetch_sub(1);
+    }
+
+    inline int& ProducerRecordSize(ProducerRing& ring, int offset)
+    {
+        return *reinterpret_cast<int*>(&ring.buffer_[offset]);
+    }
+
+    inline LogData& ProducerRecordLog(ProducerRing& ring, int offset)
+    {
+        return *reinterpret_cast<LogData*>(&ring.buffer_[offset + ProducerRing::HEAD_SIZE]);
+    }
+
+    //merge producer rings of spsc channel by create time. 
+    //only the head log of each ring is compared, so every thread keeps its own order and the threads are ordered as far as their logs are ready.  
+    inline void EnterProcProducerRings(Logger& logger, int channel_id, int& local_write_count)
+    {
+        Channel& channel = logger.shm_->channels_[channel_id];
+        std::atomic<ProducerRing*>* rings = &logger.producer_rings_[channel_id * Logger::MAX_PRODUCER_SIZE];
+        do
+        {
+            int count = FN_MIN(logger.producer_counts_[channel_id].load(std::memory_order_acquire), (int)Logger::MAX_PRODUCER_SIZE);
+            ProducerRing* best = nullptr;
+            LogData* best_log = nullptr;
+            int best_idx = 0;
+            for (int i = 0; i < count; i++)
+            {
+                ProducerRing* ring = rings[i].load(std::memory_order_acquire);
+                if (ring == nullptr)
+                {
+                    continue;
+                }
+                int read_idx = ring->read_idx_.load(std::memory_order_relaxed);
+                int write_idx = ring->write_idx_.load(std::memory_order_acquire);
+                if (read_idx != write_idx && ProducerRecordSize(*ring, read_idx) < 0)
+                {
+                    read_idx = 0;
+                    ring->read_idx_.store(read_idx, std::memory_order_release);
+                }
+                if (read_idx == write_idx)
+                {
+                    continue;
+                }
+                LogData& log = ProducerRecordLog(*ring, read_idx);
+                if (best_log == nullptr || log.timestamp_ < best_log->timestamp_
+                    || (log.timestamp_ == best_log->timestamp_ && log.precise_ < best_log->precise_))
+                {
+                    best = ring;
+                    best_log = &log;
+                    best_idx = read_idx;
+                }
+            }
+            if (best == nullptr)
+            {
+                break;
+            }
+
+            DispatchLog(logger, channel, *best_log);
+            best_log->data_mark_.store(MARK_INVALID, std::memory_order_relaxed);
+            best->read_idx_.store(best_idx + ProducerRecordSize(*best, best_idx), std::memory_order_release);
+            NotifyChannelSpace(logger, channel_id);
+            AtomicAddL(channel, CHANNEL_LOG_PROCESSED);
+            local_write_count++;
+            if (local_write_count > 10000)
+            {
+                local_write_count = 0;
+                FlushFileDevices(logger, channel_id);
+            }
+        } while (true);
+    }
+
     inline void EnterProcChannel(Logger& logger, int channel_id)
     {
         Channel& channel = logger.shm_->channels_[channel_id];
         RingBuffer& ring_buffer = logger.shm_->ring_buffers_[channel_id];
+        int spin_count = Logger::MIN_SPIN_COUNT;
         do
         {
             int local_write_count = 0;
-            do
+            if (channel.channel_type_ == CHANNEL_ASYNC_SPSC)
+            {
+                EnterProcProducerRings(logger, channel_id, local_write_count);
+            }
+            while (channel.channel_type_ != CHANNEL_ASYNC_SPSC)
             {
                 int old_idx = ring_buffer.proc_idx_.load(std::memory_order_acquire);
                 int next_idx = (old_idx + 1) % RingBuffer::BUFFER_LEN;
@@ -2953,20 +3459,15 @@ namespace FNLog
                     }
                     ring_buffer.read_idx_.compare_exchange_strong(old_idx, next_idx);
                 } while (true);  
+                NotifyChannelSpace(logger, channel_id);
 
                 //if want the high log security can reduce this threshold or enable shared memory queue.  
                 if (local_write_count > 10000)
                 {
                     local_write_count = 0;
-                    for (int i = 0; i < channel.device_size_; i++)
-                    {
-                        if (channel.devices_[i].out_type_ == DEVICE_OUT_FILE)
-                        {
-                            logger.file_handles_[channel_id * Channel::MAX_DEVICE_SIZE + i].flush();
-                        }
-                    }
+                    FlushFileDevices(logger, channel_id);
                 }
-            } while (true);  
+            }
 
 
             if (channel.channel_state_ == CHANNEL_STATE_NULL)
@@ -2976,24 +3477,18 @@ namespace FNLog
 
             if (local_write_count)
             {
-                for (int i = 0; i < channel.device_size_; i++)
-                {
-                    if (channel.devices_[i].out_type_ == DEVICE_OUT_FILE)
-                    {
-                        logger.file_handles_[channel_id * Channel::MAX_DEVICE_SIZE + i].flush();
-                    }
-                }
+                FlushFileDevices(logger, channel_id);
             }
             HotUpdateLogger(logger, channel.channel_id_);
-            if (channel.channel_type_ == CHANNEL_ASYNC)
+            if (channel.channel_type_ != CHANNEL_SYNC)
             {
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                WaitChannelLog(logger, channel_id, spin_count);
             }
             
-        } while (channel.channel_type_ == CHANNEL_ASYNC 
-            && (channel.channel_state_ == CHANNEL_STATE_RUNNING || ring_buffer.write_idx_ != ring_buffer.read_idx_));
+        } while (channel.channel_type_ != CHANNEL_SYNC 
+            && (channel.channel_state_ == CHANNEL_STATE_RUNNING || HasPendingLog(logger, channel_id)));
 
-        if (channel.channel_type_ == CHANNEL_ASYNC)
+        if (channel.channel_type_ != CHANNEL_SYNC)
         {
             channel.channel_state_ = CHANNEL_STATE_FINISH;
         }
@@ -3007,6 +3502,7 @@ namespace FNLog
         log.priority_ = priority;
         log.category_ = category;
         log.content_len_ = 0;
+        log.defer_pos_ = -1;
         log.content_[log.content_len_] = '\0';
 
 #ifdef WIN32
@@ -3059,6 +3555,184 @@ namespace FNLog
         return;
     }
 
+    //unique token of current thread, never 0 
+    inline unsigned long long ProducerToken()
+    {
+        static std::atomic_ullong last_token(0);
+        static thread_local unsigned long long token = ++last_token;
+        return token;
+    }
+
+    //the rings held by current thread. release them on thread exit so new threads can reuse them.
+    //only the rings of one logger are cached, the other loggers find their rings by token.   
+    //keyed by logger generation, a new logger built at the same address never hits the stale rings.  
+    struct ProducerHolder
+    {
+        unsigned long long generation_ = 0;
+        std::array<ProducerRing*, Logger::MAX_CHANNEL_SIZE> rings_ = {};
+        ~ProducerHolder()
+        {
+            for (ProducerRing* ring : rings_)
+            {
+                if (ring)
+                {
+                    ring->owner_.store(0, std::memory_order_release);
+                }
+            }
+        }
+    };
+
+    inline ProducerRing* AcquireProducerRing(Logger& logger, int channel_id)
+    {
+        static thread_local ProducerHolder holder;
+        std::atomic<ProducerRing*>* rings = &logger.producer_rings_[channel_id * Logger::MAX_PRODUCER_SIZE];
+        ProducerRing* cached = holder.rings_[channel_id];
+        if (holder.generation_ == logger.generation_ && cached 
+            && rings[cached->slot_].load(std::memory_order_relaxed) == cached)
+        {
+            return cached;
+        }
+        unsigned long long token = ProducerToken();
+        ProducerRing* ring = nullptr;
+        int count = FN_MIN(logger.producer_counts_[channel_id].load(std::memory_order_acquire), (int)Logger::MAX_PRODUCER_SIZE);
+        for (int i = 0; i < count && ring == nullptr; i++)
+        {
+            ProducerRing* cur = rings[i].load(std::memory_order_acquire);
+            if (cur == nullptr)
+            {
+                continue;
+            }
+            unsigned long long owner = cur->owner_.load(std::memory_order_acquire);
+            if (owner == token || (owner == 0 && cur->owner_.compare_exchange_strong(owner, token)))
+            {
+                ring = cur;
+            }
+        }
+        if (ring == nullptr)
+        {
+            int slot = logger.producer_counts_[channel_id].fetch_add(1);
+            if (slot >= Logger::MAX_PRODUCER_SIZE)
+            {
+                return nullptr;
+            }
+            ring = new (std::nothrow) ProducerRing();
+            if (ring == nullptr)
+            {
+                return nullptr;
+            }
+            ring->owner_ = token;
+            ring->slot_ = slot;
+            rings[slot].store(ring, std::memory_order_release);
+        }
+        if (holder.generation_ == 0 || holder.generation_ == logger.generation_)
+        {
+            holder.generation_ = logger.generation_;
+            holder.rings_[channel_id] = ring;
+        }
+        return ring;
+    }
+
+    //offset where a record of max size fits, -1 is full. 
+    //the hold index never reaches the read index again, so they are equal only when the ring is empty.  
+    inline int FindProducerRecord(ProducerRing& ring)
+    {
+        int hold_idx = ring.hold_idx_;
+        int read_idx = ring.read_idx_.load(std::memory_order_acquire);
+        if (hold_idx < read_idx)
+        {
+            return read_idx - hold_idx > ProducerRing::MAX_RECORD_SIZE ? hold_idx : -1;
+        }
+        if (ProducerRing::BUFFER_SIZE - hold_idx > ProducerRing::MAX_RECORD_SIZE)
+        {
+            return hold_idx;
+        }
+        return read_idx > ProducerRing::MAX_RECORD_SIZE ? 0 : -1;
+    }
+
+    inline int HoldProducerRing(Logger& logger, Channel& channel)
+    {
+        ProducerRing* ring = AcquireProducerRing(logger, channel.channel_id_);
+        if (ring == nullptr)
+        {
+            return -7;
+        }
+        int state = 0;
+        do
+        {
+            if (state > 0)
+            {
+                WaitChannelSpace(logger, channel.channel_id_, state, [ring]()
+                {
+                    return FindProducerRecord(*ring) >= 0;
+                });
+            }
+            state++;
+            int offset = FindProducerRecord(*ring);
+            if (offset >= 0)
+            {
+                if (offset != ring->hold_idx_)
+                {
+                    ProducerRecordSize(*ring, ring->hold_idx_) = -1;
+                }
+                ProducerRecordSize(*ring, offset) = ProducerRing::MAX_RECORD_SIZE;
+                ring->hold_idx_ = offset + ProducerRing::MAX_RECORD_SIZE;
+                ring->hold_count_.store(ring->hold_count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                ProducerRecordLog(*ring, offset).data_mark_.store(MARK_HOLD, std::memory_order_relaxed);
+                return ring->slot_ * ProducerRing::INDEX_LEN + offset / ProducerRing::ALIGN_SIZE;
+            }
+        } while (channel.channel_state_ == CHANNEL_STATE_RUNNING);
+        return -10;
+    }
+
+    //nested log stream in one thread can push out of order, the write index only passes the continuous ready logs.  
+    inline int PushProducerRing(Logger& logger, int channel_id, int hold_idx)
+    {
+        ProducerRing* ring = logger.producer_rings_[channel_id * Logger::MAX_PRODUCER_SIZE + hold_idx / ProducerRing::INDEX_LEN].load(std::memory_order_relaxed);
+        int offset = hold_idx % ProducerRing::INDEX_LEN * ProducerRing::ALIGN_SIZE;
+        LogData& log = ProducerRecordLog(*ring, offset);
+        //the latest record gives back the unused content, a nested one keeps the full size.  
+        if (offset + ProducerRecordSize(*ring, offset) == ring->hold_idx_)
+        {
+            int size = ProducerRing::HEAD_SIZE + ProducerRing::LOG_HEAD_SIZE + log.content_len_ + 1;
+            size = (size + ProducerRing::ALIGN_SIZE - 1) / ProducerRing::ALIGN_SIZE * ProducerRing::ALIGN_SIZE;
+            ProducerRecordSize(*ring, offset) = size;
+            ring->hold_idx_ = offset + size;
+        }
+        log.data_mark_.store(MARK_READY, std::memory_order_relaxed);
+        int write_idx = ring->write_idx_.load(std::memory_order_relaxed);
+        int old_idx = write_idx;
+        while (write_idx != ring->hold_idx_)
+        {
+            if (ProducerRecordSize(*ring, write_idx) < 0)
+            {
+                write_idx = 0;
+                continue;
+            }
+            if (ProducerRecordLog(*ring, write_idx).data_mark_.load(std::memory_order_relaxed) != MARK_READY)
+            {
+                break;
+            }
+            write_idx += ProducerRecordSize(*ring, write_idx);
+            ring->push_count_.store(ring->push_count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        if (write_idx != old_idx)
+        {
+            ring->write_idx_.store(write_idx, std::memory_order_release);
+            NotifyChannelLog(logger, channel_id);
+        }
+        return 0;
+    }
+
+    inline LogData& HoldLogData(Logger& logger, int channel_id, int hold_idx)
+    {
+        if (logger.shm_->channels_[channel_id].channel_type_ == CHANNEL_ASYNC_SPSC)
+        {
+            ProducerRing* ring = logger.producer_rings_[channel_id * Logger::MAX_PRODUCER_SIZE + hold_idx / ProducerRing::INDEX_LEN].load(std::memory_order_relaxed);
+            return ProducerRecordLog(*ring, hold_idx % ProducerRing::INDEX_LEN * ProducerRing::ALIGN_SIZE);
+        }
+        return logger.shm_->ring_buffers_[channel_id].buffer_[hold_idx];
+    }
+
     inline int HoldChannel(Logger& logger, int channel_id, int priority, int category)
     {
         if (channel_id >= logger.shm_->channel_size_ || channel_id < 0)
@@ -3101,7 +3775,10 @@ namespace FNLog
         {
             return -6;
         }
-
+        if (channel.channel_type_ == CHANNEL_ASYNC_SPSC)
+        {
+            return HoldProducerRing(logger, channel);
+        }
 
 
         int state = 0;
@@ -3109,7 +3786,10 @@ namespace FNLog
         {
             if (state > 0)
             {
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                WaitChannelSpace(logger, channel_id, state, [&ring_buffer]()
+                {
+                    return (ring_buffer.hold_idx_.load(std::memory_order_acquire) + 1) % RingBuffer::BUFFER_LEN != ring_buffer.read_idx_.load(std::memory_order_acquire);
+                });
             }
             state++;
 
@@ -3147,18 +3827,28 @@ namespace FNLog
         {
             return -1;
         }
-        if (hold_idx >= RingBuffer::BUFFER_LEN || hold_idx < 0)
+        Channel& channel = logger.shm_->channels_[channel_id];
+        RingBuffer& ring_buffer = logger.shm_->ring_buffers_[channel_id];
+        int buffer_len = channel.channel_type_ == CHANNEL_ASYNC_SPSC ? Logger::MAX_PRODUCER_SIZE * ProducerRing::INDEX_LEN : RingBuffer::BUFFER_LEN;
+        if (hold_idx >= buffer_len || hold_idx < 0)
         {
             return -2;
         }
-        Channel& channel = logger.shm_->channels_[channel_id];
-        RingBuffer& ring_buffer = logger.shm_->ring_buffers_[channel_id];
+
+        LogData& log = HoldLogData(logger, channel_id, hold_idx);
+        if (channel.channel_type_ == CHANNEL_ASYNC_SPSC)
+        {
+            //the ring is owned by this thread, publish it even if the channel stopped. it will be processed or cleaned later. 
+            log.content_len_ = FN_MIN(log.content_len_, LogData::LOG_SIZE - 2);
+            log.content_[log.content_len_++] = '\n';
+            log.content_[log.content_len_] = '\0';
+            return PushProducerRing(logger, channel_id, hold_idx);
+        }
         if (channel.channel_state_ != CHANNEL_STATE_RUNNING)
         {
             return -1;
         }
 
-        LogData& log = ring_buffer.buffer_[hold_idx];
         log.content_len_ = FN_MIN(log.content_len_, LogData::LOG_SIZE - 2);
         log.content_[log.content_len_++] = '\n';
         log.content_[log.content_len_] = '\0';
@@ -3188,6 +3878,10 @@ namespace FNLog
         {
             EnterProcChannel(logger, channel_id); //no affect channel.single_thread_write_
         }
+        else
+        {
+            NotifyChannelLog(logger, channel_id);
+        }
         return 0;
     }
 }
@@ -3297,6 +3991,7 @@ namespace FNLog
                 channel.channel_state_ = CHANNEL_STATE_RUNNING;
                 break;
             case CHANNEL_ASYNC:
+            case CHANNEL_ASYNC_SPSC:
             {
                 thd = std::thread(EnterProcChannel, std::ref(logger), channel_id);
                 if (!thd.joinable())
@@ -3343,6 +4038,7 @@ namespace FNLog
                 channel.channel_state_ = CHANNEL_STATE_NULL;
                 break;
             case CHANNEL_ASYNC:
+            case CHANNEL_ASYNC_SPSC:
             {
                 if (thd.joinable())
                 {
@@ -3350,6 +4046,11 @@ namespace FNLog
                     {
                         channel.channel_state_ = CHANNEL_STATE_WAITING_FINISH;
                     }
+                    {
+                        Logger::ReadGuard guard(logger.wake_locks_[channel_id]);
+                        logger.consumer_conds_[channel_id].notify_one();
+                        logger.producer_conds_[channel_id].notify_all();
+                    }
                     thd.join();
                 }
                 channel.channel_state_ = CHANNEL_STATE_NULL;
@@ -3412,6 +4113,18 @@ namespace FNLog
             ring_buffer.proc_idx_ = 0;
             ring_buffer.write_idx_ = 0;
             ring_buffer.hold_idx_ = 0;
+
+            //the producer rings are owned by their threads, only drop the published logs. 
+            int count = FN_MIN(logger.producer_counts_[channel_id].load(), (int)Logger::MAX_PRODUCER_SIZE);
+            for (int i = 0; i < count; i++)
+            {
+                ProducerRing* ring = logger.producer_rings_[channel_id * Logger::MAX_PRODUCER_SIZE + i].load();
+                if (ring == nullptr)
+                {
+                    continue;
+                }
+                ring->read_idx_.store(ring->write_idx_.load(std::memory_order_acquire), std::memory_order_release);
+            }
         }
         return 0;
     }
@@ -3517,7 +4230,20 @@ namespace FNLog
         {
             return 0;
         }
-        return AtomicLoadL(channel, field);
+        long long val = AtomicLoadL(channel, field);
+        if (channel.channel_type_ == CHANNEL_ASYNC_SPSC && (field == CHANNEL_LOG_HOLD || field == CHANNEL_LOG_PUSH))
+        {
+            int count = FN_MIN(logger.producer_counts_[channel_id].load(), (int)Logger::MAX_PRODUCER_SIZE);
+            for (int i = 0; i < count; i++)
+            {
+                ProducerRing* ring = logger.producer_rings_[channel_id * Logger::MAX_PRODUCER_SIZE + i].load();
+                if (ring)
+                {
+                    val += field == CHANNEL_LOG_HOLD ? ring->hold_count_.load(std::memory_order_relaxed) : ring->push_count_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+        return val;
     }
 
     inline void SetChannelConfig(Logger& logger, int channel_id, ChannelConfigEnum field, long long val)
@@ -3655,7 +4381,7 @@ namespace FNLog
                 printf("new shm. shmat error. key:<0x%x>, idx:<%d>, errno:<%d>.\n", FN_LOG_SHM_KEY, idx, errno);
                 return;
             }
-            memset(addr, 0, sizeof(SHMLogger));
+            //new segment is zero filled by system. not memset here, the pages of a ring stay unbacked until its channel uses it (spsc channel never does).  
             shm = (SHMLogger*)addr;
             shm->shm_size_ = sizeof(SHMLogger);
             shm->shm_id_ = idx;
@@ -3714,6 +4440,10 @@ namespace FNLog
                 return;
             }
             shm->ring_buffers_[i].proc_idx_ = shm->ring_buffers_[i].read_idx_.load();
+            for (int idx = shm->ring_buffers_[i].read_idx_; idx != shm->ring_buffers_[i].write_idx_; idx = (idx + 1) % RingBuffer::BUFFER_LEN)
+            {
+                DropDeferLog(shm->ring_buffers_[i].buffer_[idx]);
+            }
             if (shm->ring_buffers_[i].read_idx_ != 0 || shm->ring_buffers_[i].write_idx_ != 0)
             {
                 printf("attach shm channel:<%d>, write:<%d>, read:<%d> \n",
@@ -3722,9 +4452,13 @@ namespace FNLog
         }
         logger.shm_ = shm;
 #else
-        logger.shm_ = new SHMLogger();
-        memset(logger.shm_, 0, sizeof(SHMLogger));
-        
+        //calloc maps fresh zero pages for the big block, the ring of spsc channel or unused channel never commits memory.  
+        logger.shm_ = (SHMLogger*)calloc(1, sizeof(SHMLogger));
+        if (logger.shm_ == nullptr)
+        {
+            printf("alloc logger error. size:<%d>.\n", (int)sizeof(SHMLogger));
+            return;
+        }
 #endif
     }
     inline void UnloadSharedMemory(Logger& logger)
@@ -3740,7 +4474,7 @@ namespace FNLog
 #else
         if (logger.shm_)
         {
-            delete logger.shm_;
+            free(logger.shm_);
             logger.shm_ = nullptr;
         }
 #endif
@@ -3748,8 +4482,23 @@ namespace FNLog
 
     inline void InitLogger(Logger& logger)
     {
+        static std::atomic_ullong last_generation(0);
         logger.hot_update_ = false;
         logger.logger_state_ = LOGGER_STATE_UNINIT;
+        logger.generation_ = ++last_generation;
+        for (auto& ring : logger.producer_rings_)
+        {
+            ring = nullptr;
+        }
+        for (auto& count : logger.producer_counts_)
+        {
+            count = 0;
+        }
+        for (int channel_id = 0; channel_id < Logger::MAX_CHANNEL_SIZE; channel_id++)
+        {
+            logger.consumer_parked_[channel_id] = 0;
+            logger.producer_waiting_[channel_id] = 0;
+        }
         LoadSharedMemory(logger);
 
 #if ((defined WIN32) && !KEEP_INPUT_QUICK_EDIT)
@@ -3783,6 +4532,16 @@ namespace FNLog
                 std::this_thread::sleep_for(std::chrono::milliseconds(20));
             }
         } ;
+        //the ring still owned by a living thread is leaked, the thread releases it on exit.  
+        for (auto& ring : producer_rings_)
+        {
+            ProducerRing* cur = ring.load();
+            if (cur && cur->owner_.load() == 0)
+            {
+                delete cur;
+            }
+            ring = nullptr;
+        }
         UnloadSharedMemory(*this);
     }
 
@@ -3871,7 +4630,7 @@ namespace FNLog
 
             try
             {
-                InitLogData(logger, logger.shm_->ring_buffers_[channel_id].buffer_[hold_idx], channel_id, priority, category, prefix);
+                InitLogData(logger, HoldLogData(logger, channel_id, hold_idx), channel_id, priority, category, prefix);
             }
             catch (const std::exception&)
             {
@@ -3879,7 +4638,7 @@ namespace FNLog
                 return;
             }
             logger_ = &logger;
-            log_data_ = &logger.shm_->ring_buffers_[channel_id].buffer_[hold_idx];
+            log_data_ = &HoldLogData(logger, channel_id, hold_idx);
             hold_idx_ = hold_idx;
             if (prefix == LOG_PREFIX_NULL)
             {
@@ -4312,6 +5071,16 @@ __LINE__, __FUNCTION__, sizeof(__FUNCTION__) -1, prefix)
 #define LOG_STREAM_DEFAULT_LOGGER_WITH_PREFIX(channel, priority, category) \
     LOG_STREAM_DEFAULT_LOGGER(channel, priority, category, FNLog::LOG_PREFIX_ALL)
 
+#define LOG_PRIORITY_COMPILED(priority) ((int)(priority) >= FN_LOG_COMPILE_MIN_PRIORITY)
+
+//the statement after guard only run when the priority is compiled and passed, so the stream arguments are not evaluated when filtered.
+//it's an if-else statement, safe in unbraced if/else.
+#define LOG_PRIORITY_GUARD(channel, priority, category) \
+    if (!LOG_PRIORITY_COMPILED(priority) || FNLog::FastCheckPriorityPass(FNLog::GetDefaultLogger(), channel, priority, category)) {} else
+
+#define LOG_STREAM_GUARD(channel, priority, category) \
+    LOG_PRIORITY_GUARD(channel, priority, category) LOG_STREAM_DEFAULT_LOGGER_WITH_PREFIX(channel, priority, category)
+
 
 //--------------------CPP STREAM STYLE FORMAT ---------------------------
 #define LogTraceStream(channel_id, category) LOG_STREAM_DEFAULT_LOGGER_WITH_PREFIX(channel_id, FNLog::PRIORITY_TRACE, category)
@@ -4330,6 +5099,24 @@ __LINE__, __FUNCTION__, sizeof(__FUNCTION__) -1, prefix)
 #define LogAlarm() LogAlarmStream(0, 0)
 #define LogFatal() LogFatalStream(0, 0)
 
+//--------------------GUARDED CPP STREAM STYLE FORMAT ---------------------------
+//same as LogXXX() but the << arguments are skipped when the priority is filtered. use as statement only.
+#define LogTraceStreamGuard(channel_id, category) LOG_STREAM_GUARD(channel_id, FNLog::PRIORITY_TRACE, category)
+#define LogDebugStreamGuard(channel_id, category) LOG_STREAM_GUARD(channel_id, FNLog::PRIORITY_DEBUG, category)
+#define LogInfoStreamGuard(channel_id,  category) LOG_STREAM_GUARD(channel_id, FNLog::PRIORITY_INFO,  category)
+#define LogWarnStreamGuard(channel_id,  category) LOG_STREAM_GUARD(channel_id, FNLog::PRIORITY_WARN,  category)
+#define LogErrorStreamGuard(channel_id, category) LOG_STREAM_GUARD(channel_id, FNLog::PRIORITY_ERROR, category)
+#define LogAlarmStreamGuard(channel_id, category) LOG_STREAM_GUARD(channel_id, FNLog::PRIORITY_ALARM, category)
+#define LogFatalStreamGuard(channel_id, category) LOG_STREAM_GUARD(channel_id, FNLog::PRIORITY_FATAL, category)
+
+#define LogTraceGuard() LogTraceStreamGuard(0, 0)
+#define LogDebugGuard() LogDebugStreamGuard(0, 0)
+#define LogInfoGuard()  LogInfoStreamGuard(0, 0)
+#define LogWarnGuard()  LogWarnStreamGuard(0, 0)
+#define LogErrorGuard() LogErrorStreamGuard(0, 0)
+#define LogAlarmGuard() LogAlarmStreamGuard(0, 0)
+#define LogFatalGuard() LogFatalStreamGuard(0, 0)
+
 
 //--------------------CPP TEMPLATE STYLE FORMAT ---------------------------
 inline FNLog::LogStream& LogTemplatePack(FNLog::LogStream&& ls)
@@ -4363,13 +5150,13 @@ FNLog::LogStream& LogTemplatePack(FNLog::LogStream&& ls, Args&& ... args)
 
 //--------------------CPP MACRO STREAM STYLE FORMAT ---------------------------
 
-#define LOG_TRACE(channel_id, category, log) LOG_STREAM_DEFAULT_LOGGER_WITH_PREFIX(channel_id, FNLog::PRIORITY_TRACE, category) << log
-#define LOG_DEBUG(channel_id, category, log) LOG_STREAM_DEFAULT_LOGGER_WITH_PREFIX(channel_id, FNLog::PRIORITY_DEBUG, category) << log
-#define LOG_INFO(channel_id,  category, log) LOG_STREAM_DEFAULT_LOGGER_WITH_PREFIX(channel_id, FNLog::PRIORITY_INFO,  category) << log
-#define LOG_WARN(channel_id,  category, log) LOG_STREAM_DEFAULT_LOGGER_WITH_PREFIX(channel_id, FNLog::PRIORITY_WARN,  category) << log
-#define LOG_ERROR(channel_id, category, log) LOG_STREAM_DEFAULT_LOGGER_WITH_PREFIX(channel_id, FNLog::PRIORITY_ERROR, category) << log
-#define LOG_ALARM(channel_id, category, log) LOG_STREAM_DEFAULT_LOGGER_WITH_PREFIX(channel_id, FNLog::PRIORITY_ALARM, category) << log
-#define LOG_FATAL(channel_id, category, log) LOG_STREAM_DEFAULT_LOGGER_WITH_PREFIX(channel_id, FNLog::PRIORITY_FATAL, category) << log
+#define LOG_TRACE(channel_id, category, log) LOG_STREAM_GUARD(channel_id, FNLog::PRIORITY_TRACE, category) << log
+#define LOG_DEBUG(channel_id, category, log) LOG_STREAM_GUARD(channel_id, FNLog::PRIORITY_DEBUG, category) << log
+#define LOG_INFO(channel_id,  category, log) LOG_STREAM_GUARD(channel_id, FNLog::PRIORITY_INFO,  category) << log
+#define LOG_WARN(channel_id,  category, log) LOG_STREAM_GUARD(channel_id, FNLog::PRIORITY_WARN,  category) << log
+#define LOG_ERROR(channel_id, category, log) LOG_STREAM_GUARD(channel_id, FNLog::PRIORITY_ERROR, category) << log
+#define LOG_ALARM(channel_id, category, log) LOG_STREAM_GUARD(channel_id, FNLog::PRIORITY_ALARM, category) << log
+#define LOG_FATAL(channel_id, category, log) LOG_STREAM_GUARD(channel_id, FNLog::PRIORITY_FATAL, category) << log
 
 #define LOGT(log) LOG_TRACE(0, 0, log)
 #define LOGD(log) LOG_DEBUG(0, 0, log)
@@ -4384,7 +5171,7 @@ FNLog::LogStream& LogTemplatePack(FNLog::LogStream&& ls, Args&& ... args)
 #ifdef WIN32
 #define LOG_FORMAT(channel_id, priority, category, prefix, logformat, ...) \
 do{ \
-    if (FNLog::FastCheckPriorityPass(FNLog::GetDefaultLogger(), channel_id, priority, category))  \
+    if (!LOG_PRIORITY_COMPILED(priority) || FNLog::FastCheckPriorityPass(FNLog::GetDefaultLogger(), channel_id, priority, category))  \
     { \
         break;   \
     } \
@@ -4399,7 +5186,7 @@ do{ \
 #else
 #define LOG_FORMAT(channel_id, priority, category, prefix, logformat, ...) \
 do{ \
-    if (FNLog::FastCheckPriorityPass(FNLog::GetDefaultLogger(), channel_id, priority, category))  \
+    if (!LOG_PRIORITY_COMPILED(priority) || FNLog::FastCheckPriorityPass(FNLog::GetDefaultLogger(), channel_id, priority, category))  \
     { \
         break;   \
     } \
@@ -4429,6 +5216,39 @@ do{ \
 #define LOGFMTF(fmt, ...) LOGFMT_FATAL(0, 0, fmt,  ##__VA_ARGS__)
 
 
+//--------------------DEFERRED C STYLE FORMAT ---------------------------
+//same as LOGFMT but the caller only copies the args, the channel thread formats them. 
+//logformat must be a string literal. args: number, pointer (printed, not followed) and c string (copied).  
+#define LOG_DEFER_FORMAT(channel_id, priority, category, prefix, logformat, ...) \
+do{ \
+    if (!LOG_PRIORITY_COMPILED(priority) || FNLog::FastCheckPriorityPass(FNLog::GetDefaultLogger(), channel_id, priority, category))  \
+    { \
+        break;   \
+    } \
+    (void)sizeof(snprintf(nullptr, 0, "" logformat, ##__VA_ARGS__)); \
+    FNLog::LogStream __log_stream(LOG_STREAM_DEFAULT_LOGGER(channel_id, priority, category, prefix));\
+    if (__log_stream.log_data_)\
+    {\
+        FNLog::DeferFormat(*__log_stream.log_data_, "" logformat, ##__VA_ARGS__); \
+    }\
+} while (0)
+
+#define LOGDFMT_TRACE(channel_id, category, fmt, ...)  LOG_DEFER_FORMAT(channel_id, FNLog::PRIORITY_TRACE, category, FNLog::LOG_PREFIX_ALL, fmt, ##__VA_ARGS__)
+#define LOGDFMT_DEBUG(channel_id, category, fmt, ...)  LOG_DEFER_FORMAT(channel_id, FNLog::PRIORITY_DEBUG, category, FNLog::LOG_PREFIX_ALL, fmt, ##__VA_ARGS__)
+#define LOGDFMT_INFO( channel_id, category, fmt, ...)  LOG_DEFER_FORMAT(channel_id, FNLog::PRIORITY_INFO,  category, FNLog::LOG_PREFIX_ALL, fmt, ##__VA_ARGS__)
+#define LOGDFMT_WARN( channel_id, category, fmt, ...)  LOG_DEFER_FORMAT(channel_id, FNLog::PRIORITY_WARN,  category, FNLog::LOG_PREFIX_ALL, fmt, ##__VA_ARGS__)
+#define LOGDFMT_ERROR(channel_id, category, fmt, ...)  LOG_DEFER_FORMAT(channel_id, FNLog::PRIORITY_ERROR, category, FNLog::LOG_PREFIX_ALL, fmt, ##__VA_ARGS__)
+#define LOGDFMT_ALARM(channel_id, category, fmt, ...)  LOG_DEFER_FORMAT(channel_id, FNLog::PRIORITY_ALARM, category, FNLog::LOG_PREFIX_ALL, fmt, ##__VA_ARGS__)
+#define LOGDFMT_FATAL(channel_id, category, fmt, ...)  LOG_DEFER_FORMAT(channel_id, FNLog::PRIORITY_FATAL, category, FNLog::LOG_PREFIX_ALL, fmt, ##__VA_ARGS__)
+#define LOGDFMTT(fmt, ...) LOGDFMT_TRACE(0, 0, fmt,  ##__VA_ARGS__)
+#define LOGDFMTD(fmt, ...) LOGDFMT_DEBUG(0, 0, fmt,  ##__VA_ARGS__)
+#define LOGDFMTI(fmt, ...) LOGDFMT_INFO( 0, 0, fmt,  ##__VA_ARGS__)
+#define LOGDFMTW(fmt, ...) LOGDFMT_WARN( 0, 0, fmt,  ##__VA_ARGS__)
+#define LOGDFMTE(fmt, ...) LOGDFMT_ERROR(0, 0, fmt,  ##__VA_ARGS__)
+#define LOGDFMTA(fmt, ...) LOGDFMT_ALARM(0, 0, fmt,  ##__VA_ARGS__)
+#define LOGDFMTF(fmt, ...) LOGDFMT_FATAL(0, 0, fmt,  ##__VA_ARGS__)
+
+
 #endif
 /*
  *
@@ -0,0 +1,608 @@
+﻿/*
+* aoe License
+* Copyright (C) 2019 YaweiZhang <yawei.zhang@foxmail.com>.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+//无界面的日志正确性检查. 每项检查启动独立的Logger, 写文件到当前目录下的fn_log_check目录,
+//等待通道处理完全部日志后停止, 读回文件逐行核对. 不一致时返回非0, 由ctest运行.
+//以FN_LOG_USE_SHM=1编译时(fn_log_shm_check)先检查共享内存的崩溃恢复. 参数defer只检查延迟格式化.
+
+#include "fn_log.h"
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if FN_LOG_USE_SHM
+static const char* CHECK_PATH = "fn_log_shm_check";
+#else
+static const char* CHECK_PATH = "fn_log_check";
+#endif
+static const int CHECK_WAIT_TIME = 30000; //ms. 等待通道处理完的上限
+static const int CHECK_ORDER_THREADS = 8;
+static const int CHECK_ORDER_LINES = 50000; //每个线程的行数
+static const int CHECK_STAGED_LINES = 400000;
+static const int CHECK_STAGED_BATCH = 64; //K byte
+static const long long CHECK_STAGED_LIMIT = 1000 * 1000; //limit_size: 1 m
+static const int CHECK_STAGED_ROLLBACK = 64; //保留全部滚动出的文件
+static const char* CHECK_STAGED_PAD = " staged write pad to about sixty bytes";
+static const int CHECK_RING_THREADS = 4;
+static const int CHECK_RING_LINES = 20000; //每个线程的行数, 平均约500字节, 每个1M的环形缓冲区回绕约10次
+static const int CHECK_RING_MAX_PAYLOAD = 900;
+static const int CHECK_RING_NESTED = 64; //每隔这么多行在持有记录时再写一行
+static const int CHECK_RING_WAVES = 6; //先后启动的线程批数, 线程总数超过MAX_PRODUCER_SIZE
+static const int CHECK_RING_WAVE_THREADS = 16;
+static const int CHECK_RING_WAVE_LINES = 200;
+static const int CHECK_DEFER_ROUNDS = 100;
+static const int CHECK_DEFER_LONG = 950; //参数放不下, 在写日志的线程格式化并截断
+static const int CHECK_DEFER_LONG_MIN = 500; //截断后至少保留的长度, 前缀长度与源文件路径有关
+static const int CHECK_WAKE_IDLE_ROUNDS = 20;
+static const int CHECK_WAKE_IDLE_TIME = 20; //ms. 足够通道线程自旋结束停住
+static const int CHECK_WAKE_RACE_ROUNDS = 2000;
+static const int CHECK_WAKE_RACE_YIELDS = 1024; //随机让出的上限, 覆盖通道线程自旋的轮数
+static const long long CHECK_WAKE_AVERAGE = 2000; //us. 停住后被唤醒的平均延迟上限, 轮询间隔为10ms时超出
+static const long long CHECK_WAKE_MAX = FNLog::Logger::MAX_PARK_TIME * 1000 / 2; //us. 唤醒丢失时要等到停住超时
+
+//单通道单文件设备的配置. sync为通道类型, device为附加在设备上的配置行. 多个通道的配置依次拼接
+static std::string CheckConfig(const char* sync, const std::string& name, const std::string& device, int channel = 0)
+{
+    std::string text = " - channel: " + std::to_string(channel) + "\n    sync: ";
+    text += sync;
+    text += "\n    -device: 0\n        disable: false\n        out_type: file\n        path: ";
+    text += CHECK_PATH;
+    text += "\n        file: \"" + name + "\"\n";
+    text += device;
+    return text;
+}
+
+//name.log及滚动出的name.log.1 ~ name.log.<rollback>, 序号越大越旧
+static std::string CheckFilePath(const std::string& name, int index)
+{
+    std::string path = std::string(CHECK_PATH) + "/" + name + ".log";
+    if (index > 0)
+    {
+        path += "." + std::to_string(index);
+    }
+    return path;
+}
+
+//启动独立的Logger. 先删掉同名的旧文件, 检查只看本次写入的内容
+static std::unique_ptr<FNLog::Logger> CheckStartLogger(const std::string& config, const std::string& name, int rollback)
+{
+    for (int i = 0; i <= rollback; i++)
+    {
+        remove(CheckFilePath(name, i).c_str());
+    }
+    std::unique_ptr<FNLog::Logger> logger(new FNLog::Logger());
+    int ret = FNLog::ParseAndStartLogger(*logger, config);
+    if (ret != 0)
+    {
+        printf("check start logger error:<%d>. file:<%s>\n", ret, name.c_str());
+        return nullptr;
+    }
+    return logger;
+}
+
+//各通道一共处理完的日志数
+static long long CheckProcessed(FNLog::Logger& logger)
+{
+    long long processed = 0;
+    for (int channel_id = 0; channel_id < logger.shm_->channel_size_; channel_id++)
+    {
+        processed += FNLog::GetChannelLog(logger, channel_id, FNLog::CHANNEL_LOG_PROCESSED);
+    }
+    return processed;
+}
+
+//等待各通道一共处理完count条日志再停止. 停止会关闭文件, 缓冲的内容都写出
+static int CheckStopLogger(FNLog::Logger& logger, long long count)
+{
+    int waited = 0;
+    while (CheckProcessed(logger) < count)
+    {
+        if (waited++ >= CHECK_WAIT_TIME)
+        {
+            printf("check wait logs timeout. processed:<%lld>, expect:<%lld>\n", CheckProcessed(logger), count);
+            FNLog::StopLogger(logger);
+            return 1;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return FNLog::StopLogger(logger) == 0 ? 0 : 1;
+}
+
+//按从旧到新的顺序读回全部行
+static void CheckReadLines(const std::string& name, int rollback, std::vector<std::string>& lines)
+{
+    lines.clear();
+    for (int i = rollback; i >= 0; i--)
+    {
+        std::ifstream file(CheckFilePath(name, i));
+        std::string line;
+        while (std::getline(file, line))
+        {
+            lines.push_back(line);
+        }
+    }
+}
+
+//threads个线程各写count行"thread:<t> seq:<i>", 行尾附加pad
+static void CheckWriteThreads(FNLog::Logger& logger, int threads, int count, const char* pad)
+{
+    std::vector<std::thread> writers;
+    for (int t = 0; t < threads; t++)
+    {
+        writers.emplace_back([&logger, t, count, pad]()
+        {
+            for (int i = 0; i < count; i++)
+            {
+                LOG_STREAM_ORIGIN(logger, 0, FNLog::PRIORITY_INFO, 0, FNLog::LOG_PREFIX_NULL) << "thread:" << t << " seq:" << i << pad;
+            }
+        });
+    }
+    for (auto& thd : writers)
+    {
+        thd.join();
+    }
+}
+
+//读回CheckWriteThreads写的行: 每行只出现一次, 没有丢失. ordered时还要保持每个线程写入的顺序, 不同线程之间的先后不要求.
+//同步通道由各个写日志的线程处理, 多线程时不保证顺序
+static int CheckThreadLines(const std::string& name, int rollback, int threads, int count, bool ordered)
+{
+    std::vector<std::string> lines;
+    CheckReadLines(name, rollback, lines);
+    std::vector<int> next(threads, 0);
+    std::vector<char> seen((size_t)threads * count, 0);
+    for (const std::string& line : lines)
+    {
+        int t = -1;
+        int seq = -1;
+        if (sscanf(line.c_str(), "thread:%d seq:%d", &t, &seq) != 2 || t < 0 || t >= threads || seq < 0 || seq >= count
+            || seen[(size_t)t * count + seq] || (ordered && seq != next[t]))
+        {
+            printf("check thread lines error. file:<%s>, line:<%s>, expect seq:<%d>\n", name.c_str(), line.c_str(), t >= 0 && t < threads ? next[t] : -1);
+            return 1;
+        }
+        seen[(size_t)t * count + seq] = 1;
+        next[t]++;
+    }
+    for (int t = 0; t < threads; t++)
+    {
+        if (next[t] != count)
+        {
+            printf("check thread lines lost logs. file:<%s>, thread:<%d>, lines:<%d>\n", name.c_str(), t, next[t]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//多线程写日志, 不丢失且保持每个线程的顺序
+static int CheckOrder(const char* sync)
+{
+    std::string name = std::string("order_") + sync;
+    std::unique_ptr<FNLog::Logger> logger = CheckStartLogger(CheckConfig(sync, name, ""), name, 0);
+    if (!logger)
+    {
+        return 1;
+    }
+    CheckWriteThreads(*logger, CHECK_ORDER_THREADS, CHECK_ORDER_LINES, "");
+    if (CheckStopLogger(*logger, (long long)CHECK_ORDER_THREADS * CHECK_ORDER_LINES) != 0)
+    {
+        return 1;
+    }
+    return CheckThreadLines(name, 0, CHECK_ORDER_THREADS, CHECK_ORDER_LINES, true);
+}
+
+//暂存批量写文件并按大小滚动: 全部行都在, 每个文件不超过限制.
+//同步通道由写日志的线程刷新文件, 多个线程同时写时检查暂存区的加锁
+static int CheckStaged(const char* sync, int threads)
+{
+    std::string name = std::string("staged_") + sync;
+    std::string device = "        batch: " + std::to_string(CHECK_STAGED_BATCH) + "\n        limit_size: 1 m\n        rollback: " + std::to_string(CHECK_STAGED_ROLLBACK) + "\n";
+    std::unique_ptr<FNLog::Logger> logger = CheckStartLogger(CheckConfig(sync, name, device), name, CHECK_STAGED_ROLLBACK);
+    if (!logger)
+    {
+        return 1;
+    }
+    int count = CHECK_STAGED_LINES / threads;
+    CheckWriteThreads(*logger, threads, count, CHECK_STAGED_PAD);
+    if (CheckStopLogger(*logger, (long long)threads * count) != 0)
+    {
+        return 1;
+    }
+    for (int i = 0; i <= CHECK_STAGED_ROLLBACK; i++)
+    {
+        std::ifstream file(CheckFilePath(name, i), std::ios::binary | std::ios::ate);
+        if (file && (long long)file.tellg() > CHECK_STAGED_LIMIT)
+        {
+            printf("check staged file size error. file:<%s>, size:<%lld>\n", CheckFilePath(name, i).c_str(), (long long)file.tellg());
+            return 1;
+        }
+    }
+    if (std::ifstream(CheckFilePath(name, CHECK_STAGED_ROLLBACK)))
+    {
+        printf("check staged rollback too small. file:<%s>\n", name.c_str());
+        return 1;
+    }
+    return CheckThreadLines(name, CHECK_STAGED_ROLLBACK, threads, count, strcmp(sync, "sync") != 0 || threads == 1);
+}
+
+//变长记录的内容长度和填充字符由线程和序号决定, 读回时可以核对
+static int CheckRingPayloadLen(int t, int seq)
+{
+    return (seq * 37 + t * 101) % (CHECK_RING_MAX_PAYLOAD + 1);
+}
+
+static char CheckRingPayloadChar(int t, int seq)
+{
+    return (char)('a' + (t + seq) % 26);
+}
+
+//spsc通道的变长记录: 长度不一的记录不断回绕环形缓冲区, 每隔CHECK_RING_NESTED行在持有一条记录时再写一行(嵌套的记录).
+//每行的内容完整, 每个线程的行和嵌套行都不丢失且保持顺序
+static int CheckRingWrap()
+{
+    std::string name = "ring_wrap";
+    std::unique_ptr<FNLog::Logger> logger = CheckStartLogger(CheckConfig("spsc", name, ""), name, 0);
+    if (!logger)
+    {
+        return 1;
+    }
+    std::vector<std::thread> writers;
+    for (int t = 0; t < CHECK_RING_THREADS; t++)
+    {
+        writers.emplace_back([&logger, t]()
+        {
+            std::string payload;
+            for (int i = 0; i < CHECK_RING_LINES; i++)
+            {
+                payload.assign(CheckRingPayloadLen(t, i), CheckRingPayloadChar(t, i));
+                FNLog::LogStream outer(LOG_STREAM_ORIGIN(*logger, 0, FNLog::PRIORITY_INFO, 0, FNLog::LOG_PREFIX_NULL));
+                if (i % CHECK_RING_NESTED == 0)
+                {
+                    LOG_STREAM_ORIGIN(*logger, 0, FNLog::PRIORITY_INFO, 0, FNLog::LOG_PREFIX_NULL) << "nested:" << t << " seq:" << i;
+                }
+                outer << "thread:" << t << " seq:" << i << " len:" << (int)payload.length() << " " << payload;
+            }
+        });
+    }
+    for (auto& thd : writers)
+    {
+        thd.join();
+    }
+    int nested_lines = (CHECK_RING_LINES + CHECK_RING_NESTED - 1) / CHECK_RING_NESTED;
+    if (CheckStopLogger(*logger, (long long)CHECK_RING_THREADS * (CHECK_RING_LINES + nested_lines)) != 0)
+    {
+        return 1;
+    }
+
+    std::vector<std::string> lines;
+    CheckReadLines(name, 0, lines);
+    std::vector<int> next(CHECK_RING_THREADS, 0);
+    std::vector<int> nested_next(CHECK_RING_THREADS, 0);
+    for (const std::string& line : lines)
+    {
+        int t = -1;
+        int seq = -1;
+        int len = -1;
+        int pos = 0;
+        if (sscanf(line.c_str(), "nested:%d seq:%d", &t, &seq) == 2)
+        {
+            if (t < 0 || t >= CHECK_RING_THREADS || seq != nested_next[t])
+            {
+                printf("check ring nested error. line:<%s>\n", line.c_str());
+                return 1;
+            }
+            nested_next[t] += CHECK_RING_NESTED;
+            continue;
+        }
+        if (sscanf(line.c_str(), "thread:%d seq:%d len:%d %n", &t, &seq, &len, &pos) != 3 || t < 0 || t >= CHECK_RING_THREADS || seq != next[t]
+            || len != CheckRingPayloadLen(t, seq) || line.length() != (size_t)(pos + len)
+            || line.find_first_not_of(CheckRingPayloadChar(t, seq), pos) != std::string::npos)
+        {
+            printf("check ring line error. line:<%.80s>, length:<%d>, expect seq:<%d>\n", line.c_str(), (int)line.length(), t >= 0 && t < CHECK_RING_THREADS ? next[t] : -1);
+            return 1;
+        }
+        next[t]++;
+    }
+    for (int t = 0; t < CHECK_RING_THREADS; t++)
+    {
+        if (next[t] != CHECK_RING_LINES || nested_next[t] != nested_lines * CHECK_RING_NESTED)
+        {
+            printf("check ring lost logs. thread:<%d>, lines:<%d>, nested:<%d>\n", t, next[t], nested_next[t] / CHECK_RING_NESTED);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//spsc通道的环形缓冲区复用: 线程退出时交还自己的环, 后面的线程接着用.
+//先后启动的线程总数超过MAX_PRODUCER_SIZE, 日志都不丢失, 创建过的环不超过同时存在的线程数
+static int CheckRingReuse()
+{
+    static_assert(CHECK_RING_WAVES * CHECK_RING_WAVE_THREADS > FNLog::Logger::MAX_PRODUCER_SIZE, "waves too few");
+    std::string name = "ring_reuse";
+    std::unique_ptr<FNLog::Logger> logger = CheckStartLogger(CheckConfig("spsc", name, ""), name, 0);
+    if (!logger)
+    {
+        return 1;
+    }
+    for (int w = 0; w < CHECK_RING_WAVES; w++)
+    {
+        std::vector<std::thread> writers;
+        for (int i = 0; i < CHECK_RING_WAVE_THREADS; i++)
+        {
+            int t = w * CHECK_RING_WAVE_THREADS + i;
+            writers.emplace_back([&logger, t]()
+            {
+                for (int seq = 0; seq < CHECK_RING_WAVE_LINES; seq++)
+                {
+                    LOG_STREAM_ORIGIN(*logger, 0, FNLog::PRIORITY_INFO, 0, FNLog::LOG_PREFIX_NULL) << "thread:" << t << " seq:" << seq;
+                }
+            });
+        }
+        for (auto& thd : writers)
+        {
+            thd.join();
+        }
+    }
+    int rings = logger->producer_counts_[0].load();
+    if (CheckStopLogger(*logger, (long long)CHECK_RING_WAVES * CHECK_RING_WAVE_THREADS * CHECK_RING_WAVE_LINES) != 0)
+    {
+        return 1;
+    }
+    if (rings > CHECK_RING_WAVE_THREADS)
+    {
+        printf("check ring reuse error. rings:<%d>, threads of one wave:<%d>\n", rings, CHECK_RING_WAVE_THREADS);
+        return 1;
+    }
+    return CheckThreadLines(name, 0, CHECK_RING_WAVES * CHECK_RING_WAVE_THREADS, CHECK_RING_WAVE_LINES, true);
+}
+
+template<class ... Args>
+static std::string CheckDeferText(const char* fmt, Args ... args)
+{
+    char buff[FNLog::LogData::LOG_SIZE];
+    snprintf(buff, sizeof(buff), fmt, args...);
+    return buff;
+}
+
+//延迟格式化: 默认Logger的async和spsc通道各写一遍, 通道线程格式化的结果与snprintf逐行对比.
+//参数放不下的长字符串退回到写日志的线程格式化, 截断到记录的长度
+static int CheckDefer()
+{
+    const char* syncs[] = { "async", "spsc" };
+    const int channels = sizeof(syncs) / sizeof(syncs[0]);
+    std::string config;
+    for (int channel = 0; channel < channels; channel++)
+    {
+        std::string name = std::string("defer_") + syncs[channel];
+        remove(CheckFilePath(name, 0).c_str());
+        config += CheckConfig(syncs[channel], name, "", channel);
+    }
+    FNLog::Logger& logger = FNLog::GetDefaultLogger();
+    if (FNLog::FastStartDefaultLogger(config) != 0)
+    {
+        return 1;
+    }
+    std::vector<std::string> expects;
+    std::string long_text(CHECK_DEFER_LONG, 'L');
+    char buff[] = "defer buff";
+    for (int i = 0; i < CHECK_DEFER_ROUNDS; i++)
+    {
+        for (int channel = 0; channel < channels; channel++)
+        {
+            LOGDFMT_INFO(channel, 0, "int:%d uint:%u ll:%lld ull:%llu", -i, i * 7u, -1234567890123LL * i, 1234567890123ULL + i);
+            LOGDFMT_INFO(channel, 0, "double:%.4f float:%g char:%c", i * 3.14159265, i * 0.5f, (char)('a' + i % 26));
+            LOGDFMT_INFO(channel, 0, "str:%s buff:%s empty:<%s>", "literal", buff, "");
+            LOGDFMT_INFO(channel, 0, "ptr:%p enum:%d", (void*)&expects, FNLog::PRIORITY_WARN);
+            LOGDFMT_INFO(channel, 0, "long:%s", long_text.c_str());
+        }
+        expects.push_back(CheckDeferText("int:%d uint:%u ll:%lld ull:%llu", -i, i * 7u, -1234567890123LL * i, 1234567890123ULL + i));
+        expects.push_back(CheckDeferText("double:%.4f float:%g char:%c", i * 3.14159265, i * 0.5f, (char)('a' + i % 26)));
+        expects.push_back(CheckDeferText("str:%s buff:%s empty:<%s>", "literal", buff, ""));
+        expects.push_back(CheckDeferText("ptr:%p enum:%d", (void*)&expects, FNLog::PRIORITY_WARN));
+        expects.push_back("long:");
+    }
+    if (CheckStopLogger(logger, (long long)channels * expects.size()) != 0)
+    {
+        return 1;
+    }
+
+    for (int channel = 0; channel < channels; channel++)
+    {
+        std::vector<std::string> lines;
+        CheckReadLines(std::string("defer_") + syncs[channel], 0, lines);
+        if (lines.size() != expects.size())
+        {
+            printf("check defer lost logs. sync:<%s>, lines:<%d>, expect:<%d>\n", syncs[channel], (int)lines.size(), (int)expects.size());
+            return 1;
+        }
+        for (size_t i = 0; i < lines.size(); i++)
+        {
+            const std::string& line = lines[i];
+            const std::string& expect = expects[i];
+            bool same = false;
+            if (expect == "long:")
+            {
+                size_t pos = line.find(expect);
+                same = pos != std::string::npos && line.length() >= pos + expect.length() + CHECK_DEFER_LONG_MIN
+                    && line.find_first_not_of('L', pos + expect.length()) == std::string::npos;
+            }
+            else
+            {
+                same = line.length() >= expect.length() && line.compare(line.length() - expect.length(), expect.length(), expect) == 0;
+            }
+            if (!same)
+            {
+                printf("check defer error. sync:<%s>, line:<%.120s>, expect:<%s>\n", syncs[channel], line.c_str(), expect.c_str());
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+#if FN_LOG_USE_SHM && !defined(WIN32)
+//崩溃恢复: 进程退出时还持有的延迟格式化记录, 参数里的指针属于死掉的进程. 新进程挂接共享内存时丢掉参数, 只保留前缀并加上说明.
+//在同一进程里模拟: 旧Logger停掉通道线程后不释放共享内存, 新Logger挂接同一块共享内存恢复并写出
+static int CheckDeferRecover()
+{
+    std::string name = "defer_recover";
+    std::string config = CheckConfig("async", name, "");
+    std::unique_ptr<FNLog::Logger> dead = CheckStartLogger(config, name, 0);
+    if (!dead)
+    {
+        return 1;
+    }
+    LOG_STREAM_ORIGIN(*dead, 0, FNLog::PRIORITY_INFO, 0, FNLog::LOG_PREFIX_NULL) << "recover:before";
+    FNLog::LogStream held(LOG_STREAM_ORIGIN(*dead, 0, FNLog::PRIORITY_INFO, 0, FNLog::LOG_PREFIX_NULL));
+    if (held.log_data_ == nullptr)
+    {
+        printf("%s", "check defer recover hold error.\n");
+        return 1;
+    }
+    held << "recover:";
+    FNLog::DeferFormat(*held.log_data_, "args %d %s", 7, "lost");
+    while (CheckProcessed(*dead) < 1)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    long long processed = CheckProcessed(*dead);
+    FNLog::StopChannels(*dead);
+    held.log_data_ = nullptr; //死掉的进程不会再提交这条记录
+
+    std::unique_ptr<FNLog::Logger> logger(new FNLog::Logger());
+    int ret = FNLog::ParseAndStartLogger(*logger, config);
+    if (ret != 0)
+    {
+        printf("check defer recover start error:<%d>\n", ret);
+        return 1;
+    }
+    //计数在共享内存里, 接着旧Logger的计数
+    ret = CheckStopLogger(*logger, processed + 1);
+    logger.reset();
+    dead.reset();
+    if (ret != 0)
+    {
+        return 1;
+    }
+
+    std::vector<std::string> lines;
+    CheckReadLines(name, 0, lines);
+    if (lines.size() != 2 || lines[0] != "recover:before" || lines[1] != "recover:!!!deferred args lost!!!")
+    {
+        printf("check defer recover error. lines:<%d>, last:<%s>\n", (int)lines.size(), lines.empty() ? "" : lines.back().c_str());
+        return 1;
+    }
+    return 0;
+}
+#endif
+
+//写一条日志, 计时到通道处理完, 返回微秒
+static long long CheckWakeOnce(FNLog::Logger& logger, long long& count)
+{
+    auto begin = std::chrono::steady_clock::now();
+    LOG_STREAM_ORIGIN(logger, 0, FNLog::PRIORITY_INFO, 0, FNLog::LOG_PREFIX_NULL) << "wake:" << count++;
+    while (FNLog::GetChannelLog(logger, 0, FNLog::CHANNEL_LOG_PROCESSED) < count)
+    {
+        std::this_thread::yield();
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+}
+
+//唤醒延迟: 通道线程空闲停住后写一条日志, 平均延迟应远小于原来的轮询间隔.
+//再在通道线程将要停住的前后随机时刻写, 唤醒不能丢失, 丢失时延迟接近MAX_PARK_TIME
+static int CheckWake(const char* sync)
+{
+    std::string name = std::string("wake_") + sync;
+    std::unique_ptr<FNLog::Logger> logger = CheckStartLogger(CheckConfig(sync, name, ""), name, 0);
+    if (!logger)
+    {
+        return 1;
+    }
+    long long count = 0;
+    long long idle_total = 0;
+    long long idle_max = 0;
+    for (int i = 0; i < CHECK_WAKE_IDLE_ROUNDS; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(CHECK_WAKE_IDLE_TIME));
+        long long used = CheckWakeOnce(*logger, count);
+        idle_total += used;
+        idle_max = std::max(idle_max, used);
+    }
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<int> yields(0, CHECK_WAKE_RACE_YIELDS);
+    long long race_max = 0;
+    for (int i = 0; i < CHECK_WAKE_RACE_ROUNDS; i++)
+    {
+        for (int y = yields(rng); y > 0; y--)
+        {
+            std::this_thread::yield();
+        }
+        race_max = std::max(race_max, CheckWakeOnce(*logger, count));
+    }
+    if (CheckStopLogger(*logger, count) != 0)
+    {
+        return 1;
+    }
+    long long idle_average = idle_total / CHECK_WAKE_IDLE_ROUNDS;
+    if (idle_average > CHECK_WAKE_AVERAGE || idle_max > CHECK_WAKE_MAX || race_max > CHECK_WAKE_MAX)
+    {
+        printf("check wake error. sync:<%s>, idle average:<%lld>us, idle max:<%lld>us, race max:<%lld>us\n", sync, idle_average, idle_max, race_max);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    bool defer_only = argc > 1 && strcmp(argv[1], "defer") == 0;
+    int errors = 0;
+#if FN_LOG_USE_SHM && !defined(WIN32)
+    //恢复检查不能与默认Logger同时挂接共享内存, 最先运行
+    int recover_errors = CheckDeferRecover();
+    printf("check recover errors:<%d>\n", recover_errors);
+    errors += recover_errors;
+#endif
+    if (!defer_only)
+    {
+        const char* syncs[] = { "async", "spsc" };
+        for (const char* sync : syncs)
+        {
+            int sync_errors = CheckOrder(sync);
+            sync_errors += CheckWake(sync);
+            sync_errors += CheckStaged(sync, 1);
+            printf("check sync:<%s> errors:<%d>\n", sync, sync_errors);
+            errors += sync_errors;
+        }
+        int sync_errors = CheckStaged("sync", CHECK_ORDER_THREADS);
+        printf("check sync:<sync> errors:<%d>\n", sync_errors);
+        errors += sync_errors;
+        int ring_errors = CheckRingWrap();
+        ring_errors += CheckRingReuse();
+        printf("check ring errors:<%d>\n", ring_errors);
+        errors += ring_errors;
+    }
+    int defer_errors = CheckDefer();
+    printf("check defer errors:<%d>\n", defer_errors);
+    errors += defer_errors;
+    return errors == 0 ? 0 : 1;
+}
@@ -85,6 +85,8 @@
 
 
 #include "aoe_shape.h"
+#include "aoe_stat.h"
+#include "aoe_span.h"
 #define SCREEN_X 800
 #define SCREEN_Y 800
 #define BENCH_MARK false
@@ -154,7 +156,11 @@ std::vector<Shape> g_shapes =
 {AREA_SHAPE_RING,0.02f,{0.0f, 0.0f, 0.0f}, { 0.2f, 0.2f, 0.2f }, {0.0f, 0.0f, 0.0f} },
 {AREA_SHAPE_RING,0.02f,{0.0f, 0.0f, 0.0f}, { 0.0f, 0.2f, 0.2f }, {0.0f, 0.0f, 0.0f} },
 {AREA_SHAPE_FRAME,0.02f,{0.0f, 0.0f, 0.0f}, { 0.2f, 0.2f, 0.2f }, {0.0f, 0.0f, 0.0f} },
-{AREA_SHAPE_FRAME,0.00f,{0.0f, 0.0f, 0.0f}, { 0.2f, 0.2f, 0.2f }, {0.0f, 0.0f, 0.0f} }
+{AREA_SHAPE_FRAME,0.00f,{0.0f, 0.0f, 0.0f}, { 0.2f, 0.2f, 0.2f }, {0.0f, 0.0f, 0.0f} },
+{AREA_SHAPE_CAPSULE,0.02f,{0.0f, 0.0f, 0.0f}, { 0.3f, 0.1f, 0.2f }, {0.0f, 0.0f, 0.0f} },
+{AREA_SHAPE_CAPSULE,0.00f,{0.0f, 0.0f, 0.0f}, { 0.0f, 0.1f, 0.2f }, {0.0f, 0.0f, 0.0f} },
+{AREA_SHAPE_POLYGON,0.02f,{0.0f, 0.0f, 0.0f}, { 6.0f, 0.2f, 0.2f }, {0.0f, 0.0f, 0.0f} },
+{AREA_SHAPE_POLYGON,0.00f,{0.0f, 0.0f, 0.0f}, { 3.0f, 0.2f, 0.2f }, {0.0f, 0.0f, 0.0f} }
 };
 
 class TestRange
@@ -193,27 +199,19 @@ public:
             return;
         }
         
-        f32 dist = 0;
-        Point3 pos;
-
-        for (int i = SCALAR_BEGIN; i < SCALAR_END; i++)
+        //逐行取覆盖的列范围, 不再逐个格子检测. 先画带目标半径的范围, 零半径的范围盖在上面
+        AoeSpanGrid grid = { Point3(SCALAR_BEGIN * 2.0f / SCALAR_NUM, SCALAR_BEGIN * 2.0f / SCALAR_NUM, 0.0f), 2.0f / SCALAR_NUM, SCALAR_NUM, SCALAR_NUM };
+        const f32 radius[2] = { 0.01f, 0.0f };
+        const Point3 color[2] = { _color_redius, _color };
+        for (u32 pass = 0; pass < 2; pass++)
         {
-            for (int j = SCALAR_BEGIN; j < SCALAR_END; j++)
+            _spans.clear();
+            AoeShapeSpans(range, grid, radius[pass], _spans);
+            for (const AoeSpan& span : _spans)
             {
-                pos = { i*2.0f / SCALAR_NUM, j * 2.0f / SCALAR_NUM, 0.0f};
-                if (0 == range.PointInRange(pos, 0.01, dist))
-                {
-                    if (_len < PIXELS_SIZE)
-                    {
-                        _pixels[_len++] = { _color_redius.x, _color_redius.y, _color_redius.z, pos.x, pos.y, pos.z };
-                    }
-                }
-                if (0 == range.PointInRange(pos, 0.0f, dist))
+                for (u32 col = span.begin; col < span.end && _len < PIXELS_SIZE; col++)
                 {
-                    if (_len < PIXELS_SIZE)
-                    {
-                        _pixels[_len++] = { _color.x, _color.y, _color.z, pos.x, pos.y, pos.z };
-                    }
+                    _pixels[_len++] = { color[pass].x, color[pass].y, color[pass].z, grid.origin.x + col * grid.step, grid.origin.y + span.row * grid.step, grid.origin.z };
                 }
             }
         }
@@ -239,6 +237,7 @@ public:
 
 public:
     std::array<Pixel, PIXELS_SIZE>  _pixels;
+    std::vector<AoeSpan> _spans;
     size_t _len = 0;
     time_t _last = 0;
     size_t _cur_specify = 0;
@@ -379,6 +378,8 @@ int main(void)
 
     FNLog::FastStartDebugLogger();
     FNLog::BatchSetChannelConfig(FNLog::GetDefaultLogger(), FNLog::CHANNEL_CFG_PRIORITY, FNLog::PRIORITY_INFO);
+    AoeStatEnable(true);
+    AoeStatSetDumpInterval(10000);
     stress_2d();
 
 
@@ -491,6 +492,7 @@ int main(void)
             last_hit_count = cur_hit_count;
             frame_count = 0.0f;
         }
+        AoeStatTick();
     }
 
     glfwDestroyWindow(window);
@@ -20,14 +20,22 @@
 
 #include <math.h>
 #include <cmath>
+#include <string.h>
 
 static const float PI = 3.1415926535897932f;
+static const float PI2 = PI * 2.0f;
 static const float PI_PER_ANGLE = PI / 180.0f;
 static const float ANGLE_PER_PI = 180.0f / PI;
 static const float FLOAT_POINT_PRECISION = 0.0002f;
 
 
-#define SignBitF(f) ((*(u32*)&f) & (1u << 31))
+//按位取符号 用memcpy避免-O2下的strict-aliasing问题
+static inline unsigned int SignBitF(float f)
+{
+    unsigned int bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits & (1u << 31);
+}
 
 template<class Float>
 static inline bool FLOAT_IS_ZERO(Float val) { return fabs(val) < FLOAT_POINT_PRECISION; }
@@ -57,9 +65,9 @@ public:
 
 public:
     Float x, y, z;
-    Vector3(Float fx, Float fy, Float fz):x(fx),y(fy),z(fz){}
+    constexpr Vector3(Float fx, Float fy, Float fz):x(fx),y(fy),z(fz){}
     Vector3(const Vector3 & ) = default;
-    Vector3() :Vector3(0.0f, 0.0f, 0.0f) {};
+    constexpr Vector3() :Vector3(0.0f, 0.0f, 0.0f) {};
     Vector3 & operator =(const Vector3 & v3) = default;
 
     void reset() { x = 0.0f; y = 0.0f; z = 0.0f; }
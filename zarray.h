@@ -20,6 +20,10 @@
 #include <type_traits>
 #include "fn_log.h"
 
+#ifndef IS_TRIVIALLY_COPYABLE
+#define IS_TRIVIALLY_COPYABLE(T) std::is_trivially_copyable<T>::value
+#endif
+
 
 #ifndef  ZARRAY_H
 #define ZARRAY_H